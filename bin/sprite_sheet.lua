@@ -12,41 +12,22 @@ function SpriteSheet:new(texture, width, height)
 end
 
 function SpriteSheet:begin()
-    self.vertices = {}
-    self.texcoords = {}
-    self.indices = {}
+    if self.sprites == nil then
+        self.sprites = jam.graphics.newSpriteBuffer()
+    end
+    self.sprites:clear()
 end
 
 function SpriteSheet:append(x, y, w, h, u, v)
-    local baseVertex = table.getn(self.vertices)
-
     u = u * self.invWidth
     v = v * self.invHeight
 
-    table.insert(self.vertices, { x,     y })
-    table.insert(self.vertices, { x + w, y })
-    table.insert(self.vertices, { x,     y + h })
-    table.insert(self.vertices, { x + w, y + h })
-
-    table.insert(self.texcoords, { u,                 v })
-    table.insert(self.texcoords, { u + self.invWidth, v })
-    table.insert(self.texcoords, { u,                 v + self.invHeight })
-    table.insert(self.texcoords, { u + self.invWidth, v + self.invHeight })
-
-    table.insert(self.indices, baseVertex)
-    table.insert(self.indices, baseVertex + 1)
-    table.insert(self.indices, baseVertex + 2)
-    table.insert(self.indices, baseVertex + 2)
-    table.insert(self.indices, baseVertex + 1)
-    table.insert(self.indices, baseVertex + 3)
+    self.sprites:add(x, y, w, h, u, v, u + self.invWidth, v + self.invHeight)
 end
 
 function SpriteSheet:draw()
-    jam.graphics.draw{
-        vertices = self.vertices,
-        texcoords = self.texcoords,
-        indices = self.indices,
+    jam.graphics.drawSprites{
+        sprites = self.sprites,
         texture = self.texture,
-		topology = jam.graphics.topology.TriangleList,
     }
 end
\ No newline at end of file
@@ -4,6 +4,18 @@ freetype_libdir_debug = freetype_libdir
 freetype_lib = "freetype"
 freetype_lib_debug = freetype_lib
 
+newoption {
+	trigger = "renderer",
+	value = "API",
+	description = "Renderer the game is built with",
+	allowed = {
+		{ "default", "OpenGL on Linux, Direct3D 11 on Windows" },
+		{ "null", "No rendering, for headless runs on Linux" },
+		{ "software", "CPU rasterizer that writes PNG frames, Linux only" },
+	},
+	default = "default",
+}
+
 solution "jammy"
 	platforms { "Win64", "Linux64" }
 	configurations { "Debug", "Development", "Standalone" }
@@ -217,6 +229,10 @@ project "jammy"
 		defines { "JM_WINDOWS" }
 	filter { "platforms:Linux64" }
 		defines { "JM_LINUX" }
+	filter { "options:renderer=null" }
+		defines { "JM_RENDERER_NULL" }
+	filter { "options:renderer=software" }
+		defines { "JM_RENDERER_SOFTWARE" }
 
 	filter { "configurations:Debug" }
 		targetsuffix "_debug"
@@ -268,9 +284,13 @@ project "jammy"
 			"lua",
 			"chipmunk",
 			"freetype",
+			"m",
+			"pthread",
+		}
+
+	filter { "platforms:Linux64", "options:renderer=default" }
+		links {
 			"X11",
 			"GL",
 			"GLEW",
-			"m",
-			"pthread",
 		}
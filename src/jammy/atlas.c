@@ -0,0 +1,154 @@
+#include "atlas.h"
+
+#include <jammy/assert.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+void jm_skyline_packer_init(
+	jm_skyline_packer* packer,
+	uint32_t width,
+	uint32_t height)
+{
+	packer->width = width;
+	packer->height = height;
+	// a segment is at least one pixel wide, so there are never more than width of them
+	packer->nodeCapacity = width;
+	packer->nodes = malloc(packer->nodeCapacity * sizeof(jm_skyline_node));
+	packer->nodeCount = 1;
+	packer->nodes[0].x = 0;
+	packer->nodes[0].y = 0;
+	packer->nodes[0].width = width;
+}
+
+void jm_skyline_packer_destroy(
+	jm_skyline_packer* packer)
+{
+	free(packer->nodes);
+	packer->nodes = NULL;
+	packer->nodeCount = 0;
+}
+
+// Lowest y at which a rectangle starting at node 'index' rests on the skyline.
+static bool jm_skyline_fit(
+	const jm_skyline_packer* packer,
+	uint32_t index,
+	uint32_t width,
+	uint32_t height,
+	uint32_t* outY)
+{
+	const uint32_t x = packer->nodes[index].x;
+	if (x + width > packer->width)
+	{
+		return false;
+	}
+
+	uint32_t y = 0;
+	uint32_t remaining = width;
+	for (uint32_t i = index; remaining > 0; ++i)
+	{
+		jm_assert(i < packer->nodeCount);
+		const jm_skyline_node* node = packer->nodes + i;
+		if (node->y > y)
+		{
+			y = node->y;
+		}
+		if (y + height > packer->height)
+		{
+			return false;
+		}
+		remaining = (node->width >= remaining) ? 0 : remaining - node->width;
+	}
+
+	*outY = y;
+	return true;
+}
+
+bool jm_skyline_packer_insert(
+	jm_skyline_packer* packer,
+	uint32_t width,
+	uint32_t height,
+	uint32_t* outX,
+	uint32_t* outY)
+{
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	// pick the position with the lowest top edge, then the narrowest segment
+	uint32_t bestIndex = UINT32_MAX;
+	uint32_t bestTop = UINT32_MAX;
+	uint32_t bestWidth = UINT32_MAX;
+	uint32_t bestY = 0;
+	for (uint32_t i = 0; i < packer->nodeCount; ++i)
+	{
+		uint32_t y;
+		if (!jm_skyline_fit(packer, i, width, height, &y))
+		{
+			continue;
+		}
+		const uint32_t top = y + height;
+		if (top < bestTop || (top == bestTop && packer->nodes[i].width < bestWidth))
+		{
+			bestIndex = i;
+			bestTop = top;
+			bestWidth = packer->nodes[i].width;
+			bestY = y;
+		}
+	}
+
+	if (bestIndex == UINT32_MAX)
+	{
+		return false;
+	}
+
+	const uint32_t x = packer->nodes[bestIndex].x;
+
+	// insert the new segment and cut away what it covers of the following ones
+	jm_assert(packer->nodeCount < packer->nodeCapacity);
+	memmove(packer->nodes + bestIndex + 1, packer->nodes + bestIndex, (packer->nodeCount - bestIndex) * sizeof(jm_skyline_node));
+	packer->nodeCount++;
+	packer->nodes[bestIndex].x = x;
+	packer->nodes[bestIndex].y = bestY + height;
+	packer->nodes[bestIndex].width = width;
+
+	for (uint32_t i = bestIndex + 1; i < packer->nodeCount; )
+	{
+		jm_skyline_node* node = packer->nodes + i;
+		const uint32_t coveredEnd = x + width;
+		if (node->x >= coveredEnd)
+		{
+			break;
+		}
+		const uint32_t shrink = coveredEnd - node->x;
+		if (shrink < node->width)
+		{
+			node->x += shrink;
+			node->width -= shrink;
+			break;
+		}
+		memmove(node, node + 1, (packer->nodeCount - i - 1) * sizeof(jm_skyline_node));
+		packer->nodeCount--;
+	}
+
+	// merge neighbours at the same height
+	for (uint32_t i = 0; i + 1 < packer->nodeCount; )
+	{
+		jm_skyline_node* node = packer->nodes + i;
+		if (node->y == node[1].y)
+		{
+			node->width += node[1].width;
+			memmove(node + 1, node + 2, (packer->nodeCount - i - 2) * sizeof(jm_skyline_node));
+			packer->nodeCount--;
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	*outX = x;
+	*outY = bestY;
+	return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// Skyline rectangle packer. Keeps the top edge of the packed area as a list
+// of horizontal segments and places each rectangle bottom-left.
+
+typedef struct jm_skyline_node
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+} jm_skyline_node;
+
+typedef struct jm_skyline_packer
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t nodeCount;
+	uint32_t nodeCapacity;
+	jm_skyline_node* nodes;
+} jm_skyline_packer;
+
+void jm_skyline_packer_init(
+	jm_skyline_packer* packer,
+	uint32_t width,
+	uint32_t height);
+
+void jm_skyline_packer_destroy(
+	jm_skyline_packer* packer);
+
+// Returns false if the rectangle doesn't fit anymore.
+bool jm_skyline_packer_insert(
+	jm_skyline_packer* packer,
+	uint32_t width,
+	uint32_t height,
+	uint32_t* outX,
+	uint32_t* outY);
@@ -0,0 +1,749 @@
+#include "capture.h"
+
+#include <jammy/render_commands.h>
+#include <jammy/texture.h>
+#include <jammy/font.h>
+#include <jammy/mesh.h>
+#include <jammy/assert.h>
+#include <jammy/hash.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+// Commands are identified by their index in this table instead of their
+// dispatcher address, which changes between builds and runs.
+typedef enum jm_capture_command
+{
+	JM_CAPTURE_COMMAND_DRAW,
+	JM_CAPTURE_COMMAND_DRAW_TEXT,
+	JM_CAPTURE_COMMAND_DRAW_SPRITES,
+	JM_CAPTURE_COMMAND_BEGIN_RENDER_TARGET,
+	JM_CAPTURE_COMMAND_END_RENDER_TARGET,
+	JM_CAPTURE_COMMAND_DRAW_MESH,
+	JM_CAPTURE_COMMAND_COUNT,
+} jm_capture_command;
+
+static const jm_render_command_dispatcher g_captureDispatchers[] =
+{
+	(jm_render_command_dispatcher)__jm_render_command_draw,
+	(jm_render_command_dispatcher)__jm_render_command_draw_text,
+	(jm_render_command_dispatcher)__jm_render_command_draw_sprites,
+	(jm_render_command_dispatcher)__jm_render_command_begin_render_target,
+	(jm_render_command_dispatcher)__jm_render_command_end_render_target,
+	(jm_render_command_dispatcher)__jm_render_command_draw_mesh,
+};
+
+static const uint32_t g_captureCommandSizes[] =
+{
+	sizeof(jm_render_command_draw),
+	sizeof(jm_render_command_draw_text),
+	sizeof(jm_render_command_draw_sprites),
+	sizeof(jm_render_command_begin_render_target),
+	sizeof(jm_render_command_end_render_target),
+	sizeof(jm_render_command_draw_mesh),
+};
+
+// flags of the optional arrays of a draw command
+#define JM_CAPTURE_DRAW_TEXCOORDS 0x1
+#define JM_CAPTURE_DRAW_COLORS 0x2
+#define JM_CAPTURE_DRAW_INDICES 0x4
+
+static char* g_capturePath = NULL;
+
+// Capture data is written to a file, or only hashed if there is none.
+typedef struct jm_capture_stream
+{
+	FILE* file;
+	uint64_t hash;
+} jm_capture_stream;
+
+static bool jm_capture_write_bytes(
+	jm_capture_stream* s,
+	const void* data,
+	size_t size)
+{
+	if (s->file == NULL)
+	{
+		s->hash = jm_hash_bytes(data, size, s->hash);
+		return true;
+	}
+	return size == 0 || fwrite(data, 1, size, s->file) == size;
+}
+
+static bool jm_capture_write_string(
+	jm_capture_stream* s,
+	const char* str)
+{
+	const uint32_t length = (uint32_t)strlen(str);
+	return jm_capture_write_bytes(s, &length, sizeof(length)) && jm_capture_write_bytes(s, str, length);
+}
+
+static bool jm_capture_write_draw(
+	jm_capture_stream* s,
+	const jm_render_command_draw* cmd)
+{
+	const uint8_t flags =
+		((cmd->texcoords != NULL) ? JM_CAPTURE_DRAW_TEXCOORDS : 0) |
+		((cmd->colors != NULL) ? JM_CAPTURE_DRAW_COLORS : 0) |
+		((cmd->indices != NULL) ? JM_CAPTURE_DRAW_INDICES : 0);
+
+	// pointers are restored on load
+	jm_render_command_draw payload = *cmd;
+	payload.vertices = NULL;
+	payload.texcoords = NULL;
+	payload.colors = NULL;
+	payload.indices = NULL;
+
+	bool ok = jm_capture_write_bytes(s, &payload, sizeof(payload));
+	ok = ok && jm_capture_write_bytes(s, &flags, sizeof(flags));
+	ok = ok && jm_capture_write_bytes(s, cmd->vertices, (uint64_t)sizeof(jm_vertex) * cmd->vertexCount);
+	if (cmd->texcoords != NULL)
+	{
+		ok = ok && jm_capture_write_bytes(s, cmd->texcoords, (uint64_t)sizeof(jm_texcoord) * cmd->vertexCount);
+	}
+	if (cmd->colors != NULL)
+	{
+		ok = ok && jm_capture_write_bytes(s, cmd->colors, (uint64_t)sizeof(jm_color32) * cmd->vertexCount);
+	}
+	if (cmd->indices != NULL)
+	{
+		const size_t indexSize = cmd->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		ok = ok && jm_capture_write_bytes(s, cmd->indices, (uint64_t)indexSize * cmd->indexCount);
+	}
+	return ok;
+}
+
+// Meshes are written like draw commands, their texture and layout first.
+static bool jm_capture_write_mesh(
+	jm_capture_stream* s,
+	const jm_mesh_desc* mesh)
+{
+	const uint8_t flags =
+		((mesh->texcoords != NULL) ? JM_CAPTURE_DRAW_TEXCOORDS : 0) |
+		((mesh->indices != NULL) ? JM_CAPTURE_DRAW_INDICES : 0);
+	const uint8_t isIndex32 = mesh->isIndex32;
+	const size_t indexSize = mesh->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+
+	bool ok = jm_capture_write_bytes(s, &mesh->vertexCount, sizeof(mesh->vertexCount));
+	ok = ok && jm_capture_write_bytes(s, &mesh->indexCount, sizeof(mesh->indexCount));
+	ok = ok && jm_capture_write_bytes(s, &mesh->textureHandle, sizeof(mesh->textureHandle));
+	ok = ok && jm_capture_write_bytes(s, &mesh->topology, sizeof(mesh->topology));
+	ok = ok && jm_capture_write_bytes(s, &isIndex32, sizeof(isIndex32));
+	ok = ok && jm_capture_write_bytes(s, &flags, sizeof(flags));
+	ok = ok && jm_capture_write_bytes(s, mesh->vertices, (uint64_t)sizeof(jm_vertex) * mesh->vertexCount);
+	if (mesh->texcoords != NULL)
+	{
+		ok = ok && jm_capture_write_bytes(s, mesh->texcoords, (uint64_t)sizeof(jm_texcoord) * mesh->vertexCount);
+	}
+	if (mesh->indices != NULL)
+	{
+		ok = ok && jm_capture_write_bytes(s, mesh->indices, (uint64_t)indexSize * mesh->indexCount);
+	}
+	return ok;
+}
+
+static bool jm_capture_write_draw_text(
+	jm_capture_stream* s,
+	const jm_render_command_draw_text* cmd)
+{
+	jm_render_command_draw_text payload = *cmd;
+	payload.text = NULL;
+
+	return jm_capture_write_bytes(s, &payload, sizeof(payload)) && jm_capture_write_string(s, cmd->text);
+}
+
+// The mesh's generation follows the command, so a draw of a reused handle
+// doesn't hash the same as a draw of the mesh it replaced.
+static bool jm_capture_write_draw_mesh(
+	jm_capture_stream* s,
+	const jm_render_command_draw_mesh* cmd)
+{
+	const uint32_t generation = jm_mesh_get_generation(cmd->meshHandle);
+	return jm_capture_write_bytes(s, cmd, sizeof(*cmd)) && jm_capture_write_bytes(s, &generation, sizeof(generation));
+}
+
+static bool jm_capture_write_draw_sprites(
+	jm_capture_stream* s,
+	const jm_render_command_draw_sprites* cmd)
+{
+	jm_render_command_draw_sprites payload = *cmd;
+	payload.sprites = NULL;
+
+	return jm_capture_write_bytes(s, &payload, sizeof(payload)) &&
+		jm_capture_write_bytes(s, cmd->sprites, sizeof(jm_sprite) * cmd->spriteCount);
+}
+
+static bool jm_capture_write_command(
+	jm_capture_stream* s,
+	const jm_command_buffer* cb,
+	size_t index)
+{
+	const void* cmd;
+	const jm_render_command_dispatcher dispatcher = jm_command_buffer_get_command(cb, index, &cmd);
+
+	uint8_t id = 0;
+	while (id < JM_CAPTURE_COMMAND_COUNT && g_captureDispatchers[id] != dispatcher)
+	{
+		++id;
+	}
+	if (id == JM_CAPTURE_COMMAND_COUNT)
+	{
+		fprintf(stderr, "[ERROR] Can't capture command %u, its type is unknown\n", (uint32_t)index);
+		return false;
+	}
+
+	const uint64_t key = cb->keys[index];
+	if (!jm_capture_write_bytes(s, &id, sizeof(id)) || !jm_capture_write_bytes(s, &key, sizeof(key)))
+	{
+		return false;
+	}
+
+	switch (id)
+	{
+	case JM_CAPTURE_COMMAND_DRAW:
+		return jm_capture_write_draw(s, cmd);
+	case JM_CAPTURE_COMMAND_DRAW_TEXT:
+		return jm_capture_write_draw_text(s, cmd);
+	case JM_CAPTURE_COMMAND_DRAW_SPRITES:
+		return jm_capture_write_draw_sprites(s, cmd);
+	case JM_CAPTURE_COMMAND_DRAW_MESH:
+		return jm_capture_write_draw_mesh(s, cmd);
+	case JM_CAPTURE_COMMAND_BEGIN_RENDER_TARGET:
+	case JM_CAPTURE_COMMAND_END_RENDER_TARGET:
+		// no pointers to follow
+		return jm_capture_write_bytes(s, cmd, g_captureCommandSizes[id]);
+	default:
+		return false;
+	}
+}
+
+// The transforms, views and commands, which is all that changes between 
+// frames.
+static bool jm_capture_write_recording(
+	jm_capture_stream* s,
+	const jm_command_buffer* cb)
+{
+	bool ok = jm_capture_write_bytes(s, cb->transforms, sizeof(float[16]) * cb->transformCount);
+	ok = ok && jm_capture_write_bytes(s, cb->views, sizeof(jm_view) * cb->viewCount);
+	for (size_t i = 0; ok && i < cb->commandIt; ++i)
+	{
+		ok = jm_capture_write_command(s, cb, i);
+	}
+	return ok;
+}
+
+void jm_capture_request(
+	const char* path)
+{
+	free(g_capturePath);
+	g_capturePath = malloc(strlen(path) + 1);
+	strcpy(g_capturePath, path);
+}
+
+void jm_capture_end_frame(
+	const jm_command_buffer* cb,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pixelScale)
+{
+	if (g_capturePath == NULL)
+	{
+		return;
+	}
+
+	if (jm_capture_write(cb, g_capturePath, width, height, pixelScale))
+	{
+		printf("Captured %u commands to '%s'\n", (uint32_t)cb->commandIt, g_capturePath);
+	}
+
+	free(g_capturePath);
+	g_capturePath = NULL;
+}
+
+bool jm_capture_write(
+	const jm_command_buffer* cb,
+	const char* path,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pixelScale)
+{
+	jm_capture_stream stream;
+	stream.file = fopen(path, "wb");
+	stream.hash = 0;
+	if (stream.file == NULL)
+	{
+		fprintf(stderr, "[ERROR] Can't open '%s' for writing\n", path);
+		return false;
+	}
+	jm_capture_stream* s = &stream;
+
+	jm_capture_header header;
+	header.magic = JM_CAPTURE_MAGIC;
+	header.version = JM_CAPTURE_VERSION;
+	header.width = width;
+	header.height = height;
+	header.pixelScale = pixelScale;
+	header.textureCount = jm_textures_get_count();
+	header.fontCount = jm_fonts_get_count();
+	header.meshCount = jm_meshes_get_count();
+	header.transformCount = cb->transformCount;
+	header.viewCount = cb->viewCount;
+	header.commandCount = (uint32_t)cb->commandIt;
+
+	bool ok = jm_capture_write_bytes(s, &header, sizeof(header));
+
+	// every resource is listed in load order, so loading them again in the
+	// same order reproduces the handles the commands refer to. Render targets 
+	// have an empty path and are followed by their size and transparency.
+	for (uint32_t i = 0; ok && i < header.textureCount; ++i)
+	{
+		if (jm_texture_is_render_target(i))
+		{
+			const jm_texture_info* info = jm_texture_get_info(i);
+			const uint8_t isSemitransparent = info->isSemitransparent;
+			ok = jm_capture_write_string(s, "") &&
+				jm_capture_write_bytes(s, &info->width, sizeof(info->width)) &&
+				jm_capture_write_bytes(s, &info->height, sizeof(info->height)) &&
+				jm_capture_write_bytes(s, &isSemitransparent, sizeof(isSemitransparent));
+		}
+		else
+		{
+			ok = jm_capture_write_string(s, jm_texture_get_path(i));
+		}
+	}
+	for (uint32_t i = 0; ok && i < header.fontCount; ++i)
+	{
+		const uint32_t size = jm_font_get_size(i);
+		ok = jm_capture_write_bytes(s, &size, sizeof(size)) && jm_capture_write_string(s, jm_font_get_path(i));
+	}
+	// meshes are listed by handle, released ones only by a flag
+	for (uint32_t i = 0; ok && i < header.meshCount; ++i)
+	{
+		const uint8_t isAlive = jm_mesh_is_alive(i);
+		ok = jm_capture_write_bytes(s, &isAlive, sizeof(isAlive));
+		ok = ok && (!isAlive || jm_capture_write_mesh(s, jm_mesh_get_desc(i)));
+	}
+
+	ok = ok && jm_capture_write_recording(s, cb);
+
+	fclose(stream.file);
+	if (!ok)
+	{
+		fprintf(stderr, "[ERROR] Failed to write capture '%s'\n", path);
+	}
+	return ok;
+}
+
+uint64_t jm_capture_hash(
+	const jm_command_buffer* cb)
+{
+	jm_capture_stream stream;
+	stream.file = NULL;
+	stream.hash = 0;
+	if (!jm_capture_write_recording(&stream, cb))
+	{
+		// recordings that can't be captured are never treated as unchanged
+		return 0;
+	}
+	return stream.hash;
+}
+
+static bool jm_replay_read_bytes(
+	FILE* f,
+	void* data,
+	size_t size)
+{
+	return size == 0 || fread(data, 1, size, f) == size;
+}
+
+// Lengths in the capture are checked against the rest of the file before 
+// anything is allocated for them, so a corrupt length stops the replay.
+static bool jm_replay_has_bytes(
+	FILE* f,
+	uint64_t size)
+{
+	const long position = ftell(f);
+	if (position < 0 || fseek(f, 0, SEEK_END) != 0)
+	{
+		return false;
+	}
+	const long end = ftell(f);
+	if (fseek(f, position, SEEK_SET) != 0 || end < position)
+	{
+		return false;
+	}
+	if (size > (uint64_t)(end - position))
+	{
+		fprintf(stderr, "[ERROR] Capture has a length of %" PRIu64 " bytes, only %ld are left\n", size, end - position);
+		return false;
+	}
+	return true;
+}
+
+// Returns a null-terminated copy in command memory, or NULL on failure.
+static char* jm_replay_read_string(
+	FILE* f,
+	jm_command_buffer* cb)
+{
+	uint32_t length;
+	if (!jm_replay_read_bytes(f, &length, sizeof(length)) || !jm_replay_has_bytes(f, length))
+	{
+		return NULL;
+	}
+	char* str = jm_command_buffer_alloc(cb, length + 1);
+	if (!jm_replay_read_bytes(f, str, length))
+	{
+		return NULL;
+	}
+	str[length] = '\0';
+	return str;
+}
+
+// Reads an array into command memory.
+static void* jm_replay_read_array(
+	FILE* f,
+	jm_command_buffer* cb,
+	uint64_t size)
+{
+	if (!jm_replay_has_bytes(f, size))
+	{
+		return NULL;
+	}
+	void* data = jm_command_buffer_alloc(cb, size);
+	return jm_replay_read_bytes(f, data, size) ? data : NULL;
+}
+
+static bool jm_replay_read_draw(
+	FILE* f,
+	jm_command_buffer* cb,
+	jm_render_command_draw* cmd)
+{
+	uint8_t flags;
+	if (!jm_replay_read_bytes(f, &flags, sizeof(flags)))
+	{
+		return false;
+	}
+
+	cmd->vertices = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_vertex) * cmd->vertexCount);
+	if (cmd->vertices == NULL)
+	{
+		return false;
+	}
+	if (flags & JM_CAPTURE_DRAW_TEXCOORDS)
+	{
+		cmd->texcoords = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_texcoord) * cmd->vertexCount);
+		if (cmd->texcoords == NULL)
+		{
+			return false;
+		}
+	}
+	if (flags & JM_CAPTURE_DRAW_COLORS)
+	{
+		cmd->colors = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_color32) * cmd->vertexCount);
+		if (cmd->colors == NULL)
+		{
+			return false;
+		}
+	}
+	if (flags & JM_CAPTURE_DRAW_INDICES)
+	{
+		const size_t indexSize = cmd->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		cmd->indices = jm_replay_read_array(f, cb, (uint64_t)indexSize * cmd->indexCount);
+		if (cmd->indices == NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool jm_replay_read_mesh(
+	FILE* f,
+	jm_command_buffer* cb,
+	jm_mesh_desc* mesh)
+{
+	uint8_t isIndex32;
+	uint8_t flags;
+	if (!jm_replay_read_bytes(f, &mesh->vertexCount, sizeof(mesh->vertexCount)) ||
+		!jm_replay_read_bytes(f, &mesh->indexCount, sizeof(mesh->indexCount)) ||
+		!jm_replay_read_bytes(f, &mesh->textureHandle, sizeof(mesh->textureHandle)) ||
+		!jm_replay_read_bytes(f, &mesh->topology, sizeof(mesh->topology)) ||
+		!jm_replay_read_bytes(f, &isIndex32, sizeof(isIndex32)) ||
+		!jm_replay_read_bytes(f, &flags, sizeof(flags)))
+	{
+		return false;
+	}
+	mesh->isIndex32 = isIndex32 != 0;
+	mesh->texcoords = NULL;
+	mesh->indices = NULL;
+
+	mesh->vertices = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_vertex) * mesh->vertexCount);
+	if (mesh->vertices == NULL)
+	{
+		return false;
+	}
+	if (flags & JM_CAPTURE_DRAW_TEXCOORDS)
+	{
+		mesh->texcoords = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_texcoord) * mesh->vertexCount);
+		if (mesh->texcoords == NULL)
+		{
+			return false;
+		}
+	}
+	if (flags & JM_CAPTURE_DRAW_INDICES)
+	{
+		const size_t indexSize = mesh->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		mesh->indices = jm_replay_read_array(f, cb, (uint64_t)indexSize * mesh->indexCount);
+		if (mesh->indices == NULL)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool jm_replay_read_command(
+	FILE* f,
+	jm_command_buffer* cb,
+	const jm_replay* replay)
+{
+	uint8_t id;
+	uint64_t key;
+	if (!jm_replay_read_bytes(f, &id, sizeof(id)) || !jm_replay_read_bytes(f, &key, sizeof(key)))
+	{
+		return false;
+	}
+	if (id >= JM_CAPTURE_COMMAND_COUNT)
+	{
+		fprintf(stderr, "[ERROR] Unknown command type %u in capture\n", id);
+		return false;
+	}
+
+	void* cmd = jm_command_buffer_push(cb, g_captureCommandSizes[id], g_captureDispatchers[id]);
+	// the key already has the pass of the command
+	cb->keys[cb->commandIt - 1] = key;
+	if (!jm_replay_read_bytes(f, cmd, g_captureCommandSizes[id]))
+	{
+		return false;
+	}
+
+	switch (id)
+	{
+	case JM_CAPTURE_COMMAND_DRAW:
+		return jm_replay_read_draw(f, cb, cmd);
+	case JM_CAPTURE_COMMAND_DRAW_TEXT:
+	{
+		jm_render_command_draw_text* textCmd = cmd;
+		textCmd->text = jm_replay_read_string(f, cb);
+		return textCmd->text != NULL;
+	}
+	case JM_CAPTURE_COMMAND_DRAW_SPRITES:
+	{
+		jm_render_command_draw_sprites* spritesCmd = cmd;
+		spritesCmd->sprites = jm_replay_read_array(f, cb, (uint64_t)sizeof(jm_sprite) * spritesCmd->spriteCount);
+		return spritesCmd->sprites != NULL;
+	}
+	case JM_CAPTURE_COMMAND_DRAW_MESH:
+	{
+		jm_render_command_draw_mesh* meshCmd = cmd;
+		uint32_t generation;
+		if (!jm_replay_read_bytes(f, &generation, sizeof(generation)) ||
+			meshCmd->meshHandle >= replay->header.meshCount ||
+			replay->meshHandles[meshCmd->meshHandle] == JM_MESH_HANDLE_INVALID)
+		{
+			return false;
+		}
+		meshCmd->meshHandle = replay->meshHandles[meshCmd->meshHandle];
+		return true;
+	}
+	case JM_CAPTURE_COMMAND_BEGIN_RENDER_TARGET:
+	case JM_CAPTURE_COMMAND_END_RENDER_TARGET:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool jm_replay_open(
+	jm_replay* replay,
+	const char* path)
+{
+	replay->keys = NULL;
+	replay->meshHandles = NULL;
+	replay->file = fopen(path, "rb");
+	if (replay->file == NULL)
+	{
+		fprintf(stderr, "[ERROR] Can't open capture '%s'\n", path);
+		return false;
+	}
+
+	if (!jm_replay_read_bytes(replay->file, &replay->header, sizeof(replay->header)) ||
+		replay->header.magic != JM_CAPTURE_MAGIC)
+	{
+		fprintf(stderr, "[ERROR] '%s' is not a capture\n", path);
+		jm_replay_close(replay);
+		return false;
+	}
+	if (replay->header.version != JM_CAPTURE_VERSION)
+	{
+		fprintf(stderr, "[ERROR] Capture '%s' has version %u, expected %u\n", path, replay->header.version, JM_CAPTURE_VERSION);
+		jm_replay_close(replay);
+		return false;
+	}
+	if (replay->header.transformCount == 0 || replay->header.transformCount > JM_TRANSFORM_PALETTE_SIZE)
+	{
+		fprintf(stderr, "[ERROR] Capture '%s' has an invalid transform palette\n", path);
+		jm_replay_close(replay);
+		return false;
+	}
+	if (replay->header.viewCount == 0 || replay->header.viewCount > JM_VIEW_PALETTE_SIZE)
+	{
+		fprintf(stderr, "[ERROR] Capture '%s' has an invalid view palette\n", path);
+		jm_replay_close(replay);
+		return false;
+	}
+	return true;
+}
+
+bool jm_replay_load(
+	jm_replay* replay,
+	jm_command_buffer* cb)
+{
+	FILE* f = replay->file;
+	const jm_capture_header* header = &replay->header;
+
+	// resource paths and mesh data are only needed while loading
+	jm_command_buffer_begin(cb);
+
+	for (uint32_t i = 0; i < header->textureCount; ++i)
+	{
+		const char* path = jm_replay_read_string(f, cb);
+		if (path == NULL)
+		{
+			return false;
+		}
+		jm_texture_handle handle;
+		if (path[0] == '\0')
+		{
+			uint32_t size[2];
+			uint8_t isSemitransparent;
+			if (!jm_replay_read_bytes(f, size, sizeof(size)) ||
+				!jm_replay_read_bytes(f, &isSemitransparent, sizeof(isSemitransparent)))
+			{
+				return false;
+			}
+			handle = jm_create_render_target(size[0], size[1]);
+			if (handle != JM_TEXTURE_HANDLE_INVALID)
+			{
+				jm_texture_set_semitransparent(handle, isSemitransparent != 0);
+			}
+		}
+		else
+		{
+			handle = jm_load_texture(path);
+		}
+		if (handle != JM_TEXTURE_HANDLE_INVALID && handle != i)
+		{
+			fprintf(stderr, "[ERROR] Texture '%s' got handle %u instead of %u\n", path, handle, i);
+			return false;
+		}
+	}
+	for (uint32_t i = 0; i < header->fontCount; ++i)
+	{
+		uint32_t size;
+		if (!jm_replay_read_bytes(f, &size, sizeof(size)))
+		{
+			return false;
+		}
+		const char* path = jm_replay_read_string(f, cb);
+		if (path == NULL)
+		{
+			return false;
+		}
+		const jm_font_handle handle = jm_load_font(path, size);
+		if (handle != JM_FONT_HANDLE_INVALID && handle != i)
+		{
+			fprintf(stderr, "[ERROR] Font '%s' got handle %u instead of %u\n", path, handle, i);
+			return false;
+		}
+	}
+	// released meshes leave holes, so the captured handles are mapped to new ones
+	if (!jm_replay_has_bytes(f, header->meshCount))
+	{
+		return false;
+	}
+	replay->meshHandles = malloc(sizeof(jm_mesh_handle) * header->meshCount);
+	for (uint32_t i = 0; i < header->meshCount; ++i)
+	{
+		uint8_t isAlive;
+		jm_mesh_desc mesh;
+		replay->meshHandles[i] = JM_MESH_HANDLE_INVALID;
+		if (!jm_replay_read_bytes(f, &isAlive, sizeof(isAlive)))
+		{
+			return false;
+		}
+		if (!isAlive)
+		{
+			continue;
+		}
+		if (!jm_replay_read_mesh(f, cb, &mesh))
+		{
+			return false;
+		}
+		replay->meshHandles[i] = jm_create_mesh(&mesh);
+	}
+
+	jm_command_buffer_begin(cb);
+
+	// entry 0 of both palettes is the identity in every command buffer
+	float (*transforms)[16] = malloc(sizeof(float[16]) * header->transformCount);
+	bool ok = jm_replay_read_bytes(f, transforms, sizeof(float[16]) * header->transformCount);
+	for (uint32_t i = 1; ok && i < header->transformCount; ++i)
+	{
+		jm_command_buffer_push_transform(cb, transforms[i]);
+	}
+	free(transforms);
+
+	jm_view views[JM_VIEW_PALETTE_SIZE];
+	ok = ok && jm_replay_read_bytes(f, views, sizeof(jm_view) * header->viewCount);
+	for (uint32_t i = 1; ok && i < header->viewCount; ++i)
+	{
+		jm_command_buffer_push_view(cb, &views[i]);
+	}
+
+	for (uint32_t i = 0; ok && i < header->commandCount; ++i)
+	{
+		ok = jm_replay_read_command(f, cb, replay);
+	}
+	if (!ok)
+	{
+		fprintf(stderr, "[ERROR] Capture is truncated or corrupt\n");
+		return false;
+	}
+
+	replay->keys = malloc(sizeof(uint64_t) * header->commandCount);
+	memcpy(replay->keys, cb->keys, sizeof(uint64_t) * header->commandCount);
+	return true;
+}
+
+void jm_replay_restore(
+	const jm_replay* replay,
+	jm_command_buffer* cb)
+{
+	jm_assert(cb->commandIt == replay->header.commandCount);
+	memcpy(cb->keys, replay->keys, sizeof(uint64_t) * replay->header.commandCount);
+}
+
+void jm_replay_close(
+	jm_replay* replay)
+{
+	if (replay->file != NULL)
+	{
+		fclose(replay->file);
+		replay->file = NULL;
+	}
+	free(replay->keys);
+	replay->keys = NULL;
+	free(replay->meshHandles);
+	replay->meshHandles = NULL;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <jammy/command_buffer.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+// Captures are binary files holding one frame's recorded commands, their
+// data and the resources they refer to, so the renderer can be run and timed
+// without the game. They are only valid for the build that wrote them.
+#define JM_CAPTURE_MAGIC 0x42434a4a // "JJCB"
+#define JM_CAPTURE_VERSION 6
+
+typedef struct jm_capture_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t pixelScale;
+	uint32_t textureCount;
+	uint32_t fontCount;
+	uint32_t meshCount;
+	uint32_t transformCount;
+	uint32_t viewCount;
+	uint32_t commandCount;
+} jm_capture_header;
+
+// Captures the frame that is being recorded once it's complete.
+void jm_capture_request(
+	const char* path);
+
+// Writes the capture if one was requested. Called after the game has
+// recorded its commands and before they are sorted.
+void jm_capture_end_frame(
+	const jm_command_buffer* cb,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pixelScale);
+
+bool jm_capture_write(
+	const jm_command_buffer* cb,
+	const char* path,
+	uint32_t width,
+	uint32_t height,
+	uint32_t pixelScale);
+
+// Hashes the transforms, views and commands the way they would be captured, so 
+// recordings hash the same whichever buffer their data is in. Returns 0 for 
+// recordings that can't be captured.
+uint64_t jm_capture_hash(
+	const jm_command_buffer* cb);
+
+typedef struct jm_replay
+{
+	FILE* file;
+	jm_capture_header header;
+	// sorting reorders the keys in place, so they are restored every frame
+	uint64_t* keys;
+	// the handle each captured mesh got, or JM_MESH_HANDLE_INVALID
+	jm_mesh_handle* meshHandles;
+} jm_replay;
+
+// Reads the header, which has what's needed to create the window.
+bool jm_replay_open(
+	jm_replay* replay,
+	const char* path);
+
+// Loads the resources and records the commands into cb. Needs a renderer.
+bool jm_replay_load(
+	jm_replay* replay,
+	jm_command_buffer* cb);
+
+// Resets cb to the recorded state, so it can be sorted and executed again.
+void jm_replay_restore(
+	const jm_replay* replay,
+	jm_command_buffer* cb);
+
+void jm_replay_close(
+	jm_replay* replay);
@@ -61,4 +61,25 @@ void jm_unpack_color32_rgba_f32(
 	*g = g8 / 255.0f;
 	*b = b8 / 255.0f;
 	*a = a8 / 255.0f;
+}
+
+jm_color32 jm_modulate_color32(
+	jm_color32 a,
+	jm_color32 b)
+{
+	if (b == 0xffffffff)
+	{
+		return a;
+	}
+
+	uint32_t result = 0;
+	for (uint32_t shift = 0; shift < 32; shift += 8)
+	{
+		const uint32_t ca = (a >> shift) & 0xff;
+		const uint32_t cb = (b >> shift) & 0xff;
+		// rounded division by 255
+		const uint32_t c = ca * cb + 128;
+		result |= (((c + (c >> 8)) >> 8) & 0xff) << shift;
+	}
+	return result;
 }
\ No newline at end of file
@@ -18,4 +18,9 @@ void jm_unpack_color32_rgba_f32(
 	float* r,
 	float* g,
 	float* b,
-	float* a);
\ No newline at end of file
+	float* a);
+
+// Component-wise product of two colors.
+jm_color32 jm_modulate_color32(
+	jm_color32 a,
+	jm_color32 b);
\ No newline at end of file
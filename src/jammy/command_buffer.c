@@ -8,40 +8,251 @@
 #include <malloc.h>
 #include <stdlib.h>
 #include <memory.h>
+#include <string.h>
+#include <stdio.h>
+
+#define JM_COMMAND_BUFFER_ALIGNMENT 8
 
 jm_command_buffer* g_currentCommandBuffer = NULL;
 
+static void* jm_command_buffer_checked_realloc(
+	void* mem,
+	size_t size)
+{
+	void* newMem = realloc(mem, size);
+	if (newMem == NULL)
+	{
+		fprintf(stderr, "[ERROR] Out of memory for render commands\n");
+		exit(1);
+	}
+	return newMem;
+}
+
+static jm_command_buffer_chunk* jm_command_buffer_chunk_create(
+	size_t capacity)
+{
+	jm_command_buffer_chunk* chunk = jm_command_buffer_checked_realloc(NULL, sizeof(jm_command_buffer_chunk) + capacity);
+	chunk->next = NULL;
+	chunk->data = (char*)(chunk + 1);
+	chunk->capacity = capacity;
+	return chunk;
+}
+
+static void jm_command_buffer_set_chunk(
+	jm_command_buffer* cb,
+	jm_command_buffer_chunk* chunk)
+{
+	cb->currentChunk = chunk;
+	cb->bufferIt = chunk->data;
+	cb->bufferEnd = chunk->data + chunk->capacity;
+}
+
+static size_t jm_command_buffer_used_size(
+	const jm_command_buffer* cb)
+{
+	return cb->previousChunksSize + (size_t)(cb->bufferIt - cb->currentChunk->data);
+}
+
+// Returns contiguous memory for size bytes, moving on to the next chunk if the 
+// current one is full.
+static char* jm_command_buffer_reserve(
+	jm_command_buffer* cb,
+	size_t size)
+{
+	size = (size + JM_COMMAND_BUFFER_ALIGNMENT - 1) & ~(size_t)(JM_COMMAND_BUFFER_ALIGNMENT - 1);
+
+	if (cb->bufferIt + size > cb->bufferEnd)
+	{
+		jm_command_buffer_chunk* chunk = cb->currentChunk;
+		cb->previousChunksSize += (size_t)(cb->bufferIt - chunk->data);
+
+		// reuse a pooled chunk if it's big enough, otherwise insert a new one
+		if (chunk->next == NULL || chunk->next->capacity < size)
+		{
+			const size_t capacity = (size > cb->chunkSize) ? size : cb->chunkSize;
+			jm_command_buffer_chunk* newChunk = jm_command_buffer_chunk_create(capacity);
+			newChunk->next = chunk->next;
+			chunk->next = newChunk;
+		}
+
+		jm_command_buffer_set_chunk(cb, chunk->next);
+	}
+
+	char* mem = cb->bufferIt;
+	cb->bufferIt += size;
+	return mem;
+}
+
+static void jm_command_buffer_grow_commands(
+	jm_command_buffer* cb,
+	size_t maxCommands)
+{
+	cb->maxCommands = maxCommands;
+	cb->commands = jm_command_buffer_checked_realloc(cb->commands, sizeof(void*) * maxCommands);
+	cb->keys = jm_command_buffer_checked_realloc(cb->keys, sizeof(uint64_t) * maxCommands);
+	cb->indices = jm_command_buffer_checked_realloc(cb->indices, sizeof(uint32_t) * maxCommands);
+	cb->sortKeys = jm_command_buffer_checked_realloc(cb->sortKeys, sizeof(uint64_t) * maxCommands);
+	cb->sortIndices = jm_command_buffer_checked_realloc(cb->sortIndices, sizeof(uint32_t) * maxCommands);
+}
+
+static void jm_command_buffer_reset_palettes(
+	jm_command_buffer* cb)
+{
+	static const float identity[16] = 
+	{
+		1.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+	};
+	memcpy(cb->transforms[JM_TRANSFORM_INDEX_IDENTITY], identity, sizeof(identity));
+	cb->transformCount = 1;
+
+	jm_view* view = &cb->views[JM_VIEW_INDEX_DEFAULT];
+	memcpy(view->transform, identity, sizeof(identity));
+	view->viewport[0] = 0.0f;
+	view->viewport[1] = 0.0f;
+	view->viewport[2] = 1.0f;
+	view->viewport[3] = 1.0f;
+	cb->viewCount = 1;
+}
+
 int jm_command_buffer_init(
 	jm_command_buffer* cb,
 	size_t size,
 	size_t maxCommands)
 {
-	cb->maxCommands = maxCommands;
-	cb->capacity = size;
-	cb->buffer = malloc(size);
-	cb->commands = malloc(sizeof(void*) * maxCommands);
-	cb->keys = malloc(sizeof(int32_t) * maxCommands);
-	cb->indices = malloc(sizeof(uint32_t) * maxCommands);
+	cb->chunkSize = size;
+	cb->firstChunk = jm_command_buffer_chunk_create(size);
+	cb->previousChunksSize = 0;
+	cb->highWaterMark = 0;
+	jm_command_buffer_set_chunk(cb, cb->firstChunk);
+
+	cb->commandIt = 0;
+	cb->commands = NULL;
+	cb->keys = NULL;
+	cb->indices = NULL;
+	cb->sortKeys = NULL;
+	cb->sortIndices = NULL;
+	jm_command_buffer_grow_commands(cb, maxCommands);
+
+	cb->transforms = jm_command_buffer_checked_realloc(NULL, sizeof(float[16]) * JM_TRANSFORM_PALETTE_SIZE);
+	cb->generation = 0;
+	jm_command_buffer_reset_palettes(cb);
+	cb->pass = JM_RENDER_PASS_FRAMEBUFFER;
+	cb->passCount = 0;
+	cb->culledCount = 0;
+	cb->capturePath = NULL;
 	return 0;
 }
 
 void jm_command_buffer_destroy(
 	jm_command_buffer* cb)
 {
-	free(cb->buffer);
+	jm_command_buffer_chunk* chunk = cb->firstChunk;
+	while (chunk)
+	{
+		jm_command_buffer_chunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
 	free(cb->commands);
 	free(cb->keys);
 	free(cb->indices);
+	free(cb->sortKeys);
+	free(cb->sortIndices);
+	free(cb->transforms);
 }
 
 int jm_command_buffer_begin(
 	jm_command_buffer* cb)
 {
-	cb->bufferIt = cb->buffer;
+	const size_t usedSize = jm_command_buffer_used_size(cb);
+	if (usedSize > cb->highWaterMark)
+	{
+		cb->highWaterMark = usedSize;
+	}
+
+	cb->previousChunksSize = 0;
+	jm_command_buffer_set_chunk(cb, cb->firstChunk);
 	cb->commandIt = 0;
+	jm_command_buffer_reset_palettes(cb);
+	++cb->generation;
+	cb->pass = JM_RENDER_PASS_FRAMEBUFFER;
+	cb->passCount = 0;
+	cb->culledCount = 0;
+	cb->capturePath = NULL;
 	return 0;
 }
 
+// LSD radix sort of (key, index) pairs, one byte per pass. Passes where every 
+// key has the same digit are skipped, which is the common case for the upper 
+// bytes of the sort key.
+static void jm_radix_sort(
+	uint64_t* keys,
+	uint32_t* indices,
+	uint64_t* tmpKeys,
+	uint32_t* tmpIndices,
+	size_t count)
+{
+	size_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const uint64_t key = keys[i];
+		for (size_t pass = 0; pass < 8; ++pass)
+		{
+			++histograms[pass][(key >> (pass * 8)) & 0xff];
+		}
+	}
+
+	uint64_t* srcKeys = keys;
+	uint32_t* srcIndices = indices;
+	uint64_t* dstKeys = tmpKeys;
+	uint32_t* dstIndices = tmpIndices;
+
+	for (size_t pass = 0; pass < 8; ++pass)
+	{
+		size_t* histogram = histograms[pass];
+		const uint32_t shift = (uint32_t)pass * 8;
+
+		if (histogram[(srcKeys[0] >> shift) & 0xff] == count)
+		{
+			// every key has the same digit
+			continue;
+		}
+
+		size_t offset = 0;
+		for (size_t digit = 0; digit < 256; ++digit)
+		{
+			const size_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const size_t dst = histogram[(srcKeys[i] >> shift) & 0xff]++;
+			dstKeys[dst] = srcKeys[i];
+			dstIndices[dst] = srcIndices[i];
+		}
+
+		uint64_t* swapKeys = srcKeys;
+		uint32_t* swapIndices = srcIndices;
+		srcKeys = dstKeys;
+		srcIndices = dstIndices;
+		dstKeys = swapKeys;
+		dstIndices = swapIndices;
+	}
+
+	if (srcKeys != keys)
+	{
+		memcpy(keys, srcKeys, sizeof(uint64_t) * count);
+		memcpy(indices, srcIndices, sizeof(uint32_t) * count);
+	}
+}
+
 void jm_command_buffer_sort(
 	jm_command_buffer* cb)
 {
@@ -49,7 +260,12 @@ void jm_command_buffer_sort(
 
 	for (size_t i = 0; i < cb->commandIt; ++i)
 	{
-		cb->indices[i] = i;
+		cb->indices[i] = (uint32_t)i;
+	}
+
+	if (cb->commandIt > 1)
+	{
+		jm_radix_sort(cb->keys, cb->indices, cb->sortKeys, cb->sortIndices, cb->commandIt);
 	}
 
 	rmt_EndCPUSample();
@@ -66,7 +282,10 @@ void jm_command_buffer_execute(
 {
 	rmt_BeginCPUSample(jm_command_buffer_execute, 0);
 
-	for (int i = 0; i < cb->commandIt; ++i)
+	jm_draw_context_set_transforms(ctx, (const float(*)[16])cb->transforms, cb->transformCount);
+	jm_draw_context_set_views(ctx, cb->views, cb->viewCount);
+
+	for (uint32_t i = 0; i < cb->commandIt; ++i)
 	{
 		const size_t idx = cb->indices[i];
 		const void* baseAddr = cb->commands[idx];
@@ -76,6 +295,8 @@ void jm_command_buffer_execute(
 		dispatcher(ctx, cmdAddr);
 	}
 
+	jm_draw_context_end(ctx);
+
 	rmt_EndCPUSample();
 }
 
@@ -84,34 +305,130 @@ void* jm_command_buffer_push(
 	size_t commandSize,
 	jm_render_command_dispatcher dispatcher)
 {
-	jm_assert(cb->commandIt < cb->maxCommands);
+	if (cb->commandIt == cb->maxCommands)
+	{
+		jm_command_buffer_grow_commands(cb, cb->maxCommands * 2);
+	}
 
 	const size_t totalSize = sizeof(jm_render_command_dispatcher) + commandSize;
 
-	void* baseAddr = cb->bufferIt;
-	void* cmdAddr = cb->bufferIt + sizeof(jm_render_command_dispatcher);
-	const void* auxAddr = cb->bufferIt + sizeof(jm_render_command_dispatcher) + commandSize;
-
-	jm_assert((char*)baseAddr + totalSize < cb->buffer + cb->capacity);
+	char* baseAddr = jm_command_buffer_reserve(cb, totalSize);
+	void* cmdAddr = baseAddr + sizeof(jm_render_command_dispatcher);
 
 	*(jm_render_command_dispatcher*)baseAddr = dispatcher;
 
-	cb->keys[cb->commandIt] = 0; // todo
+	// commands that don't set a sort key are executed in submission order
+	cb->keys[cb->commandIt] = ((uint64_t)cb->pass << JM_SORT_KEY_PASS_SHIFT) | cb->commandIt;
 	cb->commands[cb->commandIt] = baseAddr;
 
-	cb->bufferIt += totalSize;
 	++cb->commandIt;
 
-	memset(cmdAddr, 0, totalSize);
+	memset(cmdAddr, 0, commandSize);
 
 	return cmdAddr;
 }
 
+void jm_command_buffer_set_sort_key(
+	jm_command_buffer* cb,
+	uint64_t key)
+{
+	jm_assert(cb->commandIt > 0);
+	cb->keys[cb->commandIt - 1] = (key & ~JM_SORT_KEY_PASS_MASK) | ((uint64_t)cb->pass << JM_SORT_KEY_PASS_SHIFT);
+}
+
+void jm_command_buffer_cull(
+	jm_command_buffer* cb)
+{
+	jm_assert(cb->commandIt > 0);
+	char* baseAddr = cb->commands[--cb->commandIt];
+	if (baseAddr >= cb->currentChunk->data && baseAddr < cb->bufferIt)
+	{
+		cb->bufferIt = baseAddr;
+	}
+	++cb->culledCount;
+}
+
+bool jm_command_buffer_begin_pass(
+	jm_command_buffer* cb)
+{
+	if (cb->passCount == JM_RENDER_PASS_FRAMEBUFFER)
+	{
+		return false;
+	}
+	cb->pass = cb->passCount++;
+	return true;
+}
+
+void jm_command_buffer_end_pass(
+	jm_command_buffer* cb)
+{
+	cb->pass = JM_RENDER_PASS_FRAMEBUFFER;
+}
+
 void* jm_command_buffer_alloc(
 	jm_command_buffer* cb,
 	size_t size)
 {
-	void* mem = cb->bufferIt;
-	cb->bufferIt += size;
-	return mem;
+	return jm_command_buffer_reserve(cb, size);
+}
+
+void jm_command_buffer_set_capture_path(
+	jm_command_buffer* cb,
+	const char* path)
+{
+	char* capturePath = jm_command_buffer_alloc(cb, strlen(path) + 1);
+	strcpy(capturePath, path);
+	cb->capturePath = capturePath;
+}
+
+uint16_t jm_command_buffer_push_transform(
+	jm_command_buffer* cb,
+	const float* transform)
+{
+	if (cb->transformCount == JM_TRANSFORM_PALETTE_SIZE)
+	{
+		return JM_TRANSFORM_INDEX_INVALID;
+	}
+	memcpy(cb->transforms[cb->transformCount], transform, sizeof(float[16]));
+	return (uint16_t)cb->transformCount++;
+}
+
+uint8_t jm_command_buffer_push_view(
+	jm_command_buffer* cb,
+	const jm_view* view)
+{
+	if (cb->viewCount == JM_VIEW_PALETTE_SIZE)
+	{
+		return JM_VIEW_INDEX_INVALID;
+	}
+	cb->views[cb->viewCount] = *view;
+	return (uint8_t)cb->viewCount++;
+}
+
+jm_render_command_dispatcher jm_command_buffer_get_command(
+	const jm_command_buffer* cb,
+	size_t index,
+	const void** outCommand)
+{
+	jm_assert(index < cb->commandIt);
+	const void* baseAddr = cb->commands[index];
+	*outCommand = (const char*)baseAddr + sizeof(jm_render_command_dispatcher);
+	return get_command_dispatcher(baseAddr);
+}
+
+void jm_command_buffer_get_stats(
+	const jm_command_buffer* cb,
+	jm_command_buffer_stats* stats)
+{
+	stats->commandCount = cb->commandIt;
+	stats->usedSize = jm_command_buffer_used_size(cb);
+	stats->reservedSize = 0;
+	stats->chunkCount = 0;
+	for (const jm_command_buffer_chunk* chunk = cb->firstChunk; chunk; chunk = chunk->next)
+	{
+		stats->reservedSize += chunk->capacity;
+		++stats->chunkCount;
+	}
+	stats->highWaterMark = (stats->usedSize > cb->highWaterMark) ? stats->usedSize : cb->highWaterMark;
+	stats->culledCount = cb->culledCount;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stdbool.h>
 
 #include <jammy/render_commands.h>
 #include <jammy/texture.h>
@@ -9,22 +10,74 @@
 #define JM_COMMAND_BUFFER_PUSH(CommandBuffer, CommandName) \
 	jm_command_buffer_push(CommandBuffer, sizeof(CommandName), (jm_render_command_dispatcher)__##CommandName)
 
+// Command memory is a chain of chunks. Chunks are kept between frames, so 
+// after the first few frames the buffer holds the high-water mark and 
+// recording doesn't allocate.
+typedef struct jm_command_buffer_chunk
+{
+	struct jm_command_buffer_chunk* next;
+	char* data;
+	size_t capacity;
+} jm_command_buffer_chunk;
+
+typedef struct jm_command_buffer_stats
+{
+	size_t commandCount;
+	size_t usedSize;
+	size_t reservedSize;
+	size_t chunkCount;
+	size_t highWaterMark;
+	size_t culledCount;
+} jm_command_buffer_stats;
+
 typedef struct jm_command_buffer
 {
-	char* buffer;
+	jm_command_buffer_chunk* firstChunk;
+	jm_command_buffer_chunk* currentChunk;
 	char* bufferIt;
-	size_t capacity;
+	char* bufferEnd;
+	size_t chunkSize;
+	// bytes used in the chunks before the current one
+	size_t previousChunksSize;
+	size_t highWaterMark;
 
-	int32_t* keys;
+	uint64_t* keys;
 	void** commands;
 	size_t commandIt;
 	size_t maxCommands;
 
-	size_t* indices;
+	uint32_t* indices;
+
+	// scratch memory for the radix sort
+	uint64_t* sortKeys;
+	uint32_t* sortIndices;
+
+	// transforms referenced by the commands, entry 0 is the identity
+	float (*transforms)[16];
+	uint32_t transformCount;
+	// views referenced by the commands, entry 0 is the identity
+	jm_view views[JM_VIEW_PALETTE_SIZE];
+	uint32_t viewCount;
+	// incremented by jm_command_buffer_begin, so recorders can tell whether 
+	// palette indices they cached still refer to this recording
+	uint32_t generation;
+
+	// pass the commands recorded next are placed in, and the number of render 
+	// target passes begun in this recording
+	uint32_t pass;
+	uint32_t passCount;
+
+	// commands dropped by jm_command_buffer_cull in this recording
+	size_t culledCount;
+
+	// where the rendered frame's pixels are written to, NULL if they aren't
+	const char* capturePath;
 } jm_command_buffer;
 
 extern jm_command_buffer* g_currentCommandBuffer;
 
+// size is the size of each chunk of command memory, and maxCommands the 
+// initial number of commands. Both grow on demand.
 int jm_command_buffer_init(
 	jm_command_buffer* cb,
 	size_t size,
@@ -48,9 +101,59 @@ void* jm_command_buffer_push(
 	size_t commandSize,
 	jm_render_command_dispatcher dispatcher);
 
+// Sets the sort key of the last command. The pass bits of key are replaced 
+// by the current pass.
+void jm_command_buffer_set_sort_key(
+	jm_command_buffer* cb,
+	uint64_t key);
+
+// Drops the last command, which the recorder found to be outside the view. 
+// Its payload memory is reclaimed if nothing was allocated after it in 
+// another chunk.
+void jm_command_buffer_cull(
+	jm_command_buffer* cb);
+
+// Places the commands recorded from now on in a new pass that is executed 
+// before the framebuffer pass. Returns false if every pass is in use.
+bool jm_command_buffer_begin_pass(
+	jm_command_buffer* cb);
+
+// Places the commands recorded from now on in the framebuffer pass again.
+void jm_command_buffer_end_pass(
+	jm_command_buffer* cb);
+
 void* jm_command_buffer_alloc(
 	jm_command_buffer* cb,
 	size_t size);
 
+// Asks for the pixels of this recording to be written to path once it has 
+// been rendered. The path is copied into the command memory.
+void jm_command_buffer_set_capture_path(
+	jm_command_buffer* cb,
+	const char* path);
+
+// Appends a column-major matrix to the transform palette and returns its 
+// index, or JM_TRANSFORM_INDEX_INVALID if the palette is full.
+uint16_t jm_command_buffer_push_transform(
+	jm_command_buffer* cb,
+	const float* transform);
+
+// Appends a view to the view palette and returns its index, or 
+// JM_VIEW_INDEX_INVALID if the palette is full.
+uint8_t jm_command_buffer_push_view(
+	jm_command_buffer* cb,
+	const jm_view* view);
+
+// Returns the dispatcher and payload of the command recorded at index, in 
+// submission order.
+jm_render_command_dispatcher jm_command_buffer_get_command(
+	const jm_command_buffer* cb,
+	size_t index,
+	const void** outCommand);
+
+void jm_command_buffer_get_stats(
+	const jm_command_buffer* cb,
+	jm_command_buffer_stats* stats);
+
 void jm_set_current_command_buffer(
 	jm_command_buffer* cb);
\ No newline at end of file
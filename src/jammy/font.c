@@ -16,10 +16,15 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <math.h>
 
 #define MAX_FONTS 512
+#define MAX_TEXT_LAYOUTS 256
+#define TEXT_LAYOUT_ARENA_GLYPHS 16384
+// longer texts are laid out every time they're drawn
+#define MAX_TEXT_LAYOUT_LENGTH (TEXT_LAYOUT_ARENA_GLYPHS / 4)
 
 typedef struct jm_fonts
 {
@@ -27,6 +32,8 @@ typedef struct jm_fonts
 
 	size_t count;
 	uint64_t* keys;
+	char** paths;
+	uint32_t* sizes;
 	FT_Face* faces;
 
 	jm_font_info* fontInfo;
@@ -34,6 +41,36 @@ typedef struct jm_fonts
 
 jm_fonts g_fonts;
 
+// One corner of a glyph quad, relative to the text's top-left corner
+typedef struct jm_text_vertex
+{
+	float x, y;
+	float u, v;
+} jm_text_vertex;
+
+// A text that was laid out before. Its glyph quads are stored back to back
+// in the arena, 4 vertices per glyph.
+typedef struct jm_text_layout
+{
+	uint64_t key;
+	uint64_t lastUsed;
+	uint32_t textLength;
+	uint32_t offset; // in glyphs
+	uint32_t glyphCount;
+} jm_text_layout;
+
+// Only used by the thread that executes render commands.
+typedef struct jm_text_layouts
+{
+	size_t count;
+	jm_text_layout* layouts; // in arena order
+	jm_text_vertex* arena;
+	uint32_t arenaUsed; // in glyphs
+	uint64_t clock;
+} jm_text_layouts;
+
+jm_text_layouts g_textLayouts;
+
 int jm_fonts_init()
 {
 	FT_Error error = FT_Init_FreeType(&g_fonts.library);
@@ -44,8 +81,16 @@ int jm_fonts_init()
 
 	g_fonts.count = 0;
 	g_fonts.keys = calloc(MAX_FONTS, sizeof(uint64_t));
+	g_fonts.paths = calloc(MAX_FONTS, sizeof(char*));
+	g_fonts.sizes = calloc(MAX_FONTS, sizeof(uint32_t));
 	g_fonts.faces = calloc(MAX_FONTS, sizeof(FT_Face*));
 	g_fonts.fontInfo = calloc(MAX_FONTS, sizeof(jm_font_info));
+
+	g_textLayouts.count = 0;
+	g_textLayouts.layouts = calloc(MAX_TEXT_LAYOUTS, sizeof(jm_text_layout));
+	g_textLayouts.arena = calloc(TEXT_LAYOUT_ARENA_GLYPHS * 4, sizeof(jm_text_vertex));
+	g_textLayouts.arenaUsed = 0;
+	g_textLayouts.clock = 0;
 	return 0;
 }
 
@@ -74,6 +119,9 @@ jm_font_handle jm_load_font(
 
 	const jm_font_handle fontHandle = (jm_font_handle)g_fonts.count++;
 	g_fonts.keys[fontHandle] = key;
+	g_fonts.paths[fontHandle] = malloc(strlen(path) + 1);
+	strcpy(g_fonts.paths[fontHandle], path);
+	g_fonts.sizes[fontHandle] = size;
 
 	FT_Face face;
 	FT_Error error = FT_New_Face(g_fonts.library, path, 0, &face);
@@ -192,6 +240,25 @@ void* jm_font_get_face(
 	return g_fonts.faces[fontHandle];
 }
 
+uint32_t jm_fonts_get_count()
+{
+	return (uint32_t)g_fonts.count;
+}
+
+const char* jm_font_get_path(
+	jm_font_handle fontHandle)
+{
+	jm_assert(fontHandle != JM_FONT_HANDLE_INVALID);
+	return g_fonts.paths[fontHandle];
+}
+
+uint32_t jm_font_get_size(
+	jm_font_handle fontHandle)
+{
+	jm_assert(fontHandle != JM_FONT_HANDLE_INVALID);
+	return g_fonts.sizes[fontHandle];
+}
+
 const jm_font_info* jm_font_get_info(
 	jm_font_handle fontHandle)
 {
@@ -225,31 +292,29 @@ float jm_font_measure_text_range(
 	return textWidth;
 }
 
-void jm_font_get_text_vertices(
+static uint32_t jm_font_layout_text(
 	jm_font_handle fontHandle,
 	const char* text,
+	size_t textLength,
 	float topLeftX,
 	float topLeftY,
 	float width,
 	uint32_t rangeStart,
 	uint32_t rangeEnd,
 	float textScale,
+	float lineSpacing,
 	float* dstPosition,
 	float* dstTexcoord,
-	uint16_t* dstIndex,
-	uint32_t* outIndexCount)
+	uint32_t stride)
 {
 	const jm_font_info* fontInfo = jm_font_get_info(fontHandle);
-	const float lineHeight = fontInfo->height; //* cmd->lineSpacingMultiplier;
+	const float lineHeight = fontInfo->height * lineSpacing;
 	const jm_glyph_info* glyphInfo = fontInfo->glyphs;
 
 	float penX = topLeftX;
 	float penY = topLeftY;
 
-	uint32_t indexCount = 0;
-	uint32_t dstI = 0;
-
-	const size_t textLength = strlen(text);
+	uint32_t glyphCount = 0;
 	for (uint32_t i = 0; i < textLength; ++i)
 	{
 		const char charcode = text[i];
@@ -287,39 +352,249 @@ void jm_font_get_text_vertices(
 			const float w = glyph->width * textScale;
 			const float h = glyph->height * textScale;
 
-			dstPosition[0] = x;
-			dstPosition[1] = y;
-			dstPosition[2] = x + w;
-			dstPosition[3] = y;
-			dstPosition[4] = x;
-			dstPosition[5] = y + h;
-			dstPosition[6] = x + w;
-			dstPosition[7] = y + h;
-
-			dstTexcoord[0] = glyph->u0;
-			dstTexcoord[1] = glyph->v0;
-			dstTexcoord[2] = glyph->u1;
-			dstTexcoord[3] = glyph->v0;
-			dstTexcoord[4] = glyph->u0;
-			dstTexcoord[5] = glyph->v1;
-			dstTexcoord[6] = glyph->u1;
-			dstTexcoord[7] = glyph->v1;
-
-			dstIndex[0] = dstI + 0;
-			dstIndex[1] = dstI + 1;
-			dstIndex[2] = dstI + 2;
-			dstIndex[3] = dstI + 3;
-			dstIndex[4] = UINT16_MAX;
-
-			dstI += 4;
-			dstPosition += 8;
-			dstTexcoord += 8;
-			dstIndex += 5;
-			indexCount += 5;
+			dstPosition[stride * 0 + 0] = x;
+			dstPosition[stride * 0 + 1] = y;
+			dstPosition[stride * 1 + 0] = x + w;
+			dstPosition[stride * 1 + 1] = y;
+			dstPosition[stride * 2 + 0] = x;
+			dstPosition[stride * 2 + 1] = y + h;
+			dstPosition[stride * 3 + 0] = x + w;
+			dstPosition[stride * 3 + 1] = y + h;
+
+			dstTexcoord[stride * 0 + 0] = glyph->u0;
+			dstTexcoord[stride * 0 + 1] = glyph->v0;
+			dstTexcoord[stride * 1 + 0] = glyph->u1;
+			dstTexcoord[stride * 1 + 1] = glyph->v0;
+			dstTexcoord[stride * 2 + 0] = glyph->u0;
+			dstTexcoord[stride * 2 + 1] = glyph->v1;
+			dstTexcoord[stride * 3 + 0] = glyph->u1;
+			dstTexcoord[stride * 3 + 1] = glyph->v1;
+
+			dstPosition += stride * 4;
+			dstTexcoord += stride * 4;
+			++glyphCount;
 		}
 
 		penX += glyph->advance_x * textScale;
 	}
+	return glyphCount;
+}
+
+static uint64_t jm_text_layout_key(
+	jm_font_handle fontHandle,
+	const char* text,
+	float width,
+	uint32_t rangeStart,
+	uint32_t rangeEnd,
+	float textScale,
+	float lineSpacing)
+{
+	uint32_t params[6];
+	params[0] = fontHandle;
+	params[1] = rangeStart;
+	params[2] = rangeEnd;
+	memcpy(&params[3], &width, sizeof(float));
+	memcpy(&params[4], &textScale, sizeof(float));
+	memcpy(&params[5], &lineSpacing, sizeof(float));
+
+	// continue the string's fnv hash with the parameters
+	uint64_t key = jm_fnv(text);
+	for (size_t i = 0; i < sizeof(params) / sizeof(params[0]); ++i)
+	{
+		key *= 1099511628211;
+		key ^= params[i];
+	}
+	return key;
+}
+
+static void jm_text_layouts_remove(
+	size_t index)
+{
+	jm_text_layout* layouts = g_textLayouts.layouts;
+	memmove(&layouts[index], &layouts[index + 1], (g_textLayouts.count - index - 1) * sizeof(jm_text_layout));
+	--g_textLayouts.count;
+}
+
+static size_t jm_text_layouts_find_least_recently_used()
+{
+	size_t lru = 0;
+	for (size_t i = 1; i < g_textLayouts.count; ++i)
+	{
+		if (g_textLayouts.layouts[i].lastUsed < g_textLayouts.layouts[lru].lastUsed)
+		{
+			lru = i;
+		}
+	}
+	return lru;
+}
+
+// Makes room for a layout and up to glyphCount glyphs at the end of the arena
+static void jm_text_layouts_reserve(
+	uint32_t glyphCount)
+{
+	if (g_textLayouts.count == MAX_TEXT_LAYOUTS)
+	{
+		jm_text_layouts_remove(jm_text_layouts_find_least_recently_used());
+	}
+
+	if (g_textLayouts.arenaUsed + glyphCount <= TEXT_LAYOUT_ARENA_GLYPHS)
+	{
+		return;
+	}
+
+	uint32_t liveGlyphCount = 0;
+	for (size_t i = 0; i < g_textLayouts.count; ++i)
+	{
+		liveGlyphCount += g_textLayouts.layouts[i].glyphCount;
+	}
+
+	// evict down to three quarters, so texts that change every frame don't
+	// compact the arena every frame
+	while (g_textLayouts.count > 0 && liveGlyphCount + glyphCount > TEXT_LAYOUT_ARENA_GLYPHS / 4 * 3)
+	{
+		const size_t lru = jm_text_layouts_find_least_recently_used();
+		liveGlyphCount -= g_textLayouts.layouts[lru].glyphCount;
+		jm_text_layouts_remove(lru);
+	}
+
+	// layouts are in arena order, so compacting only moves glyphs to the front
+	uint32_t offset = 0;
+	for (size_t i = 0; i < g_textLayouts.count; ++i)
+	{
+		jm_text_layout* layout = &g_textLayouts.layouts[i];
+		if (layout->offset != offset)
+		{
+			memmove(
+				&g_textLayouts.arena[offset * 4],
+				&g_textLayouts.arena[layout->offset * 4],
+				layout->glyphCount * 4 * sizeof(jm_text_vertex));
+			layout->offset = offset;
+		}
+		offset += layout->glyphCount;
+	}
+	g_textLayouts.arenaUsed = offset;
+}
+
+static const jm_text_layout* jm_font_get_text_layout(
+	jm_font_handle fontHandle,
+	const char* text,
+	size_t textLength,
+	float width,
+	uint32_t rangeStart,
+	uint32_t rangeEnd,
+	float textScale,
+	float lineSpacing)
+{
+	const uint64_t key = jm_text_layout_key(fontHandle, text, width, rangeStart, rangeEnd, textScale, lineSpacing);
+	const uint64_t now = ++g_textLayouts.clock;
+
+	// keys are in arena order, not sorted, so bsearch can't be used here
+	for (size_t i = 0; i < g_textLayouts.count; ++i)
+	{
+		jm_text_layout* layout = &g_textLayouts.layouts[i];
+		if (layout->key == key && layout->textLength == textLength)
+		{
+			layout->lastUsed = now;
+			return layout;
+		}
+	}
+
+	// every character gets a glyph at most, the unused ones are given back
+	jm_text_layouts_reserve((uint32_t)textLength);
+
+	jm_text_layout* layout = &g_textLayouts.layouts[g_textLayouts.count++];
+	layout->key = key;
+	layout->lastUsed = now;
+	layout->textLength = (uint32_t)textLength;
+	layout->offset = g_textLayouts.arenaUsed;
+
+	jm_text_vertex* dst = &g_textLayouts.arena[layout->offset * 4];
+	layout->glyphCount = jm_font_layout_text(
+		fontHandle,
+		text,
+		textLength,
+		0.0f,
+		0.0f,
+		width,
+		rangeStart,
+		rangeEnd,
+		textScale,
+		lineSpacing,
+		&dst->x,
+		&dst->u,
+		sizeof(jm_text_vertex) / sizeof(float));
+	g_textLayouts.arenaUsed += layout->glyphCount;
+	return layout;
+}
+
+void jm_font_get_text_vertices(
+	jm_font_handle fontHandle,
+	const char* text,
+	float topLeftX,
+	float topLeftY,
+	float width,
+	uint32_t rangeStart,
+	uint32_t rangeEnd,
+	float textScale,
+	float lineSpacing,
+	float* dstPosition,
+	float* dstTexcoord,
+	uint32_t vertexStride,
+	uint16_t* dstIndex,
+	uint32_t* outIndexCount)
+{
+	// positions and texcoords may be interleaved with other attributes
+	jm_assert(vertexStride % sizeof(float) == 0);
+	const uint32_t stride = vertexStride / sizeof(float);
+
+	const size_t textLength = strlen(text);
+
+	uint32_t glyphCount;
+	if (textLength > MAX_TEXT_LAYOUT_LENGTH)
+	{
+		// too long to be cached
+		glyphCount = jm_font_layout_text(
+			fontHandle,
+			text,
+			textLength,
+			topLeftX,
+			topLeftY,
+			width,
+			rangeStart,
+			rangeEnd,
+			textScale,
+			lineSpacing,
+			dstPosition,
+			dstTexcoord,
+			stride);
+	}
+	else
+	{
+		const jm_text_layout* layout = jm_font_get_text_layout(fontHandle, text, textLength, width, rangeStart, rangeEnd, textScale, lineSpacing);
+		const jm_text_vertex* src = &g_textLayouts.arena[layout->offset * 4];
+
+		glyphCount = layout->glyphCount;
+		for (uint32_t i = 0; i < glyphCount * 4; ++i)
+		{
+			dstPosition[0] = src[i].x + topLeftX;
+			dstPosition[1] = src[i].y + topLeftY;
+			dstTexcoord[0] = src[i].u;
+			dstTexcoord[1] = src[i].v;
+			dstPosition += stride;
+			dstTexcoord += stride;
+		}
+	}
+
+	// one strip per glyph
+	for (uint32_t i = 0; i < glyphCount; ++i)
+	{
+		dstIndex[0] = (uint16_t)(i * 4 + 0);
+		dstIndex[1] = (uint16_t)(i * 4 + 1);
+		dstIndex[2] = (uint16_t)(i * 4 + 2);
+		dstIndex[3] = (uint16_t)(i * 4 + 3);
+		dstIndex[4] = UINT16_MAX;
+		dstIndex += 5;
+	}
 
-	*outIndexCount = indexCount;
+	*outIndexCount = glyphCount * 5;
 }
@@ -43,9 +43,22 @@ float jm_font_measure_text_range(
 	const char* begin,
 	const char* end);
 
+// Number of handles handed out so far, in load order.
+uint32_t jm_fonts_get_count();
+
+const char* jm_font_get_path(
+	jm_font_handle fontHandle);
+
+uint32_t jm_font_get_size(
+	jm_font_handle fontHandle);
+
 const jm_font_info* jm_font_get_info(
 	jm_font_handle fontHandle);
 
+// Lays out text with its top-left corner at (topLeftX, topLeftY), 4 vertices
+// and 5 strip indices per glyph. Layouts are cached by font, text and
+// parameters apart from the position, so text that is drawn again is copied
+// instead of laid out. Only called by the thread that executes render commands.
 void jm_font_get_text_vertices(
 	jm_font_handle fontHandle,
 	const char* text,
@@ -55,7 +68,9 @@ void jm_font_get_text_vertices(
 	uint32_t rangeStart,
 	uint32_t rangeEnd,
 	float textScale,
+	float lineSpacing,
 	float* dstPosition,
 	float* dstTexcoord,
+	uint32_t vertexStride,
 	uint16_t* dstIndex,
 	uint32_t* outIndexCount);
\ No newline at end of file
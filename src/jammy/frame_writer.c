@@ -0,0 +1,214 @@
+#if defined(JM_LINUX)
+#include "frame_writer.h"
+
+#include <jammy/lodepng/lodepng.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JM_FRAME_WRITER_MAX_THREADS 4
+
+typedef struct jm_frame_job
+{
+	char* path;
+	jm_frame_format format;
+	uint32_t* pixels;
+	uint32_t width;
+	uint32_t height;
+	bool isBottomUp;
+} jm_frame_job;
+
+static struct
+{
+	pthread_t threads[JM_FRAME_WRITER_MAX_THREADS];
+	uint32_t threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t jobQueued;
+	pthread_cond_t jobTaken;
+	// a ring of queued jobs, the oldest at firstJob
+	jm_frame_job jobs[JM_FRAME_WRITER_MAX_QUEUED_FRAMES];
+	uint32_t firstJob;
+	uint32_t jobCount;
+	bool isStopping;
+} g_frameWriter;
+
+jm_frame_format jm_frame_writer_get_format(
+	const char* path)
+{
+	const size_t length = strlen(path);
+	return (length >= 4 && strcmp(path + length - 4, ".png") == 0) ? JM_FRAME_FORMAT_PNG : JM_FRAME_FORMAT_RAW;
+}
+
+static void jm_frame_job_flip(
+	jm_frame_job* job)
+{
+	uint32_t* row = malloc(sizeof(uint32_t) * job->width);
+	for (uint32_t y = 0; y < job->height / 2; ++y)
+	{
+		uint32_t* top = job->pixels + y * job->width;
+		uint32_t* bottom = job->pixels + (job->height - 1 - y) * job->width;
+		memcpy(row, top, sizeof(uint32_t) * job->width);
+		memcpy(top, bottom, sizeof(uint32_t) * job->width);
+		memcpy(bottom, row, sizeof(uint32_t) * job->width);
+	}
+	free(row);
+}
+
+static void jm_frame_job_write(
+	jm_frame_job* job)
+{
+	if (job->isBottomUp)
+	{
+		jm_frame_job_flip(job);
+	}
+
+	if (job->format == JM_FRAME_FORMAT_PNG)
+	{
+		const unsigned error = lodepng_encode32_file(job->path, (const unsigned char*)job->pixels, job->width, job->height);
+		if (error)
+		{
+			fprintf(stderr, "[ERROR] Can't write '%s': %s\n", job->path, lodepng_error_text(error));
+		}
+	}
+	else
+	{
+		const size_t size = sizeof(uint32_t) * job->width * job->height;
+		FILE* file = fopen(job->path, "wb");
+		if (file == NULL || fwrite(job->pixels, 1, size, file) != size)
+		{
+			fprintf(stderr, "[ERROR] Can't write '%s'\n", job->path);
+		}
+		if (file != NULL)
+		{
+			fclose(file);
+		}
+	}
+
+	free(job->path);
+	free(job->pixels);
+}
+
+static void* jm_frame_writer_thread_proc(
+	void* arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&g_frameWriter.mutex);
+	while (true)
+	{
+		while (g_frameWriter.jobCount == 0 && !g_frameWriter.isStopping)
+		{
+			pthread_cond_wait(&g_frameWriter.jobQueued, &g_frameWriter.mutex);
+		}
+		// the queue is drained before stopping
+		if (g_frameWriter.jobCount == 0)
+		{
+			break;
+		}
+
+		jm_frame_job job = g_frameWriter.jobs[g_frameWriter.firstJob];
+		g_frameWriter.firstJob = (g_frameWriter.firstJob + 1) % JM_FRAME_WRITER_MAX_QUEUED_FRAMES;
+		--g_frameWriter.jobCount;
+		pthread_cond_signal(&g_frameWriter.jobTaken);
+		pthread_mutex_unlock(&g_frameWriter.mutex);
+
+		jm_frame_job_write(&job);
+
+		pthread_mutex_lock(&g_frameWriter.mutex);
+	}
+	pthread_mutex_unlock(&g_frameWriter.mutex);
+	return NULL;
+}
+
+static void jm_frame_writer_start()
+{
+	pthread_mutex_init(&g_frameWriter.mutex, NULL);
+	pthread_cond_init(&g_frameWriter.jobQueued, NULL);
+	pthread_cond_init(&g_frameWriter.jobTaken, NULL);
+	g_frameWriter.firstJob = 0;
+	g_frameWriter.jobCount = 0;
+	g_frameWriter.isStopping = false;
+
+	// encoding a PNG takes longer than a frame, so frames recorded every
+	// frame are encoded by several threads at once
+	const long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t threadCount = (processorCount > 2) ? (uint32_t)(processorCount / 2) : 1;
+	if (threadCount > JM_FRAME_WRITER_MAX_THREADS)
+	{
+		threadCount = JM_FRAME_WRITER_MAX_THREADS;
+	}
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		if (pthread_create(&g_frameWriter.threads[i], NULL, jm_frame_writer_thread_proc, NULL))
+		{
+			break;
+		}
+		g_frameWriter.threadCount = i + 1;
+	}
+}
+
+void jm_frame_writer_write(
+	const char* path,
+	jm_frame_format format,
+	uint32_t* pixels,
+	uint32_t width,
+	uint32_t height,
+	bool isBottomUp)
+{
+	jm_frame_job job;
+	job.path = malloc(strlen(path) + 1);
+	strcpy(job.path, path);
+	job.format = format;
+	job.pixels = pixels;
+	job.width = width;
+	job.height = height;
+	job.isBottomUp = isBottomUp;
+
+	if (g_frameWriter.threadCount == 0)
+	{
+		jm_frame_writer_start();
+	}
+	if (g_frameWriter.threadCount == 0)
+	{
+		// without workers the frame is written right away
+		jm_frame_job_write(&job);
+		return;
+	}
+
+	pthread_mutex_lock(&g_frameWriter.mutex);
+	while (g_frameWriter.jobCount == JM_FRAME_WRITER_MAX_QUEUED_FRAMES)
+	{
+		pthread_cond_wait(&g_frameWriter.jobTaken, &g_frameWriter.mutex);
+	}
+	g_frameWriter.jobs[(g_frameWriter.firstJob + g_frameWriter.jobCount) % JM_FRAME_WRITER_MAX_QUEUED_FRAMES] = job;
+	++g_frameWriter.jobCount;
+	pthread_cond_signal(&g_frameWriter.jobQueued);
+	pthread_mutex_unlock(&g_frameWriter.mutex);
+}
+
+void jm_frame_writer_shutdown()
+{
+	if (g_frameWriter.threadCount == 0)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&g_frameWriter.mutex);
+	g_frameWriter.isStopping = true;
+	pthread_cond_broadcast(&g_frameWriter.jobQueued);
+	pthread_mutex_unlock(&g_frameWriter.mutex);
+
+	for (uint32_t i = 0; i < g_frameWriter.threadCount; ++i)
+	{
+		pthread_join(g_frameWriter.threads[i], NULL);
+	}
+	g_frameWriter.threadCount = 0;
+
+	pthread_mutex_destroy(&g_frameWriter.mutex);
+	pthread_cond_destroy(&g_frameWriter.jobQueued);
+	pthread_cond_destroy(&g_frameWriter.jobTaken);
+}
+#endif
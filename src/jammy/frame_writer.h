@@ -0,0 +1,35 @@
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// Frames are written by worker threads, so encoding them doesn't take time
+// from the frame that read them back.
+typedef enum jm_frame_format
+{
+	// RGBA8 PNG
+	JM_FRAME_FORMAT_PNG,
+	// the RGBA8 pixels as they are, rows top down
+	JM_FRAME_FORMAT_RAW,
+} jm_frame_format;
+
+// Frames waiting to be written at most, writing more blocks until one is done.
+#define JM_FRAME_WRITER_MAX_QUEUED_FRAMES 16
+
+// PNG for paths ending in .png, raw otherwise.
+jm_frame_format jm_frame_writer_get_format(
+	const char* path);
+
+// Queues RGBA8 pixels to be written to path, starting the workers if they
+// aren't running yet. Takes ownership of pixels, which must have been
+// allocated with malloc. isBottomUp is set for pixels read back from OpenGL.
+void jm_frame_writer_write(
+	const char* path,
+	jm_frame_format format,
+	uint32_t* pixels,
+	uint32_t width,
+	uint32_t height,
+	bool isBottomUp);
+
+// Waits until every queued frame has been written and stops the workers.
+void jm_frame_writer_shutdown();
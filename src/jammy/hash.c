@@ -2,6 +2,8 @@
 
 #include <jammy/assert.h>
 
+#include <string.h>
+
 uint64_t jm_fnv(
 	const char* str)
 {
@@ -13,4 +15,34 @@ uint64_t jm_fnv(
 		hash ^= *str++;
 	}
 	return hash;
+}
+
+static uint64_t jm_hash_word(
+	uint64_t hash,
+	uint64_t word)
+{
+	hash = ((hash << 5) | (hash >> 59)) ^ word;
+	return hash * 0x517cc1b727220a95ULL;
+}
+
+uint64_t jm_hash_bytes(
+	const void* data,
+	size_t size,
+	uint64_t hash)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	while (size >= sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, bytes, sizeof(word));
+		hash = jm_hash_word(hash, word);
+		bytes += sizeof(word);
+		size -= sizeof(word);
+	}
+
+	// the rest is one word with the size in its top byte, so trailing 
+	// zeros still change the hash
+	uint64_t word = (uint64_t)size << 56;
+	memcpy(&word, bytes, size);
+	return jm_hash_word(hash, word);
 }
\ No newline at end of file
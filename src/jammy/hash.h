@@ -1,6 +1,14 @@
 #pragma once
 
 #include <inttypes.h>
+#include <stddef.h>
 
 uint64_t jm_fnv(
-	const char* str);
\ No newline at end of file
+	const char* str);
+
+// Continues hash with size bytes of data. Not the fnv of the bytes, words 
+// are hashed at a time.
+uint64_t jm_hash_bytes(
+	const void* data,
+	size_t size,
+	uint64_t hash);
\ No newline at end of file
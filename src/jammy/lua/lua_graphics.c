@@ -1,15 +1,21 @@
 #include <jammy/command_buffer.h>
+#include <jammy/capture.h>
 #include <jammy/texture.h>
+#include <jammy/mesh.h>
+#include <jammy/shape.h>
 #include <jammy/font.h>
 #include <jammy/effect.h>
 #include <jammy/math.h>
 #include <jammy/remotery/Remotery.h>
 #include <jammy/color.h>
+#include <jammy/lua/lua_util.h>
 
 #include <lua.h>
 #include <lauxlib.h>
 
 #include <string.h>
+#include <stdlib.h>
+#include <math.h>
 
 typedef struct jm_lua_texture
 {
@@ -52,7 +58,309 @@ static int lua_Texture___gc(lua_State* L)
 	return 0;
 }
 
-static float g_cameraTransform[16];
+// Local-space box around what a draw covers, used to cull draws that are 
+// outside the view before they're sorted and uploaded.
+typedef struct jm_lua_bounds
+{
+	float minX, minY;
+	float maxX, maxY;
+} jm_lua_bounds;
+
+static void lua_resetBounds(jm_lua_bounds* bounds)
+{
+	bounds->minX = FLT_MAX;
+	bounds->minY = FLT_MAX;
+	bounds->maxX = -FLT_MAX;
+	bounds->maxY = -FLT_MAX;
+}
+
+static void lua_growBounds(jm_lua_bounds* bounds, float minX, float minY, float maxX, float maxY)
+{
+	bounds->minX = fminf(bounds->minX, minX);
+	bounds->minY = fminf(bounds->minY, minY);
+	bounds->maxX = fmaxf(bounds->maxX, maxX);
+	bounds->maxY = fmaxf(bounds->maxY, maxY);
+}
+
+static jm_lua_bounds lua_getVertexBounds(const jm_vertex* vertices, uint32_t count)
+{
+	jm_lua_bounds bounds;
+	lua_resetBounds(&bounds);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		lua_growBounds(&bounds, vertices[i].x, vertices[i].y, vertices[i].x, vertices[i].y);
+	}
+	return bounds;
+}
+
+typedef struct jm_lua_sprite_buffer
+{
+	jm_sprite* sprites;
+	uint32_t count;
+	uint32_t capacity;
+	bool hasSemitransparentColors;
+	jm_lua_bounds bounds;
+} jm_lua_sprite_buffer;
+
+static jm_lua_sprite_buffer* lua_checkSpriteBuffer(lua_State* L, int index)
+{
+	jm_lua_sprite_buffer* buffer = (jm_lua_sprite_buffer*)luaL_checkudata(L, index, "SpriteBuffer");
+	if (buffer == NULL) luaL_typerror(L, index, "SpriteBuffer");
+	return buffer;
+}
+
+static int lua_SpriteBuffer___gc(lua_State* L)
+{
+	jm_lua_sprite_buffer* buffer = lua_checkSpriteBuffer(L, 1);
+	free(buffer->sprites);
+	return 0;
+}
+
+// buffer:add(x, y, width, height, u0, v0, u1, v1, [r, g, b, a, rotation])
+static int lua_SpriteBuffer_add(lua_State* L)
+{
+	jm_lua_sprite_buffer* buffer = lua_checkSpriteBuffer(L, 1);
+
+	// every argument is read before the sprite is appended, so a bad one 
+	// leaves the buffer as it was
+	jm_sprite newSprite;
+	newSprite.x = (float)luaL_checknumber(L, 2);
+	newSprite.y = (float)luaL_checknumber(L, 3);
+	newSprite.width = (float)luaL_checknumber(L, 4);
+	newSprite.height = (float)luaL_checknumber(L, 5);
+	newSprite.u0 = jm_sprite_pack_texcoord((float)luaL_checknumber(L, 6));
+	newSprite.v0 = jm_sprite_pack_texcoord((float)luaL_checknumber(L, 7));
+	newSprite.u1 = jm_sprite_pack_texcoord((float)luaL_checknumber(L, 8));
+	newSprite.v1 = jm_sprite_pack_texcoord((float)luaL_checknumber(L, 9));
+
+	const float r = jm_clamp((float)luaL_optnumber(L, 10, 1), 0, 1);
+	const float g = jm_clamp((float)luaL_optnumber(L, 11, 1), 0, 1);
+	const float b = jm_clamp((float)luaL_optnumber(L, 12, 1), 0, 1);
+	const float a = jm_clamp((float)luaL_optnumber(L, 13, 1), 0, 1);
+	newSprite.color = jm_pack_color32_rgba_f32(r, g, b, a);
+	newSprite.rotation = (float)luaL_optnumber(L, 14, 0);
+
+	if (buffer->count == buffer->capacity)
+	{
+		const uint32_t capacity = (buffer->capacity > 0) ? buffer->capacity * 2 : 256;
+		jm_sprite* sprites = realloc(buffer->sprites, sizeof(jm_sprite) * capacity);
+		if (sprites == NULL)
+		{
+			return luaL_error(L, "out of memory");
+		}
+		buffer->sprites = sprites;
+		buffer->capacity = capacity;
+	}
+
+	jm_sprite* sprite = &buffer->sprites[buffer->count++];
+	*sprite = newSprite;
+
+	// sprites rotate around their center, so a rotated one stays within the 
+	// circle through its corners
+	const float centerX = sprite->x + 0.5f * sprite->width;
+	const float centerY = sprite->y + 0.5f * sprite->height;
+	float extentX = 0.5f * fabsf(sprite->width);
+	float extentY = 0.5f * fabsf(sprite->height);
+	if (sprite->rotation != 0.0f)
+	{
+		extentX = extentY = sqrtf(extentX * extentX + extentY * extentY);
+	}
+	lua_growBounds(&buffer->bounds, centerX - extentX, centerY - extentY, centerX + extentX, centerY + extentY);
+
+	const uint8_t alpha = (sprite->color >> 24);
+	if (alpha > 0x00 && alpha < 0xff)
+	{
+		buffer->hasSemitransparentColors = true;
+	}
+	return 0;
+}
+
+static int lua_SpriteBuffer_clear(lua_State* L)
+{
+	jm_lua_sprite_buffer* buffer = lua_checkSpriteBuffer(L, 1);
+	buffer->count = 0;
+	buffer->hasSemitransparentColors = false;
+	lua_resetBounds(&buffer->bounds);
+	return 0;
+}
+
+static int lua_SpriteBuffer_count(lua_State* L)
+{
+	jm_lua_sprite_buffer* buffer = lua_checkSpriteBuffer(L, 1);
+	lua_pushinteger(L, buffer->count);
+	return 1;
+}
+
+typedef struct jm_lua_mesh
+{
+	jm_mesh_handle handle;
+	jm_lua_bounds bounds;
+} jm_lua_mesh;
+
+static jm_lua_mesh* lua_checkMesh(lua_State* L, int index)
+{
+	jm_lua_mesh* mesh = (jm_lua_mesh*)luaL_checkudata(L, index, "Mesh");
+	if (mesh == NULL) luaL_typerror(L, index, "Mesh");
+	return mesh;
+}
+
+static int lua_Mesh___gc(lua_State* L)
+{
+	jm_lua_mesh* mesh = lua_checkMesh(L, 1);
+	jm_destroy_mesh(mesh->handle);
+	return 0;
+}
+
+#define JM_TRANSFORM_STACK_SIZE 32
+
+// A level of the transform stack. The matrix is the product of the local 
+// transforms pushed so far, the bottom level is the identity. Each level 
+// remembers its entry in the transform palette of the command buffer being 
+// recorded, so draws under the same transform share one entry.
+typedef struct jm_lua_transform
+{
+	float matrix[16];
+	const jm_command_buffer* paletteBuffer;
+	uint32_t paletteGeneration;
+	uint16_t paletteIndex;
+} jm_lua_transform;
+
+// The camera set by setCamera, which remembers its entry in the view palette 
+// like transform stack levels do. Until setCamera is called draws use the 
+// default view, whose clip space is the whole target.
+typedef struct jm_lua_view
+{
+	jm_view view;
+	bool isDefault;
+	const jm_command_buffer* paletteBuffer;
+	uint32_t paletteGeneration;
+	uint8_t paletteIndex;
+} jm_lua_view;
+
+static jm_lua_view g_view;
+static jm_lua_transform g_transformStack[JM_TRANSFORM_STACK_SIZE];
+static uint32_t g_transformStackTop = 0;
+
+// Returns the palette index of the current transform, adding it to the 
+// palette the first time it's used in this frame.
+static uint16_t lua_getTransformIndex(lua_State* L)
+{
+	if (g_transformStackTop == 0)
+	{
+		return JM_TRANSFORM_INDEX_IDENTITY;
+	}
+
+	jm_lua_transform* transform = &g_transformStack[g_transformStackTop];
+	if (transform->paletteBuffer != g_currentCommandBuffer || 
+		transform->paletteGeneration != g_currentCommandBuffer->generation)
+	{
+		const uint16_t paletteIndex = jm_command_buffer_push_transform(g_currentCommandBuffer, transform->matrix);
+		if (paletteIndex == JM_TRANSFORM_INDEX_INVALID)
+		{
+			luaL_error(L, "too many transforms in one frame, at most %d are supported", JM_TRANSFORM_PALETTE_SIZE - 1);
+		}
+		transform->paletteBuffer = g_currentCommandBuffer;
+		transform->paletteGeneration = g_currentCommandBuffer->generation;
+		transform->paletteIndex = paletteIndex;
+	}
+	return transform->paletteIndex;
+}
+
+// Returns the palette index of the camera, adding it to the palette the 
+// first time it's used in this frame.
+static uint8_t lua_getViewIndex(lua_State* L)
+{
+	if (g_view.isDefault)
+	{
+		return JM_VIEW_INDEX_DEFAULT;
+	}
+
+	if (g_view.paletteBuffer != g_currentCommandBuffer || 
+		g_view.paletteGeneration != g_currentCommandBuffer->generation)
+	{
+		const uint8_t paletteIndex = jm_command_buffer_push_view(g_currentCommandBuffer, &g_view.view);
+		if (paletteIndex == JM_VIEW_INDEX_INVALID)
+		{
+			luaL_error(L, "too many cameras in one frame, at most %d are supported", JM_VIEW_PALETTE_SIZE - 1);
+		}
+		g_view.paletteBuffer = g_currentCommandBuffer;
+		g_view.paletteGeneration = g_currentCommandBuffer->generation;
+		g_view.paletteIndex = paletteIndex;
+	}
+	return g_view.paletteIndex;
+}
+
+// Returns false if bounds are entirely outside clip space once transformed by 
+// the palette entries. Transforms are 2D affine, so the corners of the box are 
+// enough.
+static bool lua_isInView(const jm_lua_bounds* bounds, uint8_t viewIndex, uint16_t transformIndex)
+{
+	float m[16];
+	jm_multiply_transforms(m, g_currentCommandBuffer->views[viewIndex].transform, g_currentCommandBuffer->transforms[transformIndex]);
+	const float corners[4][2] = 
+	{
+		{ bounds->minX, bounds->minY },
+		{ bounds->maxX, bounds->minY },
+		{ bounds->minX, bounds->maxY },
+		{ bounds->maxX, bounds->maxY },
+	};
+
+	jm_lua_bounds clip;
+	lua_resetBounds(&clip);
+	for (int i = 0; i < 4; ++i)
+	{
+		const float x = m[0] * corners[i][0] + m[4] * corners[i][1] + m[12];
+		const float y = m[1] * corners[i][0] + m[5] * corners[i][1] + m[13];
+		lua_growBounds(&clip, x, y, x, y);
+	}
+	return clip.maxX >= -1.0f && clip.minX <= 1.0f && clip.maxY >= -1.0f && clip.minY <= 1.0f;
+}
+
+// Reads an array of red, green, blue and optional alpha in [0,1].
+static jm_color32 lua_toColor32(lua_State* L, int index)
+{
+	if (index < 0)
+	{
+		index = lua_gettop(L) + index + 1;
+	}
+
+	lua_rawgeti(L, index, 1);
+	const float r = jm_clamp(lua_tonumber(L, -1), 0, 1);
+	lua_pop(L, 1);
+	lua_rawgeti(L, index, 2);
+	const float g = jm_clamp(lua_tonumber(L, -1), 0, 1);
+	lua_pop(L, 1);
+	lua_rawgeti(L, index, 3);
+	const float b = jm_clamp(lua_tonumber(L, -1), 0, 1);
+	lua_pop(L, 1);
+	lua_rawgeti(L, index, 4);
+	const float a = lua_isnil(L, -1) ? 1.0f : jm_clamp(lua_tonumber(L, -1), 0, 1);
+	lua_pop(L, 1);
+
+	return jm_pack_color32_rgba_f32(r, g, b, a);
+}
+
+static uint32_t lua_getLayer(lua_State* L, int index)
+{
+	uint32_t layer = 0;
+	lua_pushliteral(L, "layer");
+	lua_gettable(L, index);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+		{
+			luaL_argerror(L, index, "the 'layer' parameter must be an integer");
+		}
+		const lua_Integer value = lua_tointeger(L, -1);
+		if (value < 0 || value >= JM_RENDER_LAYER_COUNT)
+		{
+			luaL_argerror(L, index, "the 'layer' parameter is out of range");
+		}
+		layer = (uint32_t)value;
+	}
+	lua_pop(L, 1);
+	return layer;
+}
 
 static int __drawText(lua_State* L)
 {
@@ -96,20 +404,7 @@ static int __drawText(lua_State* L)
 			luaL_argerror(L, 1, "the 'color' parameter must be an array containing the red, green, blue, and alpha value of the desired color");
 		}
 
-		lua_rawgeti(L, -1, 1);
-		const float r = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 2);
-		const float g = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 3);
-		const float b = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 4);
-		const float a = lua_isnil(L, -1) ? 1.0f : jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-
-		cmd->color = jm_pack_color32_rgba_f32(r, g, b, a);
+		cmd->color = lua_toColor32(L, -1);
 	}
 	lua_pop(L, 1);
 
@@ -191,9 +486,94 @@ static int __drawText(lua_State* L)
 	}
 	lua_pop(L, 1);
 
+	cmd->viewIndex = lua_getViewIndex(L);
+
+	// set sort key
+	const uint32_t sequence = (uint32_t)(g_currentCommandBuffer->commandIt - 1);
+	const uint32_t depth = jm_sort_key_depth(lua_getLayer(L, 1), sequence);
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, jm_render_command_draw_text_sort_key(cmd, depth));
+	cmd->depth = jm_sort_key_depth_to_clip_z(depth);
+
 	return 0;
 }
 
+// Reads the array of {x, y} pairs at the top of the stack.
+static void lua_toVertices(lua_State* L, jm_vertex* vertices, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		jm_vertex* vtx = vertices + i;
+
+		lua_rawgeti(L, -1, i + 1);
+		if (!lua_istable(L, -1))
+		{
+			luaL_argerror(L, 1, "every element of the 'vertices' array must be a table");
+		}
+		
+		lua_rawgeti(L, -1, 1);
+		vtx->x = lua_tonumber(L, -1);
+		lua_rawgeti(L, -2, 2);
+		vtx->y = lua_tonumber(L, -1);
+		lua_pop(L, 3);
+	}
+}
+
+// Reads the array of {u, v} pairs at the top of the stack.
+static void lua_toTexcoords(lua_State* L, jm_texcoord* texcoords, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		jm_texcoord* uv = texcoords + i;
+
+		lua_rawgeti(L, -1, i + 1);
+
+		lua_rawgeti(L, -1, 1);
+		uv->u = lua_tonumber(L, -1);
+		lua_rawgeti(L, -2, 2);
+		uv->v = lua_tonumber(L, -1);
+		lua_pop(L, 3);
+	}
+}
+
+// Reads the array of indices at the top of the stack.
+static void lua_toIndices(lua_State* L, void* indices, bool isIndex32, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		lua_rawgeti(L, -1, i + 1);
+		if (isIndex32)
+		{
+			((uint32_t*)indices)[i] = (uint32_t)lua_tointeger(L, -1);
+		}
+		else
+		{
+			((uint16_t*)indices)[i] = (uint16_t)lua_tointeger(L, -1);
+		}
+		lua_pop(L, 1);
+	}
+}
+
+// Splits a large non-indexed draw into parts that share its vertex data and 
+// sort key, so they stay together and each fits 16-bit indices.
+static void lua_splitDraw(jm_render_command_draw* cmd, uint64_t sortKey)
+{
+	uint32_t overlap;
+	const uint32_t splitSize = jm_render_command_draw_split_size(cmd->topology, &overlap);
+	const uint32_t vertexCount = cmd->vertexCount;
+
+	cmd->vertexCount = splitSize;
+	for (uint32_t start = splitSize - overlap; start + overlap < vertexCount; start += splitSize - overlap)
+	{
+		jm_render_command_draw* part = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_draw);
+		*part = *cmd;
+		part->vertices = cmd->vertices + start;
+		part->texcoords = (cmd->texcoords != NULL) ? cmd->texcoords + start : NULL;
+		part->colors = (cmd->colors != NULL) ? cmd->colors + start : NULL;
+		part->vertexCount = jm_min(vertexCount - start, splitSize);
+		jm_command_buffer_set_sort_key(g_currentCommandBuffer, sortKey);
+	}
+}
+
 static int __draw(lua_State* L)
 {
 	if (!lua_istable(L, 1))
@@ -222,23 +602,7 @@ static int __draw(lua_State* L)
 	cmd->vertexCount = (uint32_t)lua_objlen(L, -1);
 	cmd->vertices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->vertexCount * sizeof(jm_vertex));
 
-	jm_vertex* vertices = (jm_vertex*)cmd->vertices;
-	for (uint32_t i = 0; i < cmd->vertexCount; ++i)
-	{
-		jm_vertex* vtx = vertices + i;
-
-		lua_rawgeti(L, -1, i + 1);
-		if (!lua_istable(L, -1))
-		{
-			luaL_argerror(L, 1, "every element of the 'vertices' array must be a table");
-		}
-		
-		lua_rawgeti(L, -1, 1);
-		vtx->x = lua_tonumber(L, -1);
-		lua_rawgeti(L, -2, 2);
-		vtx->y = lua_tonumber(L, -1);
-		lua_pop(L, 3);
-	}
+	lua_toVertices(L, cmd->vertices, cmd->vertexCount);
 	lua_pop(L, 1);
 
 	// get texcoords
@@ -254,19 +618,7 @@ static int __draw(lua_State* L)
 		jm_assert(lua_objlen(L, -1) == cmd->vertexCount);
 		cmd->texcoords = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->vertexCount * sizeof(jm_texcoord));
 
-		jm_texcoord* texcoords = (jm_texcoord*)cmd->texcoords;
-		for (uint32_t i = 0; i < cmd->vertexCount; ++i)
-		{
-			jm_texcoord* uv = texcoords + i;
-
-			lua_rawgeti(L, -1, i + 1);
-
-			lua_rawgeti(L, -1, 1);
-			uv->u = lua_tonumber(L, -1);
-			lua_rawgeti(L, -2, 2);
-			uv->v = lua_tonumber(L, -1);
-			lua_pop(L, 3);
-		}
+		lua_toTexcoords(L, cmd->texcoords, cmd->vertexCount);
 	}
 	lua_pop(L, 1);
 
@@ -281,15 +633,10 @@ static int __draw(lua_State* L)
 		}
 
 		cmd->indexCount = (uint32_t)lua_objlen(L, -1);
-		cmd->indices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->indexCount * sizeof(uint16_t));
-
-		uint16_t* indices = (uint16_t*)cmd->indices;
-		for (uint32_t i = 0; i < cmd->indexCount; ++i)
-		{
-			lua_rawgeti(L, -1, i + 1);
-			indices[i] = (uint16_t)lua_tointeger(L, -1);
-			lua_pop(L, 1);
-		}
+		cmd->isIndex32 = jm_render_command_draw_needs_index32(cmd->vertexCount);
+		const size_t indexSize = cmd->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		cmd->indices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->indexCount * indexSize);
+		lua_toIndices(L, cmd->indices, cmd->isIndex32, cmd->indexCount);
 	}
 	lua_pop(L, 1);
 
@@ -306,6 +653,18 @@ static int __draw(lua_State* L)
 	}
 	lua_pop(L, 1);
 
+	// backends read indices as they are, so they are checked once the topology is known
+	if (cmd->indices != NULL)
+	{
+		const bool isStrip = cmd->topology == JM_PRIMITIVE_TOPOLOGY_LINESTRIP || cmd->topology == JM_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+		const uint32_t restartIndex = cmd->isIndex32 ? UINT32_MAX : UINT16_MAX;
+		for (uint32_t i = 0; i < cmd->indexCount; ++i)
+		{
+			const uint32_t index = cmd->isIndex32 ? ((uint32_t*)cmd->indices)[i] : ((uint16_t*)cmd->indices)[i];
+			luaL_argcheck(L, index < cmd->vertexCount || (isStrip && index == restartIndex), 1, "every element of the 'indices' array must refer to a vertex");
+		}
+	}
+
 	// override color
 	lua_pushliteral(L, "color");
 	lua_gettable(L, 1);
@@ -316,20 +675,43 @@ static int __draw(lua_State* L)
 			luaL_argerror(L, 1, "the 'color' parameter must be an array containing the red, green, blue, and alpha value of the desired color");
 		}
 
-		lua_rawgeti(L, -1, 1);
-		const float r = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 2);
-		const float g = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 3);
-		const float b = jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
-		lua_rawgeti(L, -1, 4);
-		const float a = lua_isnil(L, -1) ? 1.0f : jm_clamp(lua_tonumber(L, -1), 0, 1);
-		lua_pop(L, 1);
+		cmd->color = lua_toColor32(L, -1);
+	}
+	lua_pop(L, 1);
+
+	// get vertex colors
+	lua_pushliteral(L, "colors");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_istable(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'colors' parameter must be an array");
+		}
+		if (lua_objlen(L, -1) != cmd->vertexCount)
+		{
+			luaL_argerror(L, 1, "the 'colors' array must have one color per vertex");
+		}
 
-		cmd->color = jm_pack_color32_rgba_f32(r, g, b, a);
+		cmd->colors = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->vertexCount * sizeof(jm_color32));
+
+		for (uint32_t i = 0; i < cmd->vertexCount; ++i)
+		{
+			lua_rawgeti(L, -1, i + 1);
+			if (!lua_istable(L, -1))
+			{
+				luaL_argerror(L, 1, "every element of the 'colors' array must be a table");
+			}
+			const jm_color32 color = lua_toColor32(L, -1);
+			lua_pop(L, 1);
+
+			const uint8_t alpha = (color >> 24);
+			if (alpha > 0x00 && alpha < 0xff)
+			{
+				cmd->hasSemitransparentColors = 1;
+			}
+			cmd->colors[i] = color;
+		}
 	}
 	lua_pop(L, 1);
 
@@ -348,6 +730,12 @@ static int __draw(lua_State* L)
 	}
 	lua_pop(L, 1);
 
+	// texcoords are relative to the texture, which may be packed into an atlas page
+	if (jm_render_command_draw_is_textured(cmd))
+	{
+		jm_texture_remap_texcoords(cmd->textureHandle, cmd->texcoords, cmd->vertexCount);
+	}
+
 	// override sampler state
 	lua_pushliteral(L, "sampler");
 	lua_gettable(L, 1);
@@ -363,73 +751,850 @@ static int __draw(lua_State* L)
 	lua_pop(L, 1);
 
 	// set transform
-	memcpy(cmd->transform, g_cameraTransform, sizeof(cmd->transform));
+	cmd->transformIndex = lua_getTransformIndex(L);
+	cmd->viewIndex = lua_getViewIndex(L);
 
-	return 0;
-}
+	const uint32_t layer = lua_getLayer(L, 1);
 
-static int __loadTexture(lua_State* L)
-{
-	const char* path = luaL_checkstring(L, 1);
-	const jm_texture_handle textureHandle = jm_load_texture(path);
-	if (textureHandle == JM_TEXTURE_HANDLE_INVALID)
+	// draws outside the view are dropped before they're sorted and uploaded
+	const jm_lua_bounds bounds = lua_getVertexBounds(cmd->vertices, cmd->vertexCount);
+	if (!lua_isInView(&bounds, cmd->viewIndex, cmd->transformIndex))
 	{
-		lua_pushnil(L);
+		jm_command_buffer_cull(g_currentCommandBuffer);
+		return 0;
 	}
-	else
+
+	// set sort key and depth
+	const uint32_t sequence = (uint32_t)(g_currentCommandBuffer->commandIt - 1);
+	const uint32_t depth = jm_sort_key_depth(layer, sequence);
+	cmd->depth = jm_sort_key_depth_to_clip_z(depth);
+	const uint64_t sortKey = jm_render_command_draw_sort_key(cmd, depth);
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, sortKey);
+
+	if (cmd->indices == NULL && jm_render_command_draw_needs_index32(cmd->vertexCount))
 	{
-		jm_lua_texture* texture = lua_pushTexture(L);
-		texture->handle = textureHandle;
+		lua_splitDraw(cmd, sortKey);
 	}
 
-	return 1;
+	return 0;
 }
 
-static int __loadFont(lua_State* L)
+static int __newSpriteBuffer(lua_State* L)
 {
-	const char* path = luaL_checkstring(L, 1);
-	const uint32_t size = (uint32_t)luaL_checkinteger(L, 2);
-	const jm_font_handle font = jm_load_font(path, size);
-	lua_pushinteger(L, font);
+	jm_lua_sprite_buffer* buffer = (jm_lua_sprite_buffer*)lua_newuserdata(L, sizeof(jm_lua_sprite_buffer));
+	buffer->sprites = NULL;
+	buffer->count = 0;
+	buffer->capacity = 0;
+	buffer->hasSemitransparentColors = false;
+	lua_resetBounds(&buffer->bounds);
+	luaL_getmetatable(L, "SpriteBuffer");
+	lua_setmetatable(L, -2);
 	return 1;
 }
 
-static int __loadEffect(lua_State* L)
+static int __drawSprites(lua_State* L)
 {
-	const char* path = lua_tostring(L, 1);
-	const jm_effect effect = jm_load_effect(path);
-	lua_pushinteger(L, effect);
-	return 1;
-}
+	if (!lua_istable(L, 1))
+	{
+		luaL_argerror(L, 1, "");
+	}
 
-static int __instantiateEffect(lua_State* L)
-{
-	const char* path = luaL_checkstring(L, 1);
-	const jm_effect_instance instance = jm_instantiate_effect(path);
-	lua_pushinteger(L, instance);
-	return 1;
+	// get sprites
+	lua_pushliteral(L, "sprites");
+	lua_gettable(L, 1);
+	if (!lua_isuserdata(L, -1))
+	{
+		luaL_argerror(L, 1, "the 'sprites' parameter must be a sprite buffer");
+	}
+	const jm_lua_sprite_buffer* buffer = lua_checkSpriteBuffer(L, -1);
+	lua_pop(L, 1);
+
+	if (buffer->count == 0)
+	{
+		return 0;
+	}
+
+	jm_render_command_draw_sprites* cmd = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_draw_sprites);
+	jm_render_command_draw_sprites_init(cmd);
+
+	// get texture
+	lua_pushliteral(L, "texture");
+	lua_gettable(L, 1);
+	if (lua_isnil(L, -1) || !lua_isTexture(L, -1))
+	{
+		luaL_argerror(L, 1, "the 'texture' parameter must be a texture");
+	}
+	cmd->textureHandle = lua_checkTexture(L, -1)->handle;
+	lua_pop(L, 1);
+
+	// override sampler state
+	lua_pushliteral(L, "sampler");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'sampler' parameter must be an integer");
+		}
+
+		cmd->samplerState = (uint8_t)lua_tointeger(L, -1);
+	}
+	lua_pop(L, 1);
+
+	// set transform
+	cmd->transformIndex = lua_getTransformIndex(L);
+	cmd->viewIndex = lua_getViewIndex(L);
+
+	const uint32_t layer = lua_getLayer(L, 1);
+	if (!lua_isInView(&buffer->bounds, cmd->viewIndex, cmd->transformIndex))
+	{
+		jm_command_buffer_cull(g_currentCommandBuffer);
+		return 0;
+	}
+
+	// the buffer may change before the frame is rendered, so copy the records
+	jm_sprite* sprites = jm_command_buffer_alloc(g_currentCommandBuffer, sizeof(jm_sprite) * buffer->count);
+	memcpy(sprites, buffer->sprites, sizeof(jm_sprite) * buffer->count);
+	const jm_texture_info* textureInfo = jm_texture_get_info(cmd->textureHandle);
+	if (textureInfo->isRemapped)
+	{
+		const float scaleU = textureInfo->u1 - textureInfo->u0;
+		const float scaleV = textureInfo->v1 - textureInfo->v0;
+		for (uint32_t i = 0; i < buffer->count; ++i)
+		{
+			jm_sprite* sprite = sprites + i;
+			sprite->u0 = jm_sprite_pack_texcoord(textureInfo->u0 + sprite->u0 / (float)UINT16_MAX * scaleU);
+			sprite->v0 = jm_sprite_pack_texcoord(textureInfo->v0 + sprite->v0 / (float)UINT16_MAX * scaleV);
+			sprite->u1 = jm_sprite_pack_texcoord(textureInfo->u0 + sprite->u1 / (float)UINT16_MAX * scaleU);
+			sprite->v1 = jm_sprite_pack_texcoord(textureInfo->v0 + sprite->v1 / (float)UINT16_MAX * scaleV);
+		}
+	}
+	cmd->sprites = sprites;
+	cmd->spriteCount = buffer->count;
+	cmd->hasSemitransparentColors = buffer->hasSemitransparentColors;
+
+	// set sort key and depth
+	const uint32_t sequence = (uint32_t)(g_currentCommandBuffer->commandIt - 1);
+	const uint32_t depth = jm_sort_key_depth(layer, sequence);
+	cmd->depth = jm_sort_key_depth_to_clip_z(depth);
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, jm_render_command_draw_sprites_sort_key(cmd, depth));
+
+	return 0;
+}
+
+// createMesh{vertices, [texcoords], [indices], [topology], [texture]}
+static int __createMesh(lua_State* L)
+{
+	if (!lua_istable(L, 1))
+	{
+		luaL_argerror(L, 1, "");
+	}
+
+	jm_mesh_desc desc;
+	desc.texcoords = NULL;
+	desc.indices = NULL;
+	desc.indexCount = 0;
+	desc.textureHandle = JM_TEXTURE_HANDLE_INVALID;
+	desc.topology = JM_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	// the arrays are read into scratch userdata, so errors don't leak them
+	lua_pushliteral(L, "vertices");
+	lua_gettable(L, 1);
+	if (!lua_istable(L, -1) || lua_objlen(L, -1) == 0)
+	{
+		luaL_argerror(L, 1, "the 'vertices' parameter must be a non-empty array");
+	}
+	desc.vertexCount = (uint32_t)lua_objlen(L, -1);
+	desc.isIndex32 = jm_render_command_draw_needs_index32(desc.vertexCount);
+	jm_vertex* vertices = lua_newuserdata(L, sizeof(jm_vertex) * desc.vertexCount);
+	lua_insert(L, -2);
+	lua_toVertices(L, vertices, desc.vertexCount);
+	lua_pop(L, 1);
+	desc.vertices = vertices;
+
+	lua_pushliteral(L, "texcoords");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_istable(L, -1) || lua_objlen(L, -1) != desc.vertexCount)
+		{
+			luaL_argerror(L, 1, "the 'texcoords' parameter must be an array with one texcoord per vertex");
+		}
+		jm_texcoord* texcoords = lua_newuserdata(L, sizeof(jm_texcoord) * desc.vertexCount);
+		lua_insert(L, -2);
+		lua_toTexcoords(L, texcoords, desc.vertexCount);
+		desc.texcoords = texcoords;
+	}
+	lua_pop(L, 1);
+
+	lua_pushliteral(L, "topology");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'topology' parameter must be an integer");
+		}
+		desc.topology = (uint8_t)lua_tointeger(L, -1);
+	}
+	lua_pop(L, 1);
+
+	lua_pushliteral(L, "indices");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_istable(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'indices' parameter must be an array");
+		}
+		desc.indexCount = (uint32_t)lua_objlen(L, -1);
+		const size_t indexSize = desc.isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		void* indices = lua_newuserdata(L, indexSize * desc.indexCount);
+		lua_insert(L, -2);
+		lua_toIndices(L, indices, desc.isIndex32, desc.indexCount);
+		desc.indices = indices;
+
+		// draws read the buffers as they are, so indices are checked once here
+		const bool isStrip = desc.topology == JM_PRIMITIVE_TOPOLOGY_LINESTRIP || desc.topology == JM_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+		const uint32_t restartIndex = desc.isIndex32 ? UINT32_MAX : UINT16_MAX;
+		for (uint32_t i = 0; i < desc.indexCount; ++i)
+		{
+			const uint32_t index = desc.isIndex32 ? ((uint32_t*)indices)[i] : ((uint16_t*)indices)[i];
+			if (index >= desc.vertexCount && !(isStrip && index == restartIndex))
+			{
+				luaL_argerror(L, 1, "every element of the 'indices' array must refer to a vertex");
+			}
+		}
+	}
+	lua_pop(L, 1);
+
+	lua_pushliteral(L, "texture");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		desc.textureHandle = lua_checkTexture(L, -1)->handle;
+	}
+	lua_pop(L, 1);
+
+	const jm_mesh_handle meshHandle = jm_create_mesh(&desc);
+	if (meshHandle == JM_MESH_HANDLE_INVALID)
+	{
+		lua_pushnil(L);
+	}
+	else
+	{
+		jm_lua_mesh* mesh = (jm_lua_mesh*)lua_newuserdata(L, sizeof(jm_lua_mesh));
+		mesh->handle = meshHandle;
+		mesh->bounds = lua_getVertexBounds(desc.vertices, desc.vertexCount);
+		luaL_getmetatable(L, "Mesh");
+		lua_setmetatable(L, -2);
+	}
+
+	return 1;
+}
+
+// drawMesh{mesh, [color], [sampler], [layer]}
+static int __drawMesh(lua_State* L)
+{
+	if (!lua_istable(L, 1))
+	{
+		luaL_argerror(L, 1, "");
+	}
+
+	// get mesh
+	lua_pushliteral(L, "mesh");
+	lua_gettable(L, 1);
+	if (!lua_isuserdata(L, -1))
+	{
+		luaL_argerror(L, 1, "the 'mesh' parameter must be a mesh");
+	}
+	const jm_lua_mesh* mesh = lua_checkMesh(L, -1);
+	lua_pop(L, 1);
+
+	jm_render_command_draw_mesh* cmd = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_draw_mesh);
+	jm_render_command_draw_mesh_init(cmd);
+	cmd->meshHandle = mesh->handle;
+
+	// override color
+	lua_pushliteral(L, "color");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_istable(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'color' parameter must be an array containing the red, green, blue, and alpha value of the desired color");
+		}
+
+		cmd->color = lua_toColor32(L, -1);
+	}
+	lua_pop(L, 1);
+
+	// override sampler state
+	lua_pushliteral(L, "sampler");
+	lua_gettable(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+		{
+			luaL_argerror(L, 1, "the 'sampler' parameter must be an integer");
+		}
+
+		cmd->samplerState = (uint8_t)lua_tointeger(L, -1);
+	}
+	lua_pop(L, 1);
+
+	// set transform
+	cmd->transformIndex = lua_getTransformIndex(L);
+	cmd->viewIndex = lua_getViewIndex(L);
+
+	const uint32_t layer = lua_getLayer(L, 1);
+	if (!lua_isInView(&mesh->bounds, cmd->viewIndex, cmd->transformIndex))
+	{
+		jm_command_buffer_cull(g_currentCommandBuffer);
+		return 0;
+	}
+
+	// set sort key and depth
+	const uint32_t sequence = (uint32_t)(g_currentCommandBuffer->commandIt - 1);
+	const uint32_t depth = jm_sort_key_depth(layer, sequence);
+	cmd->depth = jm_sort_key_depth_to_clip_z(depth);
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, jm_render_command_draw_mesh_sort_key(cmd, depth));
+
+	return 0;
+}
+
+// Color and layer of the shapes drawn by rect, circle and the others, which 
+// take scalar arguments only.
+typedef struct jm_lua_shape_style
+{
+	jm_color32 color;
+	uint32_t layer;
+} jm_lua_shape_style;
+
+static jm_lua_shape_style g_shapeStyle;
+
+// Scratch space the outline of a shape is built in before it's stroked or 
+// filled, grown for long polylines.
+static jm_vertex* g_shapePath = NULL;
+static uint32_t g_shapePathCapacity = 0;
+
+static jm_vertex* lua_reserveShapePath(lua_State* L, uint32_t pointCount)
+{
+	if (pointCount > g_shapePathCapacity)
+	{
+		const uint32_t capacity = jm_max(pointCount, JM_SHAPE_MAX_PATH_POINTS);
+		// the old path stays valid if it can't grow
+		jm_vertex* path = realloc(g_shapePath, sizeof(jm_vertex) * capacity);
+		if (path == NULL)
+		{
+			luaL_error(L, "out of memory");
+		}
+		g_shapePath = path;
+		g_shapePathCapacity = capacity;
+	}
+	return g_shapePath;
+}
+
+// setShapeColor(r, g, b, [a])
+static int __setShapeColor(lua_State* L)
+{
+	const float r = jm_clamp((float)luaL_checknumber(L, 1), 0, 1);
+	const float g = jm_clamp((float)luaL_checknumber(L, 2), 0, 1);
+	const float b = jm_clamp((float)luaL_checknumber(L, 3), 0, 1);
+	const float a = jm_clamp((float)luaL_optnumber(L, 4, 1), 0, 1);
+	g_shapeStyle.color = jm_pack_color32_rgba_f32(r, g, b, a);
+	return 0;
+}
+
+// setShapeLayer(layer)
+static int __setShapeLayer(lua_State* L)
+{
+	const lua_Integer layer = luaL_checkinteger(L, 1);
+	if (layer < 0 || layer >= JM_RENDER_LAYER_COUNT)
+	{
+		luaL_argerror(L, 1, "the layer is out of range");
+	}
+	g_shapeStyle.layer = (uint32_t)layer;
+	return 0;
+}
+
+// Shape geometry is sized from these numbers, so NaN and infinity are 
+// rejected before any of it is generated.
+static float lua_checkShapeNumber(lua_State* L, int index)
+{
+	const float value = (float)luaL_checknumber(L, index);
+	if (!isfinite(value))
+	{
+		luaL_argerror(L, index, "the number must be finite");
+	}
+	return value;
+}
+
+static float lua_optShapeNumber(lua_State* L, int index, float defaultValue)
+{
+	return lua_isnoneornil(L, index) ? defaultValue : lua_checkShapeNumber(L, index);
+}
+
+// Fills the convex path if lineWidth is 0 and outlines it otherwise. The 
+// geometry is generated straight into command buffer memory, and not at all 
+// if the shape is outside the view.
+static void lua_drawShapePath(lua_State* L, const jm_vertex* path, uint32_t pointCount, bool isClosed, float lineWidth)
+{
+	const bool isFilled = (lineWidth <= 0.0f);
+
+	jm_render_command_draw* cmd = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_draw);
+	jm_render_command_draw_init(cmd);
+	cmd->color = g_shapeStyle.color;
+	cmd->transformIndex = lua_getTransformIndex(L);
+	cmd->viewIndex = lua_getViewIndex(L);
+
+	jm_lua_bounds bounds = lua_getVertexBounds(path, pointCount);
+	if (!isFilled)
+	{
+		const float extent = JM_SHAPE_MITER_LIMIT * 0.5f * lineWidth;
+		lua_growBounds(&bounds, bounds.minX - extent, bounds.minY - extent, bounds.maxX + extent, bounds.maxY + extent);
+	}
+	if (!lua_isInView(&bounds, cmd->viewIndex, cmd->transformIndex))
+	{
+		jm_command_buffer_cull(g_currentCommandBuffer);
+		return;
+	}
+
+	if (isFilled)
+	{
+		cmd->vertexCount = pointCount;
+		cmd->indexCount = (pointCount - 2) * 3;
+		cmd->vertices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->vertexCount * sizeof(jm_vertex));
+		cmd->indices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->indexCount * sizeof(uint16_t));
+		memcpy(cmd->vertices, path, cmd->vertexCount * sizeof(jm_vertex));
+		jm_shape_fill_convex(pointCount, cmd->indices);
+	}
+	else
+	{
+		const uint32_t segmentCount = isClosed ? pointCount : pointCount - 1;
+		cmd->vertexCount = pointCount * 2;
+		cmd->indexCount = segmentCount * 6;
+		cmd->vertices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->vertexCount * sizeof(jm_vertex));
+		cmd->indices = jm_command_buffer_alloc(g_currentCommandBuffer, cmd->indexCount * sizeof(uint16_t));
+		jm_shape_stroke(path, pointCount, isClosed, lineWidth, cmd->vertices, cmd->indices);
+	}
+
+	// set sort key and depth
+	const uint32_t sequence = (uint32_t)(g_currentCommandBuffer->commandIt - 1);
+	const uint32_t depth = jm_sort_key_depth(g_shapeStyle.layer, sequence);
+	cmd->depth = jm_sort_key_depth_to_clip_z(depth);
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, jm_render_command_draw_sort_key(cmd, depth));
+}
+
+// rect(x, y, width, height, [lineWidth])
+static int __rect(lua_State* L)
+{
+	const float x = lua_checkShapeNumber(L, 1);
+	const float y = lua_checkShapeNumber(L, 2);
+	const float width = lua_checkShapeNumber(L, 3);
+	const float height = lua_checkShapeNumber(L, 4);
+	const float lineWidth = lua_optShapeNumber(L, 5, 0.0f);
+
+	jm_vertex* path = lua_reserveShapePath(L, 4);
+	const uint32_t pointCount = jm_shape_get_rect_path(x, y, width, height, path);
+	lua_drawShapePath(L, path, pointCount, true, lineWidth);
+	return 0;
+}
+
+// roundedRect(x, y, width, height, radius, [lineWidth])
+static int __roundedRect(lua_State* L)
+{
+	const float x = lua_checkShapeNumber(L, 1);
+	const float y = lua_checkShapeNumber(L, 2);
+	const float width = lua_checkShapeNumber(L, 3);
+	const float height = lua_checkShapeNumber(L, 4);
+	const float radius = lua_checkShapeNumber(L, 5);
+	const float lineWidth = lua_optShapeNumber(L, 6, 0.0f);
+
+	const uint32_t cornerSegmentCount = jm_max(jm_shape_get_circle_segments(radius) / 4, 1);
+	jm_vertex* path = lua_reserveShapePath(L, 4 * (cornerSegmentCount + 1));
+	const uint32_t pointCount = jm_shape_get_rounded_rect_path(x, y, width, height, radius, cornerSegmentCount, path);
+	lua_drawShapePath(L, path, pointCount, true, lineWidth);
+	return 0;
+}
+
+// circle(x, y, radius, [lineWidth])
+static int __circle(lua_State* L)
+{
+	const float x = lua_checkShapeNumber(L, 1);
+	const float y = lua_checkShapeNumber(L, 2);
+	const float radius = lua_checkShapeNumber(L, 3);
+	const float lineWidth = lua_optShapeNumber(L, 4, 0.0f);
+
+	const uint32_t segmentCount = jm_shape_get_circle_segments(radius);
+	jm_vertex* path = lua_reserveShapePath(L, segmentCount);
+	const uint32_t pointCount = jm_shape_get_circle_path(x, y, radius, segmentCount, path);
+	lua_drawShapePath(L, path, pointCount, true, lineWidth);
+	return 0;
+}
+
+// line(x1, y1, x2, y2, [lineWidth])
+static int __line(lua_State* L)
+{
+	jm_vertex* path = lua_reserveShapePath(L, 2);
+	path[0].x = lua_checkShapeNumber(L, 1);
+	path[0].y = lua_checkShapeNumber(L, 2);
+	path[1].x = lua_checkShapeNumber(L, 3);
+	path[1].y = lua_checkShapeNumber(L, 4);
+	const float lineWidth = lua_optShapeNumber(L, 5, 1.0f);
+	if (lineWidth <= 0.0f)
+	{
+		luaL_argerror(L, 5, "the line width must be positive");
+	}
+
+	lua_drawShapePath(L, path, 2, false, lineWidth);
+	return 0;
+}
+
+// polyline(points, [lineWidth]), with points a flat array of x and y 
+// coordinates that can be reused between frames
+static int __polyline(lua_State* L)
+{
+	luaL_checktype(L, 1, LUA_TTABLE);
+	const float lineWidth = lua_optShapeNumber(L, 2, 1.0f);
+	if (lineWidth <= 0.0f)
+	{
+		luaL_argerror(L, 2, "the line width must be positive");
+	}
+
+	const uint32_t coordinateCount = (uint32_t)lua_objlen(L, 1);
+	if (coordinateCount < 4 || coordinateCount % 2 != 0)
+	{
+		luaL_argerror(L, 1, "the points must be an array of x and y coordinates of at least 2 points");
+	}
+	// the outline has two vertices per point and 16-bit indices
+	const uint32_t pointCount = coordinateCount / 2;
+	if (pointCount * 2 > JM_DRAW_MAX_VERTICES_INDEX16)
+	{
+		luaL_argerror(L, 1, "too many points");
+	}
+
+	jm_vertex* path = lua_reserveShapePath(L, pointCount);
+	for (uint32_t i = 0; i < pointCount; ++i)
+	{
+		lua_rawgeti(L, 1, i * 2 + 1);
+		lua_rawgeti(L, 1, i * 2 + 2);
+		path[i].x = (float)lua_tonumber(L, -2);
+		path[i].y = (float)lua_tonumber(L, -1);
+		lua_pop(L, 2);
+		if (!isfinite(path[i].x) || !isfinite(path[i].y))
+		{
+			luaL_argerror(L, 1, "every coordinate must be a finite number");
+		}
+	}
+
+	lua_drawShapePath(L, path, pointCount, false, lineWidth);
+	return 0;
+}
+
+static int __loadTexture(lua_State* L)
+{
+	const char* path = luaL_checkstring(L, 1);
+	const jm_texture_handle textureHandle = jm_load_texture(path);
+	if (textureHandle == JM_TEXTURE_HANDLE_INVALID)
+	{
+		lua_pushnil(L);
+	}
+	else
+	{
+		jm_lua_texture* texture = lua_pushTexture(L);
+		texture->handle = textureHandle;
+	}
+
+	return 1;
+}
+
+static int __createRenderTarget(lua_State* L)
+{
+	const lua_Integer width = luaL_checkinteger(L, 1);
+	const lua_Integer height = luaL_checkinteger(L, 2);
+	if (width <= 0 || height <= 0)
+	{
+		return luaL_error(L, "render targets must be at least 1x1 pixels");
+	}
+
+	const jm_texture_handle textureHandle = jm_create_render_target((uint32_t)width, (uint32_t)height);
+	if (textureHandle == JM_TEXTURE_HANDLE_INVALID)
+	{
+		lua_pushnil(L);
+	}
+	else
+	{
+		jm_lua_texture* texture = lua_pushTexture(L);
+		texture->handle = textureHandle;
+	}
+
+	return 1;
+}
+
+// The render target commands are recorded into, between beginRenderTarget and 
+// endRenderTarget.
+static jm_texture_handle g_renderTarget = JM_TEXTURE_HANDLE_INVALID;
+
+// beginRenderTarget(target, [clearColor])
+static int __beginRenderTarget(lua_State* L)
+{
+	const jm_texture_handle textureHandle = lua_checkTexture(L, 1)->handle;
+	if (!jm_texture_is_render_target(textureHandle))
+	{
+		luaL_argerror(L, 1, "the texture must be a render target");
+	}
+	if (g_currentCommandBuffer->pass != JM_RENDER_PASS_FRAMEBUFFER)
+	{
+		return luaL_error(L, "beginRenderTarget called before the previous render target was ended");
+	}
+
+	jm_color32 clearColor = 0;
+	if (!lua_isnoneornil(L, 2))
+	{
+		luaL_checktype(L, 2, LUA_TTABLE);
+		clearColor = lua_toColor32(L, 2);
+	}
+
+	if (!jm_command_buffer_begin_pass(g_currentCommandBuffer))
+	{
+		return luaL_error(L, "too many render targets in one frame, at most %d are supported", JM_RENDER_PASS_FRAMEBUFFER);
+	}
+
+	jm_render_command_begin_render_target* cmd = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_begin_render_target);
+	cmd->textureHandle = textureHandle;
+	cmd->clearColor = clearColor;
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, JM_SORT_KEY_PASS_BEGIN);
+
+	// draws only write alpha where they are opaque, so the target has 
+	// semitransparent pixels if it's cleared to a semitransparent color
+	const uint8_t alpha = (clearColor >> 24);
+	jm_texture_set_semitransparent(textureHandle, alpha > 0x00 && alpha < 0xff);
+
+	g_renderTarget = textureHandle;
+	return 0;
+}
+
+static int __endRenderTarget(lua_State* L)
+{
+	if (g_currentCommandBuffer->pass == JM_RENDER_PASS_FRAMEBUFFER)
+	{
+		return luaL_error(L, "endRenderTarget called without a matching beginRenderTarget");
+	}
+
+	jm_render_command_end_render_target* cmd = JM_COMMAND_BUFFER_PUSH(g_currentCommandBuffer, jm_render_command_end_render_target);
+	cmd->textureHandle = g_renderTarget;
+	jm_command_buffer_set_sort_key(g_currentCommandBuffer, JM_SORT_KEY_PASS_END);
+	jm_command_buffer_end_pass(g_currentCommandBuffer);
+
+	g_renderTarget = JM_TEXTURE_HANDLE_INVALID;
+	return 0;
+}
+
+static int __loadFont(lua_State* L)
+{
+	const char* path = luaL_checkstring(L, 1);
+	const uint32_t size = (uint32_t)luaL_checkinteger(L, 2);
+	const jm_font_handle font = jm_load_font(path, size);
+	lua_pushinteger(L, font);
+	return 1;
+}
+
+static int __loadEffect(lua_State* L)
+{
+	const char* path = lua_tostring(L, 1);
+	const jm_effect effect = jm_load_effect(path);
+	lua_pushinteger(L, effect);
+	return 1;
+}
+
+static int __instantiateEffect(lua_State* L)
+{
+	const char* path = luaL_checkstring(L, 1);
+	const jm_effect_instance instance = jm_instantiate_effect(path);
+	lua_pushinteger(L, instance);
+	return 1;
+}
+
+// Reads an optional number parameter of the table at index.
+static float lua_getNumberParameter(lua_State* L, int index, const char* name, float defaultValue)
+{
+	float value = defaultValue;
+	lua_pushstring(L, name);
+	lua_gettable(L, index);
+	if (!lua_isnil(L, -1))
+	{
+		if (!lua_isnumber(L, -1))
+		{
+			luaL_argerror(L, index, lua_pushfstring(L, "the '%s' parameter must be a number", name));
+		}
+		value = (float)lua_tonumber(L, -1);
+	}
+	lua_pop(L, 1);
+	return value;
 }
 
 static int __setCamera(lua_State* L)
 {
-	const float width = (float)luaL_checkinteger(L, 1);
-	const float height = (float)luaL_checkinteger(L, 2);
+	jm_view view;
+	memset(&view, 0, sizeof(view));
+	view.viewport[2] = 1.0f;
+	view.viewport[3] = 1.0f;
+
+	float width, height, x, y, zoom = 1.0f, rotation = 0.0f;
+	if (lua_istable(L, 1))
+	{
+		width = lua_getNumberParameter(L, 1, "width", 0.0f);
+		height = lua_getNumberParameter(L, 1, "height", 0.0f);
+		if (width <= 0.0f || height <= 0.0f)
+		{
+			luaL_argerror(L, 1, "the 'width' and 'height' parameters must be positive numbers");
+		}
+		x = lua_getNumberParameter(L, 1, "x", width / 2.0f);
+		y = lua_getNumberParameter(L, 1, "y", height / 2.0f);
+		zoom = lua_getNumberParameter(L, 1, "zoom", 1.0f);
+		rotation = lua_getNumberParameter(L, 1, "rotation", 0.0f);
+
+		// the part of the target drawn to, in fractions from the top left
+		lua_pushliteral(L, "viewport");
+		lua_gettable(L, 1);
+		if (!lua_isnil(L, -1))
+		{
+			if (!lua_istable(L, -1))
+			{
+				luaL_argerror(L, 1, "the 'viewport' parameter must be an array containing the x, y, width and height of the viewport in fractions of the screen");
+			}
+			for (int i = 0; i < 4; ++i)
+			{
+				lua_rawgeti(L, -1, i + 1);
+				view.viewport[i] = (float)lua_tonumber(L, -1);
+				lua_pop(L, 1);
+			}
+		}
+		lua_pop(L, 1);
+	}
+	else
+	{
+		width = (float)luaL_checkinteger(L, 1);
+		height = (float)luaL_checkinteger(L, 2);
+		x = width / 2.0f;
+		y = height / 2.0f;
+	}
+
+	// width by height world units around x, y fill the viewport, y pointing 
+	// down, rotated and zoomed around x, y
+	const float scaleX = zoom / (width / 2.0f);
+	const float scaleY = -zoom / (height / 2.0f);
+	const float s = sinf(rotation);
+	const float c = cosf(rotation);
+	float* m = view.transform;
+	m[0] = scaleX * c;
+	m[4] = scaleX * s;
+	m[1] = -scaleY * s;
+	m[5] = scaleY * c;
+	m[10] = 1.0f;
+	m[12] = -(m[0] * x + m[4] * y);
+	m[13] = -(m[1] * x + m[5] * y);
+	m[15] = 1.0f;
+
+	// setting the same camera again keeps its palette entry
+	if (g_view.isDefault || memcmp(&g_view.view, &view, sizeof(view)) != 0)
+	{
+		g_view.view = view;
+		g_view.isDefault = false;
+		g_view.paletteBuffer = NULL;
+	}
+	return 0;
+}
+
+static int __pushTransform(lua_State* L)
+{
+	const float x = (float)luaL_checknumber(L, 1);
+	const float y = (float)luaL_checknumber(L, 2);
+	const float rotation = (float)luaL_optnumber(L, 3, 0);
+	const float scaleX = (float)luaL_optnumber(L, 4, 1);
+	const float scaleY = (float)luaL_optnumber(L, 5, scaleX);
 
-	const float halfWidth = width / 2.0f;
-	const float halfHeight = height / 2.0f;
+	if (g_transformStackTop + 1 == JM_TRANSFORM_STACK_SIZE)
+	{
+		return luaL_error(L, "transform stack overflow, at most %d transforms can be pushed", JM_TRANSFORM_STACK_SIZE - 1);
+	}
 
-	g_cameraTransform[0] = 1.0f / halfWidth;
-	g_cameraTransform[5] = -1.0f / halfHeight;
-	g_cameraTransform[10] = 1.0f;
-	g_cameraTransform[12] = -1.0f;
-	g_cameraTransform[13] = 1.0f;
-	g_cameraTransform[15] = 1.0f;
+	// scale, then rotate, then translate
+	const float s = sinf(rotation);
+	const float c = cosf(rotation);
+	float local[16];
+	memset(local, 0, sizeof(local));
+	local[0] = c * scaleX;
+	local[1] = s * scaleX;
+	local[4] = -s * scaleY;
+	local[5] = c * scaleY;
+	local[10] = 1.0f;
+	local[12] = x;
+	local[13] = y;
+	local[15] = 1.0f;
+
+	jm_lua_transform* parent = &g_transformStack[g_transformStackTop];
+	jm_lua_transform* transform = &g_transformStack[++g_transformStackTop];
+	jm_multiply_transforms(transform->matrix, parent->matrix, local);
+	transform->paletteBuffer = NULL;
+	return 0;
+}
+
+static int __popTransform(lua_State* L)
+{
+	if (g_transformStackTop == 0)
+	{
+		return luaL_error(L, "popTransform called without a matching pushTransform");
+	}
+	--g_transformStackTop;
+	return 0;
+}
+
+static int __getCommandBufferStats(lua_State* L)
+{
+	jm_command_buffer_stats stats;
+	jm_command_buffer_get_stats(g_currentCommandBuffer, &stats);
+
+	lua_newtable(L);
+	jm_lua_table_setnumber(L, -1, "commandCount", (lua_Number)stats.commandCount);
+	jm_lua_table_setnumber(L, -1, "usedSize", (lua_Number)stats.usedSize);
+	jm_lua_table_setnumber(L, -1, "reservedSize", (lua_Number)stats.reservedSize);
+	jm_lua_table_setnumber(L, -1, "chunkCount", (lua_Number)stats.chunkCount);
+	jm_lua_table_setnumber(L, -1, "highWaterMark", (lua_Number)stats.highWaterMark);
+	jm_lua_table_setnumber(L, -1, "culledCount", (lua_Number)stats.culledCount);
 	return 1;
 }
 
+static int __captureFrame(lua_State* L)
+{
+	jm_capture_request(luaL_checkstring(L, 1));
+	return 0;
+}
+
+static int __capture(lua_State* L)
+{
+	jm_command_buffer_set_capture_path(g_currentCommandBuffer, luaL_checkstring(L, 1));
+	return 0;
+}
+
 void jm_luaopen_graphics(
 	lua_State* L)
 {
+	// the bottom of the transform stack is the identity
+	memset(&g_transformStack[0], 0, sizeof(g_transformStack[0]));
+	g_transformStack[0].matrix[0] = 1.0f;
+	g_transformStack[0].matrix[5] = 1.0f;
+	g_transformStack[0].matrix[10] = 1.0f;
+	g_transformStack[0].matrix[15] = 1.0f;
+	g_transformStackTop = 0;
+
+	memset(&g_view, 0, sizeof(g_view));
+	g_view.isDefault = true;
+
+	g_shapeStyle.color = 0xffffffff;
+	g_shapeStyle.layer = 0;
+
 	lua_getglobal(L, "jam");
 
 	lua_newtable(L);
@@ -442,6 +1607,18 @@ void jm_luaopen_graphics(
 	lua_pushcfunction(L, __loadFont);
 	lua_settable(L, -3);
 
+	lua_pushliteral(L, "createRenderTarget");
+	lua_pushcfunction(L, __createRenderTarget);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "beginRenderTarget");
+	lua_pushcfunction(L, __beginRenderTarget);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "endRenderTarget");
+	lua_pushcfunction(L, __endRenderTarget);
+	lua_settable(L, -3);
+
 	lua_pushliteral(L, "loadEffect");
 	lua_pushcfunction(L, __loadEffect);
 	lua_settable(L, -3);
@@ -458,10 +1635,74 @@ void jm_luaopen_graphics(
 	lua_pushcfunction(L, __draw);
 	lua_settable(L, -3);
 
+	lua_pushliteral(L, "newSpriteBuffer");
+	lua_pushcfunction(L, __newSpriteBuffer);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "drawSprites");
+	lua_pushcfunction(L, __drawSprites);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "createMesh");
+	lua_pushcfunction(L, __createMesh);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "drawMesh");
+	lua_pushcfunction(L, __drawMesh);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "setShapeColor");
+	lua_pushcfunction(L, __setShapeColor);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "setShapeLayer");
+	lua_pushcfunction(L, __setShapeLayer);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "rect");
+	lua_pushcfunction(L, __rect);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "roundedRect");
+	lua_pushcfunction(L, __roundedRect);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "circle");
+	lua_pushcfunction(L, __circle);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "line");
+	lua_pushcfunction(L, __line);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "polyline");
+	lua_pushcfunction(L, __polyline);
+	lua_settable(L, -3);
+
 	lua_pushliteral(L, "setCamera");
 	lua_pushcfunction(L, __setCamera);
 	lua_settable(L, -3);
 
+	lua_pushliteral(L, "pushTransform");
+	lua_pushcfunction(L, __pushTransform);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "popTransform");
+	lua_pushcfunction(L, __popTransform);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "getCommandBufferStats");
+	lua_pushcfunction(L, __getCommandBufferStats);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "captureFrame");
+	lua_pushcfunction(L, __captureFrame);
+	lua_settable(L, -3);
+
+	lua_pushliteral(L, "capture");
+	lua_pushcfunction(L, __capture);
+	lua_settable(L, -3);
+
 	lua_pushliteral(L, "topology");
 	lua_newtable(L);
 
@@ -508,6 +1749,38 @@ void jm_luaopen_graphics(
 										metatable.__metatable = methods */
 	lua_pop(L, 1);
 
+	luaL_newmetatable(L, "SpriteBuffer");
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, lua_SpriteBuffer___gc);
+	lua_rawset(L, -3);
+
+	lua_pushliteral(L, "__index");
+	lua_pushvalue(L, -2);               /* methods live in the metatable */
+	lua_rawset(L, -3);
+
+	lua_pushliteral(L, "add");
+	lua_pushcfunction(L, lua_SpriteBuffer_add);
+	lua_rawset(L, -3);
+
+	lua_pushliteral(L, "clear");
+	lua_pushcfunction(L, lua_SpriteBuffer_clear);
+	lua_rawset(L, -3);
+
+	lua_pushliteral(L, "count");
+	lua_pushcfunction(L, lua_SpriteBuffer_count);
+	lua_rawset(L, -3);
+
+	lua_pop(L, 1);
+
+	luaL_newmetatable(L, "Mesh");
+
+	lua_pushliteral(L, "__gc");
+	lua_pushcfunction(L, lua_Mesh___gc);
+	lua_rawset(L, -3);
+
+	lua_pop(L, 1);
+
 	lua_pushliteral(L, "graphics");
 	lua_pushvalue(L, -2);
 	lua_settable(L, -4);
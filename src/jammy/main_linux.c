@@ -1,5 +1,7 @@
 #if defined(JM_LINUX)
 #include <jammy/command_buffer.h>
+#include <jammy/capture.h>
+#include <jammy/frame_writer.h>
 #include <jammy/file.h>
 #include <jammy/renderer.h>
 #include <jammy/audio.h>
@@ -14,22 +16,35 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#if defined(JM_RENDERER_OPENGL)
 #include <X11/Xlib.h>
 #include <GL/glew.h>
 #include <GL/glxew.h>
 #include <GL/glx.h>
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <limits.h>
 #include <unistd.h>
 #include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/stat.h>
  
+// initial command buffer sizes, both grow on demand
 #define COMMAND_BUFFER_SIZE (2 * 1024 * 1024)
 #define MAX_RENDER_COMMANDS 4096
 
 #define TICK_RATE (1.0 / 60.0)
 
+#define DEFAULT_REPLAY_FRAMES 100
+
+// headless runs report the work they gave the renderer this often
+#define HEADLESS_REPORT_INTERVAL 600
+
 #if defined(JM_STANDALONE)
 #define jm_lua_call lua_call
 #else
@@ -47,8 +62,583 @@ static void jm_lua_call(
 }
 #endif
 
-int main() 
+// Tells apart frames that would render the same as the last submitted one, 
+// for jam.graphics.skipUnchangedFrames.
+typedef struct jm_frame_skip
+{
+    bool isEnabled;
+    uint64_t submittedHash;
+    // frames a submitted frame takes to be shown, which are submitted after 
+    // a change even if they're unchanged
+    uint32_t latency;
+    uint32_t pendingFrameCount;
+} jm_frame_skip;
+
+static void jm_frame_skip_init(
+    jm_frame_skip* skip,
+    bool isEnabled,
+    uint32_t latency)
+{
+    skip->isEnabled = isEnabled;
+    skip->submittedHash = 0;
+    skip->latency = latency;
+    skip->pendingFrameCount = 0;
+}
+
+#if defined(JM_RENDERER_OPENGL)
+// Makes the next frame count as changed, when the window has to be redrawn.
+static void jm_frame_skip_invalidate(
+    jm_frame_skip* skip)
+{
+    skip->submittedHash = 0;
+}
+#endif
+
+// Returns true if the recording can be dropped and the last frame shown 
+// instead. Called once per frame, after draw.
+static bool jm_frame_skip_should_skip(
+    jm_frame_skip* skip,
+    const jm_command_buffer* cb)
+{
+    if (!skip->isEnabled)
+    {
+        return false;
+    }
+
+    rmt_BeginCPUSample(jm_capture_hash, 0);
+    const uint64_t hash = jm_capture_hash(cb);
+    rmt_EndCPUSample();
+
+    // 0 is never treated as unchanged
+    if (hash == 0 || hash != skip->submittedHash)
+    {
+        skip->submittedHash = hash;
+        skip->pendingFrameCount = skip->latency;
+        return false;
+    }
+    if (skip->pendingFrameCount > 0)
+    {
+        --skip->pendingFrameCount;
+        return false;
+    }
+    return true;
+}
+
+// How a game that is drawn at its own resolution is scaled up to the window
+typedef enum jm_upscale_mode
+{
+    // drawn at the window's resolution
+    JM_UPSCALE_MODE_NONE,
+    // the largest integer scale that fits, centered
+    JM_UPSCALE_MODE_LETTERBOX,
+    // the largest scale that fits and keeps the aspect ratio, centered
+    JM_UPSCALE_MODE_FIT,
+} jm_upscale_mode;
+
+#if !defined(JM_RENDERER_NULL)
+// Path of a frame recorded with --record or --record-raw.
+static void jm_get_record_path(
+    char* dst,
+    size_t size,
+    const char* recordPath,
+    bool isRecordingRaw,
+    uint32_t frame)
+{
+    snprintf(dst, size, "%s/frame_%06u.%s", recordPath, frame, isRecordingRaw ? "rgba" : "png");
+}
+#endif
+
+#if defined(JM_RENDERER_OPENGL)
+typedef struct jm_render_thread_param
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixelScale;
+
+    // the game is drawn into sceneTarget at width by height pixels and scaled 
+    // up to the window, unless upscaleMode is JM_UPSCALE_MODE_NONE
+    jm_upscale_mode upscaleMode;
+    jm_render_target_resource sceneTarget;
+    // set by the gameplay thread along with commandBuffer, frame counts the 
+    // submitted frames from 1
+    uint32_t windowWidth;
+    uint32_t windowHeight;
+    uint32_t frame;
+
+    jm_command_buffer* commandBuffer;
+
+    // directory every frame is written to, or NULL
+    const char* recordPath;
+    bool isRecordingRaw;
+
+    Display* display;
+    Window window;
+    GLXContext context;
+
+    sem_t commandBufferSubmitted;
+    sem_t commandBufferFilled;
+
+    bool shouldContinue;
+} jm_render_thread_param;
+
+// Hands the readbacks the GPU has finished to the frame writer, or all of 
+// them if wait is true.
+static void jm_end_frame_readbacks(
+    bool wait)
+{
+    jm_readback readback;
+    while (jm_renderer_end_readback(wait, &readback))
+    {
+        char* path = (char*)readback.userData;
+        jm_frame_writer_write(path, jm_frame_writer_get_format(path), readback.pixels, readback.width, readback.height, true);
+        free(path);
+    }
+}
+
+// Starts reading back the frame at the resolution it was drawn at, which is 
+// the scene target's for upscaled games.
+static void jm_begin_frame_readback(
+    const jm_render_thread_param* param,
+    const char* path)
+{
+    const uint32_t scale = (param->upscaleMode != JM_UPSCALE_MODE_NONE) ? 1 : param->pixelScale;
+    char* readbackPath = malloc(strlen(path) + 1);
+    strcpy(readbackPath, path);
+
+    jm_renderer_bind_render_target(NULL);
+    if (!jm_renderer_begin_readback(0, 0, param->width * scale, param->height * scale, readbackPath))
+    {
+        // the GPU is a whole ring of readbacks behind
+        jm_end_frame_readbacks(true);
+        jm_renderer_begin_readback(0, 0, param->width * scale, param->height * scale, readbackPath);
+    }
+}
+
+static void jm_render_frame(
+    const jm_render_thread_param* param,
+    jm_command_buffer* commandBuffer)
+{
+    // swap buffers
+    rmt_BeginCPUSample(glXSwapBuffers, 0);
+    glXSwapBuffers(param->display, param->window);
+    rmt_EndCPUSample();
+
+    // draw into the scene target, if there is one
+    jm_renderer_bind_render_target(NULL);
+    if (param->upscaleMode != JM_UPSCALE_MODE_NONE)
+    {
+        glViewport(0, 0, param->width, param->height);
+    }
+    else
+    {
+        glViewport(0, 0, param->width * param->pixelScale, param->height * param->pixelScale);
+    }
+
+    // clear the backbuffer
+    rmt_BeginCPUSample(clear, 0);
+    // depth writes may have been left disabled by the last translucent draw
+    jm_renderer_set_blend_state(JM_BLEND_STATE_OPAQUE);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    rmt_EndCPUSample();
+
+    // execute render commands
+    jm_draw_context drawContext;
+    jm_draw_context_begin(&drawContext, NULL);
+    jm_command_buffer_sort(commandBuffer);
+    jm_command_buffer_execute(commandBuffer, &drawContext);
+
+    // frames are read back before they're scaled up
+    rmt_BeginCPUSample(readback, 0);
+    jm_end_frame_readbacks(false);
+    if (commandBuffer->capturePath != NULL)
+    {
+        jm_begin_frame_readback(param, commandBuffer->capturePath);
+    }
+    if (param->recordPath != NULL)
+    {
+        char path[PATH_MAX];
+        jm_get_record_path(path, sizeof(path), param->recordPath, param->isRecordingRaw, param->frame);
+        jm_begin_frame_readback(param, path);
+    }
+    rmt_EndCPUSample();
+
+    if (param->upscaleMode != JM_UPSCALE_MODE_NONE)
+    {
+        rmt_BeginCPUSample(upscale, 0);
+        const float scaleX = (float)param->windowWidth / (float)param->width;
+        const float scaleY = (float)param->windowHeight / (float)param->height;
+        float scale = (scaleX < scaleY) ? scaleX : scaleY;
+        if (param->upscaleMode == JM_UPSCALE_MODE_LETTERBOX)
+        {
+            // windows smaller than the game show it at its own size, cropped
+            scale = (scale >= 1.0f) ? floorf(scale) : 1.0f;
+        }
+        const int32_t width = (int32_t)(param->width * scale);
+        const int32_t height = (int32_t)(param->height * scale);
+        const int32_t x = ((int32_t)param->windowWidth - width) / 2;
+        const int32_t y = ((int32_t)param->windowHeight - height) / 2;
+        jm_renderer_blit_render_target(param->sceneTarget, x, y, width, height);
+        rmt_EndCPUSample();
+    }
+}
+
+static void* jm_render_thread_proc(
+    void* arg)
+{
+    jm_render_thread_param* param = (jm_render_thread_param*)arg;
+
+    rmt_SetCurrentThreadName("Rendering");
+
+    glXMakeCurrent(param->display, param->window, param->context);
+
+    while (true)
+    {
+        rmt_BeginCPUSample(frame, 0);
+
+        rmt_BeginCPUSample(wait, 0);
+        {
+            // tell the gameplay thread that the command buffer has been 
+            // submitted and wait for the next command buffer to be filled
+            sem_post(&param->commandBufferSubmitted);
+            sem_wait(&param->commandBufferFilled);
+
+            rmt_EndCPUSample();
+        }
+
+        if (!param->shouldContinue)
+        {
+            break;
+        }
+
+        jm_render_frame(param, param->commandBuffer);
+
+        rmt_EndCPUSample();
+    }
+
+    // readbacks need the context
+    jm_end_frame_readbacks(true);
+
+    glXMakeCurrent(param->display, None, NULL);
+    return NULL;
+}
+
+#endif
+
+static double jm_elapsed_ms(
+    const struct timespec* start,
+    const struct timespec* end)
+{
+    return (double)(end->tv_sec - start->tv_sec) * 1000.0 + (double)(end->tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+#if defined(JM_RENDERER_HEADLESS)
+// Headless builds render on the gameplay thread, this only says where 
+// frames go.
+typedef struct jm_render_thread_param
+{
+    // printf pattern of the frame number that software rendered frames are 
+    // written to as PNGs, or NULL
+    const char* outputPath;
+    // pixels are scaled up by this when they're written
+    uint32_t outputScale;
+    // unchanged frames aren't executed, the framebuffer still has them
+    bool skipUnchangedFrames;
+    // directory every frame is written to, or NULL
+    const char* recordPath;
+    bool isRecordingRaw;
+} jm_render_thread_param;
+
+static void jm_render_frame(
+    const jm_render_thread_param* param,
+    jm_command_buffer* commandBuffer)
+{
+#if defined(JM_RENDERER_SOFTWARE)
+    jm_renderer_clear(0xff000000);
+#endif
+
+    jm_draw_context drawContext;
+    jm_draw_context_begin(&drawContext, NULL);
+    jm_command_buffer_sort(commandBuffer);
+    jm_command_buffer_execute(commandBuffer, &drawContext);
+}
+
+#if defined(JM_RENDERER_SOFTWARE)
+// Queues a copy of the framebuffer to be written to path.
+static void jm_write_framebuffer(
+    const char* path)
+{
+    uint32_t width;
+    uint32_t height;
+    jm_renderer_get_framebuffer_size(&width, &height);
+    uint32_t* pixels = malloc(sizeof(uint32_t) * width * height);
+    jm_renderer_read_framebuffer(pixels);
+    jm_frame_writer_write(path, jm_frame_writer_get_format(path), pixels, width, height, false);
+}
+#endif
+
+static void jm_write_frame(
+    const jm_render_thread_param* param,
+    const jm_command_buffer* commandBuffer,
+    uint32_t frame)
+{
+#if defined(JM_RENDERER_SOFTWARE)
+    char path[PATH_MAX];
+    if (param->outputPath != NULL)
+    {
+        snprintf(path, sizeof(path), param->outputPath, frame);
+        jm_renderer_write_png(path, param->outputScale);
+    }
+    if (commandBuffer->capturePath != NULL)
+    {
+        jm_write_framebuffer(commandBuffer->capturePath);
+    }
+    if (param->recordPath != NULL)
+    {
+        jm_get_record_path(path, sizeof(path), param->recordPath, param->isRecordingRaw, frame);
+        jm_write_framebuffer(path);
+    }
+#else
+    if (commandBuffer->capturePath != NULL)
+    {
+        fprintf(stderr, "jam.graphics.capture needs a build with the software renderer\n");
+    }
+#endif
+}
+
+static void jm_print_headless_stats(
+    uint32_t frame,
+    uint32_t intervalFrameCount,
+    double elapsedMs)
+{
+    const double frames = (intervalFrameCount > 0) ? (double)intervalFrameCount : 1.0;
+#if defined(JM_RENDERER_NULL)
+    const jm_renderer_null_stats* stats = &g_nullRendererStats;
+    printf("Frame %u: %.3f ms per frame, per frame %.1f commands, %.1f vertices, %.1f indices, %.1f sprites, %.1f characters, %u textures (%.1f MB)\n",
+        frame,
+        elapsedMs / frames,
+        (double)stats->commandCount / frames,
+        (double)stats->vertexCount / frames,
+        (double)stats->indexCount / frames,
+        (double)stats->spriteCount / frames,
+        (double)stats->characterCount / frames,
+        (uint32_t)stats->textureCount,
+        (double)stats->textureSize / (1024.0 * 1024.0));
+    jm_renderer_reset_null_stats();
+#else
+    printf("Frame %u: %.3f ms per frame\n", frame, elapsedMs / frames);
+#endif
+}
+
+// Runs the game without a window or input as fast as it can. Every frame is 
+// one tick, so the game sees the same time steps as it does in real time.
+static int jm_run_headless(
+    lua_State* L,
+    const jm_render_thread_param* param,
+    jm_command_buffer* commandBuffer,
+    int fnTick,
+    int fnDraw,
+    uint32_t width,
+    uint32_t height,
+    uint32_t pixelScale,
+    uint32_t frameCount)
+{
+    lua_getglobal(L, "start");
+    jm_lua_call(L, 0, 0);
+
+    jm_set_current_command_buffer(commandBuffer);
+
+    // frames are done when they're executed, there's nothing to present
+    jm_frame_skip frameSkip;
+    jm_frame_skip_init(&frameSkip, param->skipUnchangedFrames, 0);
+
+    struct timespec reportTime;
+    clock_gettime(CLOCK_MONOTONIC, &reportTime);
+    uint32_t reportFrame = 0;
+
+    // 0 runs until the process is stopped
+    for (uint32_t frame = 1; frameCount == 0 || frame <= frameCount; ++frame)
+    {
+        lua_getglobal(L, "jam");
+        lua_pushliteral(L, "elapsedTime");
+        lua_pushnumber(L, (lua_Number)(frame * TICK_RATE));
+        lua_settable(L, -3);
+        lua_pushliteral(L, "deltaTime");
+        lua_pushnumber(L, (lua_Number)TICK_RATE);
+        lua_settable(L, -3);
+        lua_pop(L, 1);
+
+        jm_command_buffer_begin(commandBuffer);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, fnTick);
+        jm_lua_call(L, 0, 0);
+
+        lua_rawgeti(L, LUA_REGISTRYINDEX, fnDraw);
+        jm_lua_call(L, 0, 0);
+
+        jm_capture_end_frame(commandBuffer, width, height, pixelScale);
+
+        if (!jm_frame_skip_should_skip(&frameSkip, commandBuffer))
+        {
+            jm_render_frame(param, commandBuffer);
+        }
+        jm_write_frame(param, commandBuffer, frame);
+        jm_meshes_collect();
+
+        if (frame % HEADLESS_REPORT_INTERVAL == 0 || frame == frameCount)
+        {
+            struct timespec currentTime;
+            clock_gettime(CLOCK_MONOTONIC, &currentTime);
+            jm_print_headless_stats(frame, frame - reportFrame, jm_elapsed_ms(&reportTime, &currentTime));
+            reportTime = currentTime;
+            reportFrame = frame;
+        }
+    }
+
+    jm_frame_writer_shutdown();
+    return 0;
+}
+#endif
+
+// Renders a captured frame repeatedly and prints how long it took.
+static int jm_replay_run(
+    jm_replay* replay,
+    const jm_render_thread_param* param,
+    jm_command_buffer* commandBuffer,
+    uint32_t frameCount)
 {
+    if (!jm_replay_load(replay, commandBuffer))
+    {
+        return 1;
+    }
+
+    printf("Replaying %u commands for %u frames\n", replay->header.commandCount, frameCount);
+
+    double totalMs = 0.0;
+    double minMs = 0.0;
+    double maxMs = 0.0;
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        jm_replay_restore(replay, commandBuffer);
+
+        struct timespec startTime;
+        clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+        jm_render_frame(param, commandBuffer);
+#if defined(JM_RENDERER_OPENGL)
+        // wait for the GPU, so the frame is timed and not just its submission
+        glFinish();
+#endif
+
+        struct timespec endTime;
+        clock_gettime(CLOCK_MONOTONIC, &endTime);
+
+#if defined(JM_RENDERER_HEADLESS)
+        jm_write_frame(param, commandBuffer, i + 1);
+#endif
+
+        const double ms = jm_elapsed_ms(&startTime, &endTime);
+        totalMs += ms;
+        minMs = (i == 0 || ms < minMs) ? ms : minMs;
+        maxMs = (i == 0 || ms > maxMs) ? ms : maxMs;
+    }
+
+    if (frameCount > 0)
+    {
+        printf("Frame time: avg %.3f ms, min %.3f ms, max %.3f ms\n", totalMs / frameCount, minMs, maxMs);
+    }
+
+    jm_frame_writer_shutdown();
+    return 0;
+}
+
+#if !defined(JM_RENDERER_NULL)
+// Paths given on the command line are relative to the working directory, 
+// which main changes to the executable's.
+static char* jm_get_absolute_path(
+    const char* path)
+{
+    if (path[0] == '/')
+    {
+        char* absolutePath = malloc(strlen(path) + 1);
+        strcpy(absolutePath, path);
+        return absolutePath;
+    }
+
+    char* cwd = getcwd(NULL, 0);
+    char* absolutePath = malloc(strlen(cwd) + strlen(path) + 2);
+    sprintf(absolutePath, "%s/%s", cwd, path);
+    free(cwd);
+    return absolutePath;
+}
+#endif
+
+int main(
+    int argc,
+    char** argv)
+{
+    // --replay <capture> renders a capture instead of running the game, 
+    // --headless runs the game without a window and --frames <count> limits 
+    // how many frames either of them runs. --output <pattern> writes the 
+    // frames of software rendering builds to PNGs. --record <dir> writes 
+    // every frame to a directory as PNGs, --record-raw <dir> as raw pixels.
+    char* replayPath = NULL;
+#if defined(JM_RENDERER_HEADLESS)
+    char* outputPath = NULL;
+#endif
+    char* recordPath = NULL;
+    bool isRecordingRaw = false;
+    uint32_t frameCount = 0;
+    bool headless = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+        {
+            headless = true;
+        }
+        else if (i + 1 == argc)
+        {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        else if (strcmp(argv[i], "--replay") == 0)
+        {
+            // resolved before changing directory
+            replayPath = realpath(argv[++i], NULL);
+            if (replayPath == NULL)
+            {
+                fprintf(stderr, "Can't find capture '%s'\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--frames") == 0)
+        {
+            frameCount = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+#if defined(JM_RENDERER_SOFTWARE)
+            outputPath = jm_get_absolute_path(argv[++i]);
+#else
+            fprintf(stderr, "--output needs a build with the software renderer (premake5 --renderer=software)\n");
+            return 1;
+#endif
+        }
+        else if (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--record-raw") == 0)
+        {
+#if defined(JM_RENDERER_NULL)
+            fprintf(stderr, "%s needs a build with a renderer that draws pixels (premake5 --renderer=software)\n", argv[i]);
+            return 1;
+#else
+            isRecordingRaw = strcmp(argv[i], "--record-raw") == 0;
+            recordPath = jm_get_absolute_path(argv[++i]);
+            // an existing directory is written into
+            mkdir(recordPath, 0755);
+#endif
+        }
+    }
+
     char exePath[256];
     readlink("/proc/self/exe", exePath, sizeof(exePath));
     char* lastDash = strrchr(exePath, '/');
@@ -80,6 +670,12 @@ int main()
 		return 1;
 	}
 
+	if (jm_meshes_init())
+	{
+		fprintf(stderr, "jm_meshes_init failed");
+		return 1;
+	}
+
 	if (jm_effects_init())
 	{
 		fprintf(stderr, "jm_effects_init failed");
@@ -108,11 +704,14 @@ int main()
 	}
 #endif
 
+#if defined(JM_RENDERER_OPENGL)
+    // only windows have keys
     lua_getglobal(L, "keyDown");
 	const int fnKeyDown = luaL_ref(L, LUA_REGISTRYINDEX);
 
 	lua_getglobal(L, "keyUp");
 	const int fnKeyUp = luaL_ref(L, LUA_REGISTRYINDEX);
+#endif
 
 	lua_getglobal(L, "tick");
 	const int fnTick = luaL_ref(L, LUA_REGISTRYINDEX);
@@ -125,7 +724,15 @@ int main()
     uint32_t width;
     uint32_t height;
 	uint32_t pixelScale = 1;
+#if defined(JM_RENDERER_OPENGL)
     int vsync = true;
+    int renderThread = true;
+#endif
+    int skipUnchangedFrames = false;
+    uint32_t textureAtlasMaxSize = 0;
+#if !defined(JM_RENDERER_NULL)
+    jm_upscale_mode upscaleMode = JM_UPSCALE_MODE_NONE;
+#endif
 
 	lua_getglobal(L, "jam");
     {
@@ -175,6 +782,7 @@ int main()
             }
             lua_pop(L, 1);
 
+#if defined(JM_RENDERER_OPENGL)
             lua_pushliteral(L, "vsync");
             lua_gettable(L, -2);
             if (lua_isboolean(L, -1))
@@ -183,12 +791,136 @@ int main()
             }
             lua_pop(L, 1);
 
+            lua_pushliteral(L, "renderThread");
+            lua_gettable(L, -2);
+            if (lua_isboolean(L, -1))
+            {
+                renderThread = lua_toboolean(L, -1);
+            }
+            lua_pop(L, 1);
+#endif
+
+            lua_pushliteral(L, "skipUnchangedFrames");
+            lua_gettable(L, -2);
+            if (lua_isboolean(L, -1))
+            {
+                skipUnchangedFrames = lua_toboolean(L, -1);
+            }
+            lua_pop(L, 1);
+
+            // textures up to this size are packed into atlas pages, true selects the default size
+            lua_pushliteral(L, "textureAtlas");
+            lua_gettable(L, -2);
+            if (lua_isnumber(L, -1))
+            {
+                textureAtlasMaxSize = (uint32_t)lua_tointeger(L, -1);
+            }
+            else if (lua_isboolean(L, -1) && lua_toboolean(L, -1))
+            {
+                textureAtlasMaxSize = JM_TEXTURE_ATLAS_DEFAULT_MAX_SIZE;
+            }
+            lua_pop(L, 1);
+
+#if !defined(JM_RENDERER_NULL)
+            // draws at the game's resolution and scales the frame up, true selects letterboxing
+            lua_pushliteral(L, "upscale");
+            lua_gettable(L, -2);
+            if (lua_isstring(L, -1) && strcmp(lua_tostring(L, -1), "fit") == 0)
+            {
+                upscaleMode = JM_UPSCALE_MODE_FIT;
+            }
+            else if (lua_isstring(L, -1) && strcmp(lua_tostring(L, -1), "letterbox") == 0)
+            {
+                upscaleMode = JM_UPSCALE_MODE_LETTERBOX;
+            }
+            else if (lua_isboolean(L, -1) && lua_toboolean(L, -1))
+            {
+                upscaleMode = JM_UPSCALE_MODE_LETTERBOX;
+            }
+            else if (!lua_isnil(L, -1) && !lua_isboolean(L, -1))
+            {
+                fprintf(stderr, "jam.graphics.upscale must be \"letterbox\", \"fit\" or a boolean\n");
+            }
+            lua_pop(L, 1);
+#endif
+
             lua_pop(L, 1);
         }
 
         lua_pop(L, 1);
     }
 
+    // the game's configuration is still used for everything that affects 
+    // how the capture was recorded, like the texture atlas
+    jm_replay replay;
+    if (replayPath != NULL)
+    {
+        if (!jm_replay_open(&replay, replayPath))
+        {
+            return 1;
+        }
+        free(replayPath);
+
+        width = replay.header.width;
+        height = replay.header.height;
+        pixelScale = replay.header.pixelScale;
+#if defined(JM_RENDERER_OPENGL)
+        vsync = false;
+        renderThread = false;
+#endif
+    }
+
+    if (textureAtlasMaxSize > 0 && !jm_textures_set_atlas_enabled(true, textureAtlasMaxSize))
+    {
+        fprintf(stderr, "jam.graphics.textureAtlas is not supported by this renderer\n");
+    }
+
+#if defined(JM_RENDERER_HEADLESS)
+    // there's nothing to show a window for
+    headless = true;
+#endif
+
+    if (headless)
+    {
+#if defined(JM_RENDERER_HEADLESS)
+#if defined(JM_RENDERER_SOFTWARE)
+        // upscaled frames are only scaled up when they're written
+        const uint32_t framebufferScale = (upscaleMode != JM_UPSCALE_MODE_NONE) ? 1 : pixelScale;
+        jm_renderer_set_framebuffer_size(width * framebufferScale, height * framebufferScale);
+#endif
+        if (jm_renderer_init())
+        {
+            fprintf(stderr, "jm_renderer_init failed");
+            exit(1);
+        }
+
+        jm_render_thread_param headlessParam;
+        headlessParam.outputPath = outputPath;
+        headlessParam.skipUnchangedFrames = skipUnchangedFrames;
+        headlessParam.recordPath = recordPath;
+        headlessParam.isRecordingRaw = isRecordingRaw;
+#if defined(JM_RENDERER_SOFTWARE)
+        headlessParam.outputScale = pixelScale / framebufferScale;
+#else
+        headlessParam.outputScale = 1;
+#endif
+        if (replayPath != NULL)
+        {
+            const int result = jm_replay_run(&replay, &headlessParam, &commandBuffers[0], (frameCount > 0) ? frameCount : DEFAULT_REPLAY_FRAMES);
+            jm_replay_close(&replay);
+            return result;
+        }
+        return jm_run_headless(L, &headlessParam, &commandBuffers[0], fnTick, fnDraw, width, height, pixelScale, frameCount);
+#else
+        fprintf(stderr, "--headless needs a build with the null or software renderer (premake5 --renderer=null)\n");
+        return 1;
+#endif
+    }
+
+#if defined(JM_RENDERER_OPENGL)
+    // the render thread uses the display too
+    XInitThreads();
+
     Display* display = XOpenDisplay(NULL);
     if (display == NULL) {
         fprintf(stderr, "Cannot open display\n");
@@ -240,11 +972,20 @@ int main()
 
     free(gameName);
 
-    // prevent window resizing
+    // prevent window resizing, upscaled games can be resized down to their own size
     XSizeHints* sizeHints = XAllocSizeHints();
-    sizeHints->flags = PMinSize | PMaxSize;
-    sizeHints->min_width = sizeHints->max_width = width * pixelScale;
-    sizeHints->min_height = sizeHints->max_height = height * pixelScale;
+    if (upscaleMode != JM_UPSCALE_MODE_NONE)
+    {
+        sizeHints->flags = PMinSize;
+        sizeHints->min_width = width;
+        sizeHints->min_height = height;
+    }
+    else
+    {
+        sizeHints->flags = PMinSize | PMaxSize;
+        sizeHints->min_width = sizeHints->max_width = width * pixelScale;
+        sizeHints->min_height = sizeHints->max_height = height * pixelScale;
+    }
     XSetWMNormalHints(display, window, sizeHints);
     XFree(sizeHints);
 
@@ -273,6 +1014,8 @@ int main()
     printf("GL Renderer: %s\n", glGetString(GL_RENDERER));
     printf("GL Version: %s\n", glGetString(GL_VERSION));
     printf("GL Shading Language: %s\n", glGetString(GL_SHADING_LANGUAGE_VERSION));
+    printf("GL Dynamic buffers: %s\n", GLEW_ARB_buffer_storage ? "persistently mapped" : "orphaned");
+    printf("GL Sprite instances: %s\n", GLEW_ARB_base_instance ? "base instance" : "re-pointed attributes");
 
     if (jm_renderer_init())
 	{
@@ -280,7 +1023,33 @@ int main()
 		exit(1);
 	}
 
-    const long windowEventMask = KeyPressMask | KeyReleaseMask;
+    // upscaled games are drawn into a target of their own size, which 
+    // render target passes return to instead of the backbuffer
+    jm_render_target_resource sceneTarget = NULL;
+    if (upscaleMode != JM_UPSCALE_MODE_NONE)
+    {
+        jm_render_target_resource_desc sceneTargetDesc;
+        sceneTargetDesc.name = "scene";
+        sceneTargetDesc.width = width;
+        sceneTargetDesc.height = height;
+        jm_texture_resource sceneTexture;
+        jm_renderer_create_render_target_resource(&sceneTargetDesc, &sceneTarget, &sceneTexture);
+        jm_renderer_set_default_render_target(sceneTarget);
+    }
+
+    // resources are created on the gameplay thread through a second context 
+    // that shares objects with the render context
+    GLXContext resourceContext = context;
+    if (renderThread)
+    {
+        resourceContext = glXCreateContext(display, visual, context, GL_TRUE);
+        glXMakeCurrent(display, None, NULL);
+        glXMakeCurrent(display, window, resourceContext);
+    }
+
+    // upscaled games are scaled to the window's size when it changes, and 
+    // skipped frames are drawn again when the window was covered
+    const long windowEventMask = KeyPressMask | KeyReleaseMask | StructureNotifyMask | ExposureMask;
     XSelectInput(display, window, windowEventMask);
  
     // intercept WM_DELETE_WINDOW, which is fired when a user wants to close the window
@@ -289,6 +1058,49 @@ int main()
 
     XMapWindow(display, window);
 
+    jm_render_thread_param renderThreadParam;
+    renderThreadParam.width = width;
+    renderThreadParam.height = height;
+    renderThreadParam.pixelScale = pixelScale;
+    renderThreadParam.upscaleMode = upscaleMode;
+    renderThreadParam.sceneTarget = sceneTarget;
+    renderThreadParam.windowWidth = width * pixelScale;
+    renderThreadParam.windowHeight = height * pixelScale;
+    renderThreadParam.frame = 0;
+    renderThreadParam.commandBuffer = NULL;
+    renderThreadParam.recordPath = recordPath;
+    renderThreadParam.isRecordingRaw = isRecordingRaw;
+    renderThreadParam.display = display;
+    renderThreadParam.window = window;
+    renderThreadParam.context = context;
+    renderThreadParam.shouldContinue = true;
+    sem_init(&renderThreadParam.commandBufferSubmitted, 0, 0);
+    sem_init(&renderThreadParam.commandBufferFilled, 0, 0);
+
+    if (replayPath != NULL)
+    {
+        // reading frames back would be timed along with them
+        renderThreadParam.recordPath = NULL;
+        if (recordPath != NULL)
+        {
+            fprintf(stderr, "--record is ignored by --replay in builds with a window\n");
+        }
+        const int result = jm_replay_run(&replay, &renderThreadParam, &commandBuffers[0], (frameCount > 0) ? frameCount : DEFAULT_REPLAY_FRAMES);
+        jm_replay_close(&replay);
+        return result;
+    }
+
+    // start render thread
+    pthread_t renderThreadHandle;
+    if (renderThread)
+    {
+        if (pthread_create(&renderThreadHandle, NULL, jm_render_thread_proc, &renderThreadParam))
+        {
+            fprintf(stderr, "pthread_create failed");
+            exit(1);
+        }
+    }
+
     lua_getglobal(L, "start");
 	jm_lua_call(L, 0, 0);
 
@@ -302,10 +1114,26 @@ int main()
 
     double tickTimer = 0.0;
 
+    uint32_t windowWidth = width * pixelScale;
+    uint32_t windowHeight = height * pixelScale;
+
+    // frames are swapped in when the next one is rendered, recordings have 
+    // every frame
+    jm_frame_skip frameSkip;
+    jm_frame_skip_init(&frameSkip, skipUnchangedFrames && recordPath == NULL, 1);
+    bool isFrameSkipped = false;
+    uint32_t submittedFrameCount = 0;
+
     while (true) 
     {
         rmt_BeginCPUSample(tick, 0);
 
+        // flip command buffers, a skipped one was never handed over
+        if (renderThread && !isFrameSkipped)
+        {
+            bufferIndex = 1 - bufferIndex;
+        }
+
         bool shouldExit = false;
         while (XPending(display))
         {
@@ -325,6 +1153,20 @@ int main()
                         break;
                     }
 
+                    case Expose:
+                    {
+                        jm_frame_skip_invalidate(&frameSkip);
+                        break;
+                    }
+
+                    case ConfigureNotify:
+                    {
+                        windowWidth = (uint32_t)event.xconfigure.width;
+                        windowHeight = (uint32_t)event.xconfigure.height;
+                        jm_frame_skip_invalidate(&frameSkip);
+                        break;
+                    }
+
                     case KeyPress:
                     case KeyRelease:
                     {
@@ -397,35 +1239,78 @@ int main()
         jm_lua_call(L, 0, 0);
         rmt_EndCPUSample();
 
-        // swap buffers
-        rmt_BeginCPUSample(glXSwapBuffers, 0);
-        glXSwapBuffers(display, window);
-        rmt_EndCPUSample();
+        jm_capture_end_frame(&commandBuffers[bufferIndex], width, height, pixelScale);
 
-        // clear the backbuffer
-        rmt_BeginCPUSample(clear, 0);
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClearDepth(1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        rmt_EndCPUSample();
+        // captured frames are read back when they're rendered
+        isFrameSkipped = jm_frame_skip_should_skip(&frameSkip, &commandBuffers[bufferIndex]) && commandBuffers[bufferIndex].capturePath == NULL;
+        if (isFrameSkipped)
+        {
+            // the window keeps showing the last frame, and without a swap 
+            // to wait for the loop is paced by sleeping
+            const struct timespec idleTime = { 0, (long)(TICK_RATE * 1000000000.0) };
+            nanosleep(&idleTime, NULL);
+        }
+        else if (renderThread)
+        {
+            rmt_BeginCPUSample(wait, 0);
+            {
+                // wait until the previous command buffer has been submitted
+                sem_wait(&renderThreadParam.commandBufferSubmitted);
+
+                rmt_EndCPUSample();
+            }
 
-        glViewport(0, 0, width * pixelScale, height * pixelScale);
+            // the render thread is idle, with every earlier frame submitted
+            jm_meshes_collect();
 
-        // execute render commands
-        jm_draw_context drawContext;
-        jm_draw_context_begin(&drawContext, NULL);
-        jm_command_buffer_sort(&commandBuffers[bufferIndex]);
-        jm_command_buffer_execute(&commandBuffers[bufferIndex], &drawContext);
+            // tell the rendering thread which command buffer to submit
+            renderThreadParam.commandBuffer = &commandBuffers[bufferIndex];
+            renderThreadParam.windowWidth = windowWidth;
+            renderThreadParam.windowHeight = windowHeight;
+            renderThreadParam.frame = ++submittedFrameCount;
+
+            // signal the rendering thread
+            sem_post(&renderThreadParam.commandBufferFilled);
+        }
+        else
+        {
+            renderThreadParam.windowWidth = windowWidth;
+            renderThreadParam.windowHeight = windowHeight;
+            renderThreadParam.frame = ++submittedFrameCount;
+            jm_render_frame(&renderThreadParam, &commandBuffers[bufferIndex]);
+            jm_meshes_collect();
+        }
 
         rmt_EndCPUSample();
     }
 
+    if (renderThread)
+    {
+        renderThreadParam.shouldContinue = false;
+        sem_post(&renderThreadParam.commandBufferFilled);
+        pthread_join(renderThreadHandle, NULL);
+
+        glXMakeCurrent(display, None, NULL);
+        glXDestroyContext(display, resourceContext);
+    }
+    else
+    {
+        jm_end_frame_readbacks(true);
+    }
+
+    // queued frames are written before the process exits
+    jm_frame_writer_shutdown();
+
+    sem_destroy(&renderThreadParam.commandBufferSubmitted);
+    sem_destroy(&renderThreadParam.commandBufferFilled);
+
     glXDestroyContext(display, context);
  
     XFree(visual);
 	XFreeColormap(display, windowAttribs.colormap);
     XDestroyWindow(display, window);
     XCloseDisplay(display);
+#endif
     return 0;
 }
 #endif
\ No newline at end of file
@@ -1,5 +1,6 @@
 #if defined(JM_WINDOWS)
 #include <jammy/command_buffer.h>
+#include <jammy/capture.h>
 #include <jammy/file.h>
 #include <jammy/renderer.h>
 #include <jammy/audio.h>
@@ -14,12 +15,17 @@
 #include <lualib.h>
 #include <lauxlib.h>
 
+#if defined(JM_RENDERER_NULL) || defined(JM_RENDERER_SOFTWARE)
+#error "the null and software renderers are only supported on Linux"
+#endif
+
 #include <Windows.h>
 #include <shellapi.h>
 #include <d3d11.h>
 
 #include <stdlib.h>
 
+// initial command buffer sizes, both grow on demand
 #define COMMAND_BUFFER_SIZE (2 * 1024 * 1024)
 #define MAX_RENDER_COMMANDS 4096
 
@@ -93,6 +99,14 @@ int main(int argc, char** argv)
 	{
 		return jm_build(argc, argv);
 	}
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--record") == 0 || strcmp(argv[i], "--record-raw") == 0)
+		{
+			fprintf(stderr, "%s is not supported on this platform\n", argv[i]);
+		}
+	}
 #endif
 
 #if RMT_ENABLED
@@ -121,6 +135,12 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if (jm_meshes_init())
+	{
+		fprintf(stderr, "jm_meshes_init failed");
+		return 1;
+	}
+
 	if (jm_effects_init())
 	{
 		fprintf(stderr, "jm_effects_init failed");
@@ -168,6 +188,7 @@ int main(int argc, char** argv)
     uint32_t height;
 	uint32_t pixelScale = 1;
     int vsync = true;
+	uint32_t textureAtlasMaxSize = 0;
 
 	lua_getglobal(L, "jam");
     {
@@ -225,12 +246,48 @@ int main(int argc, char** argv)
             }
             lua_pop(L, 1);
 
+            // textures up to this size are packed into atlas pages, true selects the default size
+            lua_pushliteral(L, "textureAtlas");
+            lua_gettable(L, -2);
+            if (lua_isnumber(L, -1))
+            {
+                textureAtlasMaxSize = (uint32_t)lua_tointeger(L, -1);
+            }
+            else if (lua_isboolean(L, -1) && lua_toboolean(L, -1))
+            {
+                textureAtlasMaxSize = JM_TEXTURE_ATLAS_DEFAULT_MAX_SIZE;
+            }
+            lua_pop(L, 1);
+
+            // every frame is submitted here
+            lua_pushliteral(L, "skipUnchangedFrames");
+            lua_gettable(L, -2);
+            if (lua_isboolean(L, -1) && lua_toboolean(L, -1))
+            {
+                fprintf(stderr, "jam.graphics.skipUnchangedFrames is not supported on this platform\n");
+            }
+            lua_pop(L, 1);
+
+            // the game is always drawn at the window's resolution here
+            lua_pushliteral(L, "upscale");
+            lua_gettable(L, -2);
+            if (!lua_isnil(L, -1) && !(lua_isboolean(L, -1) && !lua_toboolean(L, -1)))
+            {
+                fprintf(stderr, "jam.graphics.upscale is not supported by this renderer\n");
+            }
+            lua_pop(L, 1);
+
             lua_pop(L, 1);
         }
 
         lua_pop(L, 1);
     }
 
+	if (textureAtlasMaxSize > 0 && !jm_textures_set_atlas_enabled(true, textureAtlasMaxSize))
+	{
+		fprintf(stderr, "jam.graphics.textureAtlas is not supported by this renderer\n");
+	}
+
 	WNDCLASS wc;
 	ZeroMemory(&wc, sizeof(wc));
 	wc.lpszClassName = gameName;
@@ -390,6 +447,14 @@ int main(int argc, char** argv)
 			rmt_EndCPUSample();
 		}
 
+		jm_capture_end_frame(&commandBuffers[bufferIndex], width, height, pixelScale);
+
+		// frames aren't read back here
+		if (commandBuffers[bufferIndex].capturePath != NULL)
+		{
+			fprintf(stderr, "jam.graphics.capture is not supported on this platform\n");
+		}
+
 		rmt_BeginCPUSample(wait, 0);
 		{
 			// wait until the previous command buffer has been submitted
@@ -398,6 +463,9 @@ int main(int argc, char** argv)
 			rmt_EndCPUSample();
 		}
 
+		// the render thread is idle, with every earlier frame submitted
+		jm_meshes_collect();
+
 		// tell the rendering thread which command buffer to submit
 		renderThreadParam.commandBuffer = &commandBuffers[bufferIndex];
 
@@ -573,32 +641,6 @@ static DWORD jm_render_thread_proc(
 			param->d3dctx->lpVtbl->RSSetState(param->d3dctx, jm_renderer_get_rasterizer_state());
 			param->d3dctx->lpVtbl->OMSetDepthStencilState(param->d3dctx, jm_renderer_get_depth_stencil_state(), 0);
 
-			// set view constants
-			typedef struct vs_constants
-			{
-				float viewProjectionMatrix[16];
-			} vs_constants;
-
-			ID3D11Buffer* vscb = jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS);
-			D3D11_MAPPED_SUBRESOURCE ms;
-			if (SUCCEEDED(param->d3dctx->lpVtbl->Map(param->d3dctx, (ID3D11Resource*)vscb, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
-			{
-				vs_constants* constants = ms.pData;
-				memset(constants, 0, sizeof(vs_constants));
-
-				float halfWidth = (float)param->width / 2.0f;
-				float halfHeight = (float)param->height / 2.0f;
-
-				constants->viewProjectionMatrix[0] = 1.0f / halfWidth;
-				constants->viewProjectionMatrix[5] = -1.0f / halfHeight;
-				constants->viewProjectionMatrix[10] = 1.0f;
-				constants->viewProjectionMatrix[12] = -1.0f;
-				constants->viewProjectionMatrix[13] = 1.0f;
-				constants->viewProjectionMatrix[15] = 1.0f;
-
-				param->d3dctx->lpVtbl->Unmap(param->d3dctx, (ID3D11Resource*)vscb, 0);
-			}
-
 			// execute render commands
 			jm_draw_context drawContext;
 			jm_draw_context_begin(
@@ -2,4 +2,20 @@
 
 #define jm_max(a, b) (((a) > (b)) ? (a) : (b))
 #define jm_min(a, b) (((a) < (b)) ? (a) : (b))
-#define jm_clamp(val, lower, upper) (jm_max(lower, jm_min(upper, val)))
\ No newline at end of file
+#define jm_clamp(val, lower, upper) (jm_max(lower, jm_min(upper, val)))
+// Column-major 4x4 product a * b.
+static inline void jm_multiply_transforms(float* out, const float* a, const float* b)
+{
+	for (int col = 0; col < 4; ++col)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k)
+			{
+				sum += a[k * 4 + row] * b[col * 4 + k];
+			}
+			out[col * 4 + row] = sum;
+		}
+	}
+}
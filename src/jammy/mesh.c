@@ -0,0 +1,180 @@
+#include "mesh.h"
+
+#include <jammy/assert.h>
+#include <jammy/renderer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_MESHES 1024
+
+typedef struct jm_meshes
+{
+	// one past the highest handle handed out
+	size_t count;
+	jm_mesh_desc* descs;
+	jm_mesh_resource* resources;
+	uint32_t* generations;
+	// handles of released meshes, reused before new ones
+	jm_mesh_handle* freeHandles;
+	uint32_t freeCount;
+	// destroyed since the last collect, and destroyed before it
+	jm_mesh_handle* pendingHandles;
+	uint32_t pendingCount;
+	jm_mesh_handle* retiredHandles;
+	uint32_t retiredCount;
+} jm_meshes;
+
+jm_meshes g_meshes;
+
+int jm_meshes_init()
+{
+	g_meshes.count = 0;
+	g_meshes.descs = calloc(MAX_MESHES, sizeof(jm_mesh_desc));
+	g_meshes.resources = calloc(MAX_MESHES, sizeof(jm_mesh_resource));
+	g_meshes.generations = calloc(MAX_MESHES, sizeof(uint32_t));
+	g_meshes.freeHandles = calloc(MAX_MESHES, sizeof(jm_mesh_handle));
+	g_meshes.freeCount = 0;
+	g_meshes.pendingHandles = calloc(MAX_MESHES, sizeof(jm_mesh_handle));
+	g_meshes.pendingCount = 0;
+	g_meshes.retiredHandles = calloc(MAX_MESHES, sizeof(jm_mesh_handle));
+	g_meshes.retiredCount = 0;
+	return 0;
+}
+
+static void* jm_mesh_copy(
+	const void* data,
+	size_t size)
+{
+	if (data == NULL)
+	{
+		return NULL;
+	}
+	void* copy = malloc(size);
+	memcpy(copy, data, size);
+	return copy;
+}
+
+jm_mesh_handle jm_create_mesh(
+	const jm_mesh_desc* desc)
+{
+	jm_assert(desc->vertices != NULL && desc->vertexCount > 0);
+	if (g_meshes.freeCount == 0 && g_meshes.count == MAX_MESHES)
+	{
+		printf("[ERROR] Can't have more than %d meshes", MAX_MESHES);
+		return JM_MESH_HANDLE_INVALID;
+	}
+
+	const jm_mesh_handle meshHandle = (g_meshes.freeCount > 0) ? g_meshes.freeHandles[--g_meshes.freeCount] : (jm_mesh_handle)g_meshes.count++;
+	++g_meshes.generations[meshHandle];
+	const size_t indexSize = desc->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+
+	jm_mesh_desc* mesh = &g_meshes.descs[meshHandle];
+	*mesh = *desc;
+	mesh->vertices = jm_mesh_copy(desc->vertices, sizeof(jm_vertex) * desc->vertexCount);
+	mesh->texcoords = jm_mesh_copy(desc->texcoords, sizeof(jm_texcoord) * desc->vertexCount);
+	mesh->indices = jm_mesh_copy(desc->indices, indexSize * desc->indexCount);
+	if (mesh->indices == NULL)
+	{
+		mesh->indexCount = 0;
+	}
+
+	// the buffers hold texcoords of the texture's resource, which may be an atlas page
+	jm_texcoord* resourceTexcoords = NULL;
+	if (jm_mesh_is_textured(meshHandle))
+	{
+		resourceTexcoords = jm_mesh_copy(mesh->texcoords, sizeof(jm_texcoord) * mesh->vertexCount);
+		jm_texture_remap_texcoords(mesh->textureHandle, resourceTexcoords, mesh->vertexCount);
+	}
+
+	jm_mesh_resource_desc resourceDesc;
+	resourceDesc.name = "mesh";
+	resourceDesc.vertices = mesh->vertices;
+	resourceDesc.texcoords = resourceTexcoords;
+	resourceDesc.indices = mesh->indices;
+	resourceDesc.vertexCount = mesh->vertexCount;
+	resourceDesc.indexCount = mesh->indexCount;
+	resourceDesc.isIndex32 = mesh->isIndex32;
+	jm_renderer_create_mesh_resource(&resourceDesc, &g_meshes.resources[meshHandle]);
+
+	free(resourceTexcoords);
+	return meshHandle;
+}
+
+void jm_destroy_mesh(
+	jm_mesh_handle meshHandle)
+{
+	jm_assert(jm_mesh_is_alive(meshHandle));
+	g_meshes.pendingHandles[g_meshes.pendingCount++] = meshHandle;
+}
+
+static void jm_mesh_release(
+	jm_mesh_handle meshHandle)
+{
+	jm_mesh_desc* mesh = &g_meshes.descs[meshHandle];
+	free((void*)mesh->vertices);
+	free((void*)mesh->texcoords);
+	free((void*)mesh->indices);
+	memset(mesh, 0, sizeof(jm_mesh_desc));
+
+	jm_renderer_destroy_mesh_resource(g_meshes.resources[meshHandle]);
+	g_meshes.resources[meshHandle] = 0;
+
+	g_meshes.freeHandles[g_meshes.freeCount++] = meshHandle;
+}
+
+void jm_meshes_collect()
+{
+	for (uint32_t i = 0; i < g_meshes.retiredCount; ++i)
+	{
+		jm_mesh_release(g_meshes.retiredHandles[i]);
+	}
+
+	// meshes destroyed since the last collect may be drawn by the frame that 
+	// is about to be rendered
+	jm_mesh_handle* retiredHandles = g_meshes.retiredHandles;
+	g_meshes.retiredHandles = g_meshes.pendingHandles;
+	g_meshes.retiredCount = g_meshes.pendingCount;
+	g_meshes.pendingHandles = retiredHandles;
+	g_meshes.pendingCount = 0;
+}
+
+uint32_t jm_meshes_get_count()
+{
+	return (uint32_t)g_meshes.count;
+}
+
+bool jm_mesh_is_alive(
+	jm_mesh_handle meshHandle)
+{
+	return meshHandle < g_meshes.count && g_meshes.descs[meshHandle].vertices != NULL;
+}
+
+uint32_t jm_mesh_get_generation(
+	jm_mesh_handle meshHandle)
+{
+	jm_assert(meshHandle < g_meshes.count);
+	return g_meshes.generations[meshHandle];
+}
+
+const jm_mesh_desc* jm_mesh_get_desc(
+	jm_mesh_handle meshHandle)
+{
+	jm_assert(meshHandle < g_meshes.count);
+	return &g_meshes.descs[meshHandle];
+}
+
+jm_mesh_resource jm_mesh_get_resource(
+	jm_mesh_handle meshHandle)
+{
+	jm_assert(meshHandle < g_meshes.count);
+	return g_meshes.resources[meshHandle];
+}
+
+bool jm_mesh_is_textured(
+	jm_mesh_handle meshHandle)
+{
+	const jm_mesh_desc* mesh = jm_mesh_get_desc(meshHandle);
+	return mesh->texcoords != NULL && mesh->textureHandle != JM_TEXTURE_HANDLE_INVALID;
+}
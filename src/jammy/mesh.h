@@ -0,0 +1,64 @@
+#pragma once
+
+#include <jammy/render_types.h>
+#include <jammy/texture.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#define JM_MESH_HANDLE_INVALID ((jm_mesh_handle)-1)
+
+typedef uint32_t jm_mesh_handle;
+
+// Geometry that is uploaded once and drawn by reference, see
+// jm_render_command_draw_mesh.
+typedef struct jm_mesh_desc
+{
+	const jm_vertex* vertices;
+	const jm_texcoord* texcoords; // relative to the texture, optional
+	const void* indices; // uint32_t when isIndex32 is set, uint16_t otherwise, optional
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	jm_texture_handle textureHandle;
+	uint8_t topology;
+	bool isIndex32;
+} jm_mesh_desc;
+
+int jm_meshes_init();
+
+// Copies the geometry and creates its static buffers. Handles of destroyed 
+// meshes are reused.
+jm_mesh_handle jm_create_mesh(
+	const jm_mesh_desc* desc);
+
+// Queues the mesh to be released. Commands recorded before may still draw it, 
+// so it stays valid until the second jm_meshes_collect from now.
+void jm_destroy_mesh(
+	jm_mesh_handle meshHandle);
+
+// Releases the meshes destroyed before the previous call. Called once per 
+// submitted frame, when every command buffer submitted before the previous 
+// call has been executed.
+void jm_meshes_collect();
+
+// One past the highest handle handed out so far.
+uint32_t jm_meshes_get_count();
+
+// Whether the handle refers to a mesh that hasn't been released.
+bool jm_mesh_is_alive(
+	jm_mesh_handle meshHandle);
+
+// Counts the meshes the handle has referred to, so draws of a reused handle 
+// can be told apart.
+uint32_t jm_mesh_get_generation(
+	jm_mesh_handle meshHandle);
+
+// The mesh's copy of its geometry, kept for captures and the software renderer.
+const jm_mesh_desc* jm_mesh_get_desc(
+	jm_mesh_handle meshHandle);
+
+jm_mesh_resource jm_mesh_get_resource(
+	jm_mesh_handle meshHandle);
+
+bool jm_mesh_is_textured(
+	jm_mesh_handle meshHandle);
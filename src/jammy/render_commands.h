@@ -1,12 +1,15 @@
 #pragma once
 
 #include <jammy/texture.h>
+#include <jammy/mesh.h>
 #include <jammy/font.h>
 #include <jammy/effect.h>
 #include <jammy/renderer.h>
+#include <jammy/color.h>
 
 #include <float.h>
 #include <memory.h>
+#include <stdbool.h>
 
 #if defined(_MSC_VER)
 #define __always_inline __forceinline
@@ -17,20 +20,176 @@
 	void __##CommandName(jm_draw_context*, const struct CommandName*); \
 	struct CommandName
 
+#define JM_DRAW_BATCH_MAX_COMMANDS 1024
+
+// Draw commands with compatible state that are adjacent after sorting are 
+// collected here and submitted as a single draw when the state changes.
+typedef struct jm_draw_batch
+{
+	const struct jm_render_command_draw* commands[JM_DRAW_BATCH_MAX_COMMANDS];
+	uint32_t commandCount;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// ranges of the positions and texcoords of the batched commands, gathered 
+	// as they're added, which pick the vertex format when the batch is flushed
+	float minPosition[2];
+	float maxPosition[2];
+	float minTexcoord[2];
+	float maxTexcoord[2];
+	bool hasFractionalPosition;
+} jm_draw_batch;
+
+#define JM_TEXT_BATCH_MAX_COMMANDS 256
+
+// Text commands that are adjacent after sorting and can share a draw, 
+// collected like draw commands and written to the dynamic buffers in one go 
+// when the batch is submitted.
+typedef struct jm_text_batch
+{
+	const struct jm_render_command_draw_text* commands[JM_TEXT_BATCH_MAX_COMMANDS];
+	uint32_t commandCount;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+} jm_text_batch;
+
 typedef struct jm_draw_context
 {
 	void* platformContext;
 
 	uint32_t vertexBufferOffset;
 	uint32_t indexBufferOffset;
+
+	// this frame's region of the dynamic buffers, for backends that write to 
+	// them through a persistent pointer
+	uint8_t* vertexData;
+	uint8_t* indexData;
+	uint32_t vertexBufferBase;
+	uint32_t indexBufferBase;
+	uint32_t vertexBufferCapacity;
+	uint32_t indexBufferCapacity;
+
+	jm_draw_batch batch;
+	jm_text_batch textBatch;
 } jm_draw_context;
 
 typedef void(*jm_render_command_dispatcher)(jm_draw_context*, const void*);
 
+// Sort keys are 64-bit and ordered so that a plain ascending sort gives the 
+// execution order:
+//
+// opaque:      [60..63] pass | [59] 0 | [56..58] shader program | [32..55] texture | [0..21] depth
+// translucent: [60..63] pass | [59] 1 | [32..53] inverted depth | [28..30] shader program | [0..23] texture
+//
+// The pass is set by the command buffer. Commands drawn into render targets 
+// are in the passes before JM_RENDER_PASS_FRAMEBUFFER, in the order the 
+// targets were begun, so they are done before the frame samples them.
+//
+// Within a pass, opaque commands are grouped by state and drawn front-to-back, 
+// translucent commands are drawn back-to-front after all opaque commands. The 
+// depth is made up of the render layer and the submission order within the frame. 
+// Higher layers are drawn in front of lower layers, and within a layer, earlier 
+// commands are drawn in front of later ones. The depth is written to clip-space 
+// z so the depth test resolves overlap independently of the execution order.
+#define JM_RENDER_LAYER_COUNT 16
+#define JM_SORT_KEY_SEQUENCE_BITS 18
+#define JM_SORT_KEY_DEPTH_BITS 22
+#define JM_SORT_KEY_DEPTH_MASK ((1u << JM_SORT_KEY_DEPTH_BITS) - 1)
+#define JM_SORT_KEY_PROGRAM_MASK 0x7u
+#define JM_SORT_KEY_TEXTURE_MASK 0xffffffu
+#define JM_SORT_KEY_PASS_SHIFT 60
+#define JM_SORT_KEY_PASS_MASK (0xfull << JM_SORT_KEY_PASS_SHIFT)
+#define JM_RENDER_PASS_COUNT 16
+#define JM_RENDER_PASS_FRAMEBUFFER (JM_RENDER_PASS_COUNT - 1)
+// keys of the commands that begin and end a render target's pass
+#define JM_SORT_KEY_PASS_BEGIN 0ull
+#define JM_SORT_KEY_PASS_END (~JM_SORT_KEY_PASS_MASK)
+
+__always_inline uint32_t jm_sort_key_depth(
+	uint32_t layer,
+	uint32_t sequence)
+{
+	const uint32_t maxSequence = (1u << JM_SORT_KEY_SEQUENCE_BITS) - 1;
+	if (layer >= JM_RENDER_LAYER_COUNT)
+	{
+		layer = JM_RENDER_LAYER_COUNT - 1;
+	}
+	if (sequence > maxSequence)
+	{
+		sequence = maxSequence;
+	}
+	return ((JM_RENDER_LAYER_COUNT - 1 - layer) << JM_SORT_KEY_SEQUENCE_BITS) | sequence;
+}
+
+__always_inline float jm_sort_key_depth_to_clip_z(
+	uint32_t depth)
+{
+	// maps to (0, 1), which is inside the clip volume of both GL and D3D, and 
+	// keeps consecutive depths apart in a 24-bit depth buffer
+	return (float)(depth + 1) / (float)((1u << JM_SORT_KEY_DEPTH_BITS) + 1);
+}
+
+__always_inline uint64_t jm_make_sort_key(
+	bool isTranslucent,
+	jm_shader_program shaderProgram,
+	uint32_t textureId,
+	uint32_t depth)
+{
+	const uint64_t program = (uint64_t)(shaderProgram & JM_SORT_KEY_PROGRAM_MASK);
+	const uint64_t texture = (uint64_t)(textureId & JM_SORT_KEY_TEXTURE_MASK);
+	depth &= JM_SORT_KEY_DEPTH_MASK;
+
+	if (isTranslucent)
+	{
+		const uint64_t invDepth = (uint64_t)(JM_SORT_KEY_DEPTH_MASK - depth);
+		return (1ull << 59) | (invDepth << 32) | (program << 28) | texture;
+	}
+
+	return (program << 56) | (texture << 32) | (uint64_t)depth;
+}
+
 void jm_draw_context_begin(
 	jm_draw_context* ctx,
 	void* platformContext);
 
+// Commands reference their transform by index into a palette that is 
+// recorded with the command buffer and uploaded once per frame. Entry 0 is 
+// always the identity. Shaders declare the palette with the same size.
+#define JM_TRANSFORM_PALETTE_SIZE 256
+#define JM_TRANSFORM_INDEX_IDENTITY 0
+#define JM_TRANSFORM_INDEX_INVALID UINT16_MAX
+
+// Uploads the frame's transform palette. Called by jm_command_buffer_execute 
+// before the first command.
+void jm_draw_context_set_transforms(
+	jm_draw_context* ctx,
+	const float (*transforms)[16],
+	uint32_t transformCount);
+
+// Commands reference their view, see jm_view, by index into a second palette 
+// that is recorded and uploaded like the transforms, so moving the camera 
+// doesn't touch the transforms or the vertices. Entry 0 is the identity over 
+// the whole target. Shaders declare the palette with the same size.
+#define JM_VIEW_PALETTE_SIZE 16
+#define JM_VIEW_INDEX_DEFAULT 0
+#define JM_VIEW_INDEX_INVALID UINT8_MAX
+
+// Uploads the frame's view palette. Called by jm_command_buffer_execute 
+// before the first command.
+void jm_draw_context_set_views(
+	jm_draw_context* ctx,
+	const jm_view* views,
+	uint32_t viewCount);
+
+// Submits any pending batched draws. Called by commands that can't be 
+// batched.
+void jm_draw_context_flush(
+	jm_draw_context* ctx);
+
+// Submits any pending work and retires the frame's dynamic buffer memory. 
+// Called by jm_command_buffer_execute after the last command.
+void jm_draw_context_end(
+	jm_draw_context* ctx);
+
 JM_DECLARE_RENDER_COMMAND(jm_render_command_draw_text)
 {
 	char* text;
@@ -42,6 +201,9 @@ JM_DECLARE_RENDER_COMMAND(jm_render_command_draw_text)
 	float lineSpacingMultiplier;
 	uint32_t rangeStart;
 	uint32_t rangeEnd;
+	// positions are in the clip space of the view's viewport
+	uint8_t viewIndex;
+	float depth; // clip-space z
 };
 
 __always_inline void jm_render_command_draw_text_init(
@@ -57,21 +219,28 @@ __always_inline void jm_render_command_draw_text_init(
 	cmd->lineSpacingMultiplier = 1.0f;
 	cmd->rangeStart = 0;
 	cmd->rangeEnd = UINT32_MAX;
+	cmd->viewIndex = JM_VIEW_INDEX_DEFAULT;
+	cmd->depth = 0.0f;
 }
 
 JM_DECLARE_RENDER_COMMAND(jm_render_command_draw)
 {
 	jm_vertex* vertices;
 	jm_texcoord* texcoords;
-	void* indices;
-	uint16_t vertexCount;
-	uint16_t indexCount;
+	jm_color32* colors; // per vertex, modulated by color
+	void* indices; // uint32_t when isIndex32 is set, uint16_t otherwise
+	uint32_t vertexCount;
+	uint32_t indexCount;
 	jm_texture_handle textureHandle;
 	uint32_t color;
 	uint8_t topology : 3;
 	uint8_t fillMode : 1;
 	uint8_t samplerState : 4;
-	float transform[16];
+	uint8_t hasSemitransparentColors : 1;
+	uint8_t isIndex32 : 1;
+	uint16_t transformIndex;
+	uint8_t viewIndex;
+	float depth; // clip-space z
 };
 
 __always_inline void jm_render_command_draw_init(
@@ -80,16 +249,213 @@ __always_inline void jm_render_command_draw_init(
 	cmd->vertexCount = 0;
 	cmd->vertices = NULL;
 	cmd->texcoords = NULL;
+	cmd->colors = NULL;
+	cmd->hasSemitransparentColors = 0;
 	cmd->indexCount = 0;
 	cmd->indices = NULL;
+	cmd->isIndex32 = 0;
 	cmd->topology = JM_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	cmd->fillMode = JM_FILL_MODE_SOLID;
 	cmd->textureHandle = JM_TEXTURE_HANDLE_INVALID;
 	cmd->color = 0xffffffff;
 	cmd->samplerState = JM_SAMPLER_STATE_POINT;
-	memset(cmd->transform, 0, sizeof(cmd->transform));
-	cmd->transform[0] = 1.0f;
-	cmd->transform[5] = 1.0f;
-	cmd->transform[10] = 1.0f;
-	cmd->transform[15] = 1.0f;
-}
\ No newline at end of file
+	cmd->transformIndex = JM_TRANSFORM_INDEX_IDENTITY;
+	cmd->viewIndex = JM_VIEW_INDEX_DEFAULT;
+	cmd->depth = 0.0f;
+}
+
+// Draws with more vertices than this need 32-bit indices. 0xffff itself is 
+// kept free as the 16-bit primitive restart index.
+#define JM_DRAW_MAX_VERTICES_INDEX16 UINT16_MAX
+
+__always_inline bool jm_render_command_draw_needs_index32(
+	uint32_t vertexCount)
+{
+	return vertexCount > JM_DRAW_MAX_VERTICES_INDEX16;
+}
+
+// Non-indexed draws with more vertices than JM_DRAW_MAX_VERTICES_INDEX16 are 
+// split into parts that each fit 16-bit indices. Returns the number of 
+// vertices in each part and, for strips, how many vertices consecutive parts 
+// share so no primitive is lost at the seams.
+__always_inline uint32_t jm_render_command_draw_split_size(
+	uint8_t topology,
+	uint32_t* outOverlap)
+{
+	switch (topology)
+	{
+	case JM_PRIMITIVE_TOPOLOGY_LINELIST:
+		*outOverlap = 0;
+		return JM_DRAW_MAX_VERTICES_INDEX16 - JM_DRAW_MAX_VERTICES_INDEX16 % 2;
+	case JM_PRIMITIVE_TOPOLOGY_LINESTRIP:
+		*outOverlap = 1;
+		return JM_DRAW_MAX_VERTICES_INDEX16;
+	case JM_PRIMITIVE_TOPOLOGY_TRIANGLELIST:
+		*outOverlap = 0;
+		return JM_DRAW_MAX_VERTICES_INDEX16 - JM_DRAW_MAX_VERTICES_INDEX16 % 3;
+	default:
+		// an even part size keeps the winding of the following parts
+		*outOverlap = 2;
+		return JM_DRAW_MAX_VERTICES_INDEX16 - JM_DRAW_MAX_VERTICES_INDEX16 % 2;
+	}
+}
+
+__always_inline bool jm_render_command_draw_is_textured(
+	const jm_render_command_draw* cmd)
+{
+	return cmd->texcoords != NULL && cmd->textureHandle != JM_TEXTURE_HANDLE_INVALID;
+}
+
+__always_inline bool jm_render_command_draw_is_translucent(
+	const jm_render_command_draw* cmd)
+{
+	const uint8_t alpha = (cmd->color >> 24);
+	if (alpha > 0x00 && alpha < 0xff)
+	{
+		// color is semitransparent
+		return true;
+	}
+	if (cmd->colors != NULL && cmd->hasSemitransparentColors)
+	{
+		// some vertex color is semitransparent
+		return true;
+	}
+	if (jm_render_command_draw_is_textured(cmd) && jm_texture_isSemitransparent(cmd->textureHandle))
+	{
+		// texture has semitransparent pixels
+		return true;
+	}
+	return false;
+}
+
+__always_inline uint64_t jm_render_command_draw_sort_key(
+	const jm_render_command_draw* cmd,
+	uint32_t depth)
+{
+	const bool isTextured = jm_render_command_draw_is_textured(cmd);
+	// vertex color variants share the key of their program so they sort together
+	const jm_shader_program shaderProgram = isTextured ? JM_SHADER_PROGRAM_TEXTURE : JM_SHADER_PROGRAM_COLOR;
+	// textures packed into the same atlas page sort together
+	const uint32_t textureId = isTextured ? jm_texture_get_batch_id(cmd->textureHandle) : 0;
+	return jm_make_sort_key(jm_render_command_draw_is_translucent(cmd), shaderProgram, textureId, depth);
+}
+
+__always_inline uint64_t jm_render_command_draw_text_sort_key(
+	const jm_render_command_draw_text* cmd,
+	uint32_t depth)
+{
+	return jm_make_sort_key(true, JM_SHADER_PROGRAM_TEXT, cmd->fontHandle, depth);
+}
+
+// One instance of a textured quad, in the layout the GPU reads it in. The 
+// quad covers [x, x + width] and [y, y + height] and is rotated by rotation 
+// radians around its center. Texcoords are unorm16.
+typedef struct jm_sprite
+{
+	float x, y;
+	float width, height;
+	uint16_t u0, v0, u1, v1;
+	jm_color32 color;
+	float rotation;
+} jm_sprite;
+
+__always_inline uint16_t jm_sprite_pack_texcoord(
+	float value)
+{
+	if (value <= 0.0f) return 0;
+	if (value >= 1.0f) return UINT16_MAX;
+	return (uint16_t)(value * UINT16_MAX + 0.5f);
+}
+
+// Draws all sprites with one instanced draw of a unit quad.
+JM_DECLARE_RENDER_COMMAND(jm_render_command_draw_sprites)
+{
+	const jm_sprite* sprites;
+	uint32_t spriteCount;
+	jm_texture_handle textureHandle;
+	uint8_t samplerState;
+	uint8_t hasSemitransparentColors;
+	uint16_t transformIndex;
+	uint8_t viewIndex;
+	float depth; // clip-space z
+};
+
+__always_inline void jm_render_command_draw_sprites_init(
+	jm_render_command_draw_sprites* cmd)
+{
+	cmd->sprites = NULL;
+	cmd->spriteCount = 0;
+	cmd->textureHandle = JM_TEXTURE_HANDLE_INVALID;
+	cmd->samplerState = JM_SAMPLER_STATE_POINT;
+	cmd->hasSemitransparentColors = 0;
+	cmd->transformIndex = JM_TRANSFORM_INDEX_IDENTITY;
+	cmd->viewIndex = JM_VIEW_INDEX_DEFAULT;
+	cmd->depth = 0.0f;
+}
+
+__always_inline uint64_t jm_render_command_draw_sprites_sort_key(
+	const jm_render_command_draw_sprites* cmd,
+	uint32_t depth)
+{
+	const bool isTranslucent = cmd->hasSemitransparentColors || jm_texture_isSemitransparent(cmd->textureHandle);
+	return jm_make_sort_key(isTranslucent, JM_SHADER_PROGRAM_SPRITE, jm_texture_get_batch_id(cmd->textureHandle), depth);
+}
+
+// Draws a mesh from its static buffers, modulated by color.
+JM_DECLARE_RENDER_COMMAND(jm_render_command_draw_mesh)
+{
+	jm_mesh_handle meshHandle;
+	uint32_t color;
+	uint8_t samplerState;
+	uint16_t transformIndex;
+	uint8_t viewIndex;
+	float depth; // clip-space z
+};
+
+__always_inline void jm_render_command_draw_mesh_init(
+	jm_render_command_draw_mesh* cmd)
+{
+	cmd->meshHandle = JM_MESH_HANDLE_INVALID;
+	cmd->color = 0xffffffff;
+	cmd->samplerState = JM_SAMPLER_STATE_POINT;
+	cmd->transformIndex = JM_TRANSFORM_INDEX_IDENTITY;
+	cmd->viewIndex = JM_VIEW_INDEX_DEFAULT;
+	cmd->depth = 0.0f;
+}
+
+__always_inline bool jm_render_command_draw_mesh_is_translucent(
+	const jm_render_command_draw_mesh* cmd)
+{
+	const uint8_t alpha = (cmd->color >> 24);
+	if (alpha > 0x00 && alpha < 0xff)
+	{
+		return true;
+	}
+	return jm_mesh_is_textured(cmd->meshHandle) && 
+		jm_texture_isSemitransparent(jm_mesh_get_desc(cmd->meshHandle)->textureHandle);
+}
+
+__always_inline uint64_t jm_render_command_draw_mesh_sort_key(
+	const jm_render_command_draw_mesh* cmd,
+	uint32_t depth)
+{
+	// meshes are drawn with the programs of draw commands and sort with them
+	const bool isTextured = jm_mesh_is_textured(cmd->meshHandle);
+	const jm_shader_program shaderProgram = isTextured ? JM_SHADER_PROGRAM_TEXTURE : JM_SHADER_PROGRAM_COLOR;
+	const uint32_t textureId = isTextured ? jm_texture_get_batch_id(jm_mesh_get_desc(cmd->meshHandle)->textureHandle) : 0;
+	return jm_make_sort_key(jm_render_command_draw_mesh_is_translucent(cmd), shaderProgram, textureId, depth);
+}
+
+// Directs the commands of the current pass into a render target, which is 
+// cleared to clearColor first. The command is the first of its pass.
+JM_DECLARE_RENDER_COMMAND(jm_render_command_begin_render_target)
+{
+	jm_texture_handle textureHandle;
+	uint32_t clearColor;
+};
+
+// Directs drawing back to the framebuffer. The command is the last of its pass.
+JM_DECLARE_RENDER_COMMAND(jm_render_command_end_render_target)
+{
+	jm_texture_handle textureHandle;
+};
@@ -1,12 +1,14 @@
-#if defined(JM_WINDOWS)
+#if defined(JM_WINDOWS) && !defined(JM_RENDERER_NULL) && !defined(JM_RENDERER_SOFTWARE)
 #include "render_commands.h"
 
 #include <jammy/renderer.h>
 #include <jammy/assert.h>
 #include <jammy/color.h>
+#include <jammy/math.h>
 #include <jammy/remotery/Remotery.h>
 
 #include <stdbool.h>
+#include <math.h>
 
 static const D3D11_PRIMITIVE_TOPOLOGY d3dPrimitiveTopology[] = 
 {
@@ -16,21 +18,118 @@ static const D3D11_PRIMITIVE_TOPOLOGY d3dPrimitiveTopology[] =
 	D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP,
 };
 
+// the frame's views and the viewport of the bound target they're placed in
+static const jm_view* g_views;
+static D3D11_VIEWPORT g_targetViewport;
+static uint32_t g_viewportViewIndex;
+
+static void jm_set_target_viewport(
+	ID3D11DeviceContext* d3dctx,
+	const D3D11_VIEWPORT* viewport)
+{
+	g_targetViewport = *viewport;
+	d3dctx->lpVtbl->RSSetViewports(d3dctx, 1, viewport);
+	g_viewportViewIndex = JM_VIEW_INDEX_DEFAULT;
+}
+
+// Sets the viewport to the view's part of the target, in whole pixels like 
+// the software renderer.
+static void jm_set_viewport(
+	ID3D11DeviceContext* d3dctx,
+	uint8_t viewIndex)
+{
+	if (viewIndex == g_viewportViewIndex)
+	{
+		return;
+	}
+	g_viewportViewIndex = viewIndex;
+
+	const float* view = g_views[viewIndex].viewport;
+	const float width = g_targetViewport.Width;
+	const float height = g_targetViewport.Height;
+	const float left = roundf(jm_clamp(view[0], 0.0f, 1.0f) * width);
+	const float top = roundf(jm_clamp(view[1], 0.0f, 1.0f) * height);
+	const float right = roundf(jm_clamp(view[0] + view[2], 0.0f, 1.0f) * width);
+	const float bottom = roundf(jm_clamp(view[1] + view[3], 0.0f, 1.0f) * height);
+
+	D3D11_VIEWPORT viewport = g_targetViewport;
+	viewport.TopLeftX += left;
+	viewport.TopLeftY += top;
+	viewport.Width = right - left;
+	viewport.Height = bottom - top;
+	d3dctx->lpVtbl->RSSetViewports(d3dctx, 1, &viewport);
+}
+
+static bool jm_text_batch_can_merge(
+	const jm_text_batch* batch,
+	const jm_render_command_draw_text* cmd,
+	uint32_t vertexCount)
+{
+	if (batch->commandCount == 0)
+	{
+		return true;
+	}
+	if (batch->commandCount == JM_TEXT_BATCH_MAX_COMMANDS)
+	{
+		return false;
+	}
+
+	// the batch is drawn with 16-bit indices
+	if (batch->vertexCount + vertexCount > JM_DRAW_MAX_VERTICES_INDEX16)
+	{
+		return false;
+	}
+
+	// the color is a shader constant, so it has to match along with the font 
+	// atlas and the viewport, depths are written per vertex
+	const jm_render_command_draw_text* first = batch->commands[0];
+	return cmd->color == first->color &&
+		cmd->viewIndex == first->viewIndex &&
+		jm_font_get_info(cmd->fontHandle)->texture == jm_font_get_info(first->fontHandle)->texture;
+}
+
 void __jm_render_command_draw_text(
 	jm_draw_context* ctx,
 	const jm_render_command_draw_text* cmd)
 {
-	rmt_BeginCPUSample(__jm_render_command_draw_text, 0);
-
 	jm_assert(cmd->fontHandle != JM_FONT_HANDLE_INVALID);
 	jm_assert(cmd->text);
 
-	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	const uint32_t textLength = (uint32_t)strlen(cmd->text);
+	if (textLength == 0)
+	{
+		return;
+	}
 
-	const size_t textLength = strlen(cmd->text);
+	jm_text_batch* batch = &ctx->textBatch;
+	const uint32_t vertexCount = textLength * 4;
+	if (!jm_text_batch_can_merge(batch, cmd, vertexCount))
+	{
+		jm_draw_context_flush(ctx);
+	}
+
+	// each glyph is a strip of 4 vertices followed by a restart index
+	batch->commands[batch->commandCount++] = cmd;
+	batch->vertexCount += vertexCount;
+	batch->indexCount += textLength * 5;
+}
 
-	// fill buffers
-	const uint32_t vertexCount = (uint32_t)textLength * 4;
+static void jm_draw_context_flush_text(
+	jm_draw_context* ctx)
+{
+	jm_text_batch* batch = &ctx->textBatch;
+	if (batch->commandCount == 0)
+	{
+		return;
+	}
+
+	rmt_BeginCPUSample(jm_draw_context_flush_text, 0);
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	const jm_render_command_draw_text* first = batch->commands[0];
+
+	// fill buffers, positions of the whole batch first, then texcoords and depths
+	const uint32_t vertexCount = batch->vertexCount;
 	uint32_t vertexDataSize = 0;
 	// pos
 	uint32_t positionOffset = vertexDataSize;
@@ -38,12 +137,14 @@ void __jm_render_command_draw_text(
 	// uv
 	uint32_t texcoordOffset = vertexDataSize;
 	vertexDataSize += sizeof(jm_texcoord) * vertexCount;
+	// depth
+	uint32_t depthOffset = vertexDataSize;
+	vertexDataSize += sizeof(float) * vertexCount;
 
 	const uint32_t vertexBufferOffset = ctx->vertexBufferOffset;
 	ctx->vertexBufferOffset += vertexDataSize;
 
-	const uint32_t optimisticIndexCount = (uint32_t)textLength * 5;
-	const uint32_t indexDataSize = optimisticIndexCount * sizeof(uint16_t);
+	const uint32_t indexDataSize = batch->indexCount * sizeof(uint16_t);
 	const uint32_t indexBufferOffset = ctx->indexBufferOffset;
 	ctx->indexBufferOffset += indexDataSize;
 
@@ -61,22 +162,51 @@ void __jm_render_command_draw_text(
 
 	jm_vertex* dstPosition = (jm_vertex*)((uint8_t*)vertexBufferData.pData + vertexBufferOffset + positionOffset);
 	jm_texcoord* dstTexcoord = (jm_texcoord*)((uint8_t*)vertexBufferData.pData + vertexBufferOffset + texcoordOffset);
+	float* dstDepth = (float*)((uint8_t*)vertexBufferData.pData + vertexBufferOffset + depthOffset);
 	uint16_t* dstIndices = (uint16_t*)((uint8_t*)indexBufferData.pData + indexBufferOffset);
 
-	uint32_t indexCount;
-	jm_font_get_text_vertices(
-		cmd->fontHandle,
-		cmd->text,
-		cmd->x,
-		cmd->y,
-		cmd->width,
-		cmd->rangeStart,
-		cmd->rangeEnd,
-		cmd->scale,
-		(float*)dstPosition,
-		(float*)dstTexcoord,
-		(uint16_t*)dstIndices,
-		&indexCount);
+	uint16_t* dstIndex = dstIndices;
+	uint32_t batchVertex = 0;
+	for (uint32_t i = 0; i < batch->commandCount; ++i)
+	{
+		const jm_render_command_draw_text* cmd = batch->commands[i];
+
+		uint32_t indexCount;
+		jm_font_get_text_vertices(
+			cmd->fontHandle,
+			cmd->text,
+			cmd->x,
+			cmd->y,
+			cmd->width,
+			cmd->rangeStart,
+			cmd->rangeEnd,
+			cmd->scale,
+			cmd->lineSpacingMultiplier,
+			(float*)(dstPosition + batchVertex),
+			(float*)(dstTexcoord + batchVertex),
+			sizeof(jm_vertex),
+			dstIndex,
+			&indexCount);
+
+		// glyph indices start at 0 for every text
+		for (uint32_t j = 0; j < indexCount; ++j)
+		{
+			if (dstIndex[j] != UINT16_MAX)
+			{
+				dstIndex[j] += (uint16_t)batchVertex;
+			}
+		}
+
+		const uint32_t textVertexCount = (uint32_t)strlen(cmd->text) * 4;
+		for (uint32_t j = 0; j < textVertexCount; ++j)
+		{
+			dstDepth[batchVertex + j] = cmd->depth;
+		}
+
+		dstIndex += indexCount;
+		batchVertex += textVertexCount;
+	}
+	const uint32_t indexCount = (uint32_t)(dstIndex - dstIndices);
 
 	d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)dynamicVertexBuffer, 0);
 	d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)indexBuffer, 0);
@@ -92,7 +222,7 @@ void __jm_render_command_draw_text(
 	d3dctx->lpVtbl->OMSetBlendState(d3dctx, d3dBlendState, blendFactor, 0xff);
 
 	ID3D11Buffer* const vscb[] = {
-		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS)
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_FRAME_VS)
 	};
 	ID3D11Buffer* const pscb[] = {
 		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_PS)
@@ -107,12 +237,13 @@ void __jm_render_command_draw_text(
 			float r, g, b, a;
 		} constants;
 		constants* cb = (constants*)ms.pData;
-		jm_unpack_color32_rgba_f32(cmd->color, &cb->r, &cb->g, &cb->b, &cb->a);
+		jm_unpack_color32_rgba_f32(first->color, &cb->r, &cb->g, &cb->b, &cb->a);
 
 		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)pscb[0], 0);
 	}
 
 	// bind constant buffers
+	jm_set_viewport(d3dctx, first->viewIndex);
 	d3dctx->lpVtbl->VSSetConstantBuffers(d3dctx, 0, _countof(vscb), vscb);
 	d3dctx->lpVtbl->PSSetConstantBuffers(d3dctx, 0, _countof(pscb), pscb);
 
@@ -120,21 +251,24 @@ void __jm_render_command_draw_text(
 	ID3D11Buffer* const vertexBuffers[] = {
 		dynamicVertexBuffer,
 		dynamicVertexBuffer,
+		dynamicVertexBuffer,
 	};
 	const uint32_t strides[] = {
 		sizeof(jm_vertex), // pos
 		sizeof(jm_texcoord), // uv
+		sizeof(float), // depth
 	};
 	const uint32_t offsets[] = {
 		vertexBufferOffset + positionOffset, // pos
 		vertexBufferOffset + texcoordOffset, // uv
+		vertexBufferOffset + depthOffset, // depth
 	};
 
 	d3dctx->lpVtbl->IASetVertexBuffers(d3dctx, 0, _countof(vertexBuffers), vertexBuffers, strides, offsets);
 	d3dctx->lpVtbl->IASetPrimitiveTopology(d3dctx, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
 	// bind texture
-	ID3D11ShaderResourceView* srv[] = { jm_font_get_info(cmd->fontHandle)->texture };
+	ID3D11ShaderResourceView* srv[] = { jm_font_get_info(first->fontHandle)->texture };
 	d3dctx->lpVtbl->PSSetShaderResources(d3dctx, 0, _countof(srv), srv);
 	// bind sampler
 	ID3D11SamplerState* samplers[] = { jm_renderer_get_sampler(JM_SAMPLER_STATE_POINT) };
@@ -145,33 +279,75 @@ void __jm_render_command_draw_text(
 
 	d3dctx->lpVtbl->DrawIndexed(d3dctx, indexCount, 0, 0);
 
+	batch->commandCount = 0;
+	batch->vertexCount = 0;
+	batch->indexCount = 0;
+
 	rmt_EndCPUSample();
 }
 
+static void jm_set_instance_constants(
+	ID3D11DeviceContext* d3dctx,
+	ID3D11Buffer* constantBuffer,
+	uint16_t transformIndex,
+	uint8_t viewIndex,
+	float depth)
+{
+	jm_set_viewport(d3dctx, viewIndex);
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
+	{
+		typedef struct constants
+		{
+			uint32_t transformIndex;
+			float depth;
+			uint32_t viewIndex;
+		} constants;
+		constants* cb = (constants*)ms.pData;
+		cb->transformIndex = transformIndex;
+		cb->depth = depth;
+		cb->viewIndex = viewIndex;
+
+		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)constantBuffer, 0);
+	}
+}
+
+static void jm_set_color_constants(
+	ID3D11DeviceContext* d3dctx,
+	ID3D11Buffer* constantBuffer,
+	uint32_t color)
+{
+	D3D11_MAPPED_SUBRESOURCE ms;
+	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
+	{
+		typedef struct constants
+		{
+			float r, g, b, a;
+		} constants;
+		constants* cb = (constants*)ms.pData;
+		jm_unpack_color32_rgba_f32(color, &cb->r, &cb->g, &cb->b, &cb->a);
+
+		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)constantBuffer, 0);
+	}
+}
+
 void __jm_render_command_draw(
 	jm_draw_context* ctx,
 	const jm_render_command_draw* cmd)
 {
 	rmt_BeginCPUSample(__jm_render_command_draw, 0);
 
+	// submit the text batched so far
+	jm_draw_context_flush(ctx);
+
 	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
 
 	const bool isIndexed = cmd->indices != NULL;
 	const bool isTextured = cmd->textureHandle != JM_TEXTURE_HANDLE_INVALID;
-	const bool isVertexColor = false;//todo
+	const bool isVertexColor = cmd->colors != NULL;
 
-	bool isSemitransparent = false;
-	const uint8_t alpha = (cmd->color >> 24);
-	if (alpha > 0x00 && alpha < 0xff)
-	{
-		// color is semitransparent
-		isSemitransparent = true;
-	}
-	else if (isTextured && jm_texture_isSemitransparent(cmd->textureHandle))
-	{
-		// texture has semitransparent pixels
-		isSemitransparent = true;
-	}
+	const bool isSemitransparent = jm_render_command_draw_is_translucent(cmd);
 
 	D3D11_MAPPED_SUBRESOURCE ms;
 
@@ -206,16 +382,16 @@ void __jm_render_command_draw(
 		uint8_t* dstVertexColor = (uint8_t*)ms.pData + vertexBufferOffset + vertexColorOffset;
 
 		// copy position
-		memcpy(dstPosition, cmd->vertices, vertexDataSize);
+		memcpy(dstPosition, cmd->vertices, sizeof(jm_vertex) * cmd->vertexCount);
 		// copy texcoord
 		if (isTextured)
 		{
-			memcpy(dstTexcoord, cmd->texcoords, vertexDataSize);
+			memcpy(dstTexcoord, cmd->texcoords, sizeof(jm_texcoord) * cmd->vertexCount);
 		}
 		// copy color
 		if (isVertexColor)
 		{
-			memcpy(dstVertexColor, NULL, vertexDataSize);
+			memcpy(dstVertexColor, cmd->colors, sizeof(jm_color32) * cmd->vertexCount);
 		}
 		d3dctx->lpVtbl->Unmap(d3dctx, vertexBuffer, 0);
 	}
@@ -224,7 +400,11 @@ void __jm_render_command_draw(
 	jm_shader_program shaderProgram = JM_SHADER_PROGRAM_COLOR;
 	if (isTextured)
 	{
-		shaderProgram = JM_SHADER_PROGRAM_TEXTURE;
+		shaderProgram = isVertexColor ? JM_SHADER_PROGRAM_TEXTURE_VERTEX_COLOR : JM_SHADER_PROGRAM_TEXTURE;
+	}
+	else if (isVertexColor)
+	{
+		shaderProgram = JM_SHADER_PROGRAM_COLOR_VERTEX_COLOR;
 	}
 	jm_renderer_set_shader_program(shaderProgram);
 
@@ -240,24 +420,17 @@ void __jm_render_command_draw(
 	d3dctx->lpVtbl->OMSetBlendState(d3dctx, d3dBlendState, blendFactor, 0xff);
 
 	ID3D11Buffer* const vscb[] = {
-		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS)
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_FRAME_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS),
 	};
 	ID3D11Buffer* const pscb[] = {
 		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_PS)
 	};
 
 	// update constants
-	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)pscb[0], 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
-	{
-		typedef struct constants
-		{
-			float r, g, b, a;
-		} constants;
-		constants* cb = (constants*)ms.pData;
-		jm_unpack_color32_rgba_f32(cmd->color, &cb->r, &cb->g, &cb->b, &cb->a);
-
-		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)pscb[0], 0);
-	}
+	jm_set_instance_constants(d3dctx, vscb[1], cmd->transformIndex, cmd->viewIndex, cmd->depth);
+	jm_set_color_constants(d3dctx, pscb[0], cmd->color);
 
 	// bind constant buffers
 	d3dctx->lpVtbl->VSSetConstantBuffers(d3dctx, 0, _countof(vscb), vscb);
@@ -296,7 +469,8 @@ void __jm_render_command_draw(
 	if (isIndexed)
 	{
 		// fill index buffer
-		const uint32_t indexBufferSize = sizeof(uint16_t) * cmd->indexCount;
+		const uint32_t indexSize = cmd->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		const uint32_t indexBufferSize = indexSize * cmd->indexCount;
 		const uint32_t indexBufferOffset = ctx->indexBufferOffset;
 		ctx->indexBufferOffset += indexBufferSize;
 
@@ -307,7 +481,7 @@ void __jm_render_command_draw(
 			d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)indexBuffer, 0);
 		}
 
-		const DXGI_FORMAT indexFormat = DXGI_FORMAT_R16_UINT;
+		const DXGI_FORMAT indexFormat = cmd->isIndex32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 
 		d3dctx->lpVtbl->IASetIndexBuffer(d3dctx, indexBuffer, indexFormat, indexBufferOffset);
 		d3dctx->lpVtbl->DrawIndexed(d3dctx, cmd->indexCount, 0, 0);
@@ -320,6 +494,215 @@ void __jm_render_command_draw(
 	rmt_EndCPUSample();
 }
 
+void __jm_render_command_draw_sprites(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_sprites* cmd)
+{
+	rmt_BeginCPUSample(__jm_render_command_draw_sprites, 0);
+
+	if (cmd->spriteCount == 0)
+	{
+		rmt_EndCPUSample();
+		return;
+	}
+
+	jm_draw_context_flush(ctx);
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+
+	// the records are uploaded as they are, one instance each
+	const uint32_t instanceDataSize = sizeof(jm_sprite) * cmd->spriteCount;
+	const uint32_t instanceBufferOffset = ctx->vertexBufferOffset;
+	ctx->vertexBufferOffset += instanceDataSize;
+
+	ID3D11Buffer* dynamicVertexBuffer = jm_renderer_get_dynamic_vertex_buffer();
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	const D3D11_MAP mapType = (instanceBufferOffset == 0) ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)dynamicVertexBuffer, 0, mapType, 0, &ms)))
+	{
+		memcpy((uint8_t*)ms.pData + instanceBufferOffset, cmd->sprites, instanceDataSize);
+		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)dynamicVertexBuffer, 0);
+	}
+
+	// bind shaders
+	jm_renderer_set_shader_program(JM_SHADER_PROGRAM_SPRITE);
+
+	// set blend state
+	const bool isSemitransparent = cmd->hasSemitransparentColors || jm_texture_isSemitransparent(cmd->textureHandle);
+	ID3D11BlendState* d3dBlendState = jm_renderer_get_blend_state(isSemitransparent ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE);
+
+	const float blendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	d3dctx->lpVtbl->OMSetBlendState(d3dctx, d3dBlendState, blendFactor, 0xff);
+
+	// update constants
+	ID3D11Buffer* const vscb[] = {
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_FRAME_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS),
+	};
+	jm_set_instance_constants(d3dctx, vscb[1], cmd->transformIndex, cmd->viewIndex, cmd->depth);
+	d3dctx->lpVtbl->VSSetConstantBuffers(d3dctx, 0, _countof(vscb), vscb);
+
+	// setup input assembler
+	ID3D11Buffer* const vertexBuffers[] = {
+		jm_renderer_get_unit_quad_buffer(),
+		dynamicVertexBuffer,
+	};
+	const uint32_t strides[] = {
+		sizeof(float) * 2, // corner
+		sizeof(jm_sprite), // instance
+	};
+	const uint32_t offsets[] = {
+		0, // corner
+		instanceBufferOffset, // instance
+	};
+	d3dctx->lpVtbl->IASetVertexBuffers(d3dctx, 0, _countof(vertexBuffers), vertexBuffers, strides, offsets);
+	d3dctx->lpVtbl->IASetPrimitiveTopology(d3dctx, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	// bind texture
+	ID3D11ShaderResourceView* srv[] = { jm_texture_get_resource(cmd->textureHandle) };
+	d3dctx->lpVtbl->PSSetShaderResources(d3dctx, 0, _countof(srv), srv);
+	// bind sampler
+	ID3D11SamplerState* samplers[] = { jm_renderer_get_sampler(cmd->samplerState) };
+	d3dctx->lpVtbl->PSSetSamplers(d3dctx, 0, _countof(samplers), samplers);
+
+	d3dctx->lpVtbl->DrawInstanced(d3dctx, 4, cmd->spriteCount, 0, 0);
+
+	rmt_EndCPUSample();
+}
+
+void __jm_render_command_draw_mesh(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_mesh* cmd)
+{
+	jm_draw_context_flush(ctx);
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+
+	const jm_mesh_desc* mesh = jm_mesh_get_desc(cmd->meshHandle);
+	const jm_mesh_resource resource = jm_mesh_get_resource(cmd->meshHandle);
+	const bool isTextured = jm_mesh_is_textured(cmd->meshHandle);
+
+	jm_renderer_set_shader_program(isTextured ? JM_SHADER_PROGRAM_TEXTURE : JM_SHADER_PROGRAM_COLOR);
+
+	const jm_blend_state blendState = jm_render_command_draw_mesh_is_translucent(cmd) ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE;
+	const float blendFactor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	d3dctx->lpVtbl->OMSetBlendState(d3dctx, jm_renderer_get_blend_state(blendState), blendFactor, 0xff);
+
+	ID3D11Buffer* const vscb[] = {
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_FRAME_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_VS),
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS),
+	};
+	ID3D11Buffer* const pscb[] = {
+		jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_INSTANCE_PS)
+	};
+	jm_set_instance_constants(d3dctx, vscb[1], cmd->transformIndex, cmd->viewIndex, cmd->depth);
+	jm_set_color_constants(d3dctx, pscb[0], cmd->color);
+	d3dctx->lpVtbl->VSSetConstantBuffers(d3dctx, 0, _countof(vscb), vscb);
+	d3dctx->lpVtbl->PSSetConstantBuffers(d3dctx, 0, _countof(pscb), pscb);
+
+	// texcoords follow the positions in the same buffer
+	ID3D11Buffer* vertexBuffer = jm_renderer_get_mesh_vertex_buffer(resource);
+	ID3D11Buffer* const vertexBuffers[] = { 
+		vertexBuffer, 
+		vertexBuffer,
+	};
+	const uint32_t strides[] = { 
+		sizeof(jm_vertex), // pos
+		sizeof(jm_texcoord), // uv
+	};
+	const uint32_t offsets[] = { 
+		0, // pos
+		isTextured ? sizeof(jm_vertex) * mesh->vertexCount : 0, // uv
+	};
+	d3dctx->lpVtbl->IASetVertexBuffers(d3dctx, 0, _countof(vertexBuffers), vertexBuffers, strides, offsets);
+	d3dctx->lpVtbl->IASetPrimitiveTopology(d3dctx, d3dPrimitiveTopology[mesh->topology]);
+
+	if (isTextured)
+	{
+		ID3D11ShaderResourceView* srv[] = { jm_texture_get_resource(mesh->textureHandle) };
+		d3dctx->lpVtbl->PSSetShaderResources(d3dctx, 0, _countof(srv), srv);
+		ID3D11SamplerState* samplers[] = { jm_renderer_get_sampler(cmd->samplerState) };
+		d3dctx->lpVtbl->PSSetSamplers(d3dctx, 0, _countof(samplers), samplers);
+	}
+
+	if (mesh->indices != NULL)
+	{
+		const DXGI_FORMAT indexFormat = mesh->isIndex32 ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+		d3dctx->lpVtbl->IASetIndexBuffer(d3dctx, jm_renderer_get_mesh_index_buffer(resource), indexFormat, 0);
+		d3dctx->lpVtbl->DrawIndexed(d3dctx, mesh->indexCount, 0, 0);
+	}
+	else
+	{
+		d3dctx->lpVtbl->Draw(d3dctx, mesh->vertexCount, 0);
+	}
+}
+
+// framebuffer views and viewport, restored when a render target's pass ends
+static ID3D11RenderTargetView* g_framebufferRTV;
+static ID3D11DepthStencilView* g_framebufferDSV;
+static D3D11_VIEWPORT g_framebufferViewport;
+
+void __jm_render_command_begin_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_begin_render_target* cmd)
+{
+	jm_draw_context_flush(ctx);
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	const jm_render_target_resource renderTarget = jm_texture_get_render_target_resource(cmd->textureHandle);
+	ID3D11RenderTargetView* rtv = jm_renderer_get_render_target_view(renderTarget);
+	ID3D11DepthStencilView* dsv = jm_renderer_get_render_target_depth_view(renderTarget);
+
+	// adds references, which are released by the end command
+	d3dctx->lpVtbl->OMGetRenderTargets(d3dctx, 1, &g_framebufferRTV, &g_framebufferDSV);
+	g_framebufferViewport = g_targetViewport;
+
+	// the texture may still be bound from a draw of the previous pass
+	ID3D11ShaderResourceView* nullSRV[] = { NULL };
+	d3dctx->lpVtbl->PSSetShaderResources(d3dctx, 0, 1, nullSRV);
+	d3dctx->lpVtbl->OMSetRenderTargets(d3dctx, 1, &rtv, dsv);
+
+	const jm_texture_info* textureInfo = jm_texture_get_info(cmd->textureHandle);
+	D3D11_VIEWPORT viewport;
+	viewport.TopLeftX = 0.0f;
+	viewport.TopLeftY = 0.0f;
+	viewport.Width = (float)textureInfo->width;
+	viewport.Height = (float)textureInfo->height;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	jm_set_target_viewport(d3dctx, &viewport);
+
+	FLOAT clearColor[4];
+	jm_unpack_color32_rgba_f32(cmd->clearColor, &clearColor[0], &clearColor[1], &clearColor[2], &clearColor[3]);
+	d3dctx->lpVtbl->ClearRenderTargetView(d3dctx, rtv, clearColor);
+	d3dctx->lpVtbl->ClearDepthStencilView(d3dctx, dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
+}
+
+void __jm_render_command_end_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_end_render_target* cmd)
+{
+	jm_draw_context_flush(ctx);
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	d3dctx->lpVtbl->OMSetRenderTargets(d3dctx, 1, &g_framebufferRTV, g_framebufferDSV);
+	jm_set_target_viewport(d3dctx, &g_framebufferViewport);
+
+	if (g_framebufferRTV != NULL)
+	{
+		g_framebufferRTV->lpVtbl->Release(g_framebufferRTV);
+		g_framebufferRTV = NULL;
+	}
+	if (g_framebufferDSV != NULL)
+	{
+		g_framebufferDSV->lpVtbl->Release(g_framebufferDSV);
+		g_framebufferDSV = NULL;
+	}
+}
+
 void jm_draw_context_begin(
 	jm_draw_context* ctx, 
 	ID3D11DeviceContext* d3dctx)
@@ -327,5 +710,62 @@ void jm_draw_context_begin(
 	ctx->platformContext = d3dctx;
 	ctx->vertexBufferOffset = 0;
 	ctx->indexBufferOffset = 0;
+	ctx->batch.commandCount = 0;
+	ctx->textBatch.commandCount = 0;
+	ctx->textBatch.vertexCount = 0;
+	ctx->textBatch.indexCount = 0;
+
+	D3D11_VIEWPORT viewport;
+	UINT viewportCount = 1;
+	d3dctx->lpVtbl->RSGetViewports(d3dctx, &viewportCount, &viewport);
+	jm_set_target_viewport(d3dctx, &viewport);
+}
+
+void jm_draw_context_set_transforms(
+	jm_draw_context* ctx,
+	const float (*transforms)[16],
+	uint32_t transformCount)
+{
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	ID3D11Buffer* constantBuffer = jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_FRAME_VS);
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
+	{
+		memcpy(ms.pData, transforms, sizeof(float[16]) * transformCount);
+		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)constantBuffer, 0);
+	}
+}
+
+void jm_draw_context_set_views(
+	jm_draw_context* ctx,
+	const jm_view* views,
+	uint32_t viewCount)
+{
+	jm_assert(viewCount <= JM_VIEW_PALETTE_SIZE);
+	g_views = views;
+
+	ID3D11DeviceContext* d3dctx = (ID3D11DeviceContext*)ctx->platformContext;
+	ID3D11Buffer* constantBuffer = jm_renderer_get_constant_buffer(JM_CONSTANT_BUFFER_PER_VIEW_VS);
+
+	D3D11_MAPPED_SUBRESOURCE ms;
+	if (SUCCEEDED(d3dctx->lpVtbl->Map(d3dctx, (ID3D11Resource*)constantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &ms)))
+	{
+		memcpy(ms.pData, views, sizeof(jm_view) * viewCount);
+		d3dctx->lpVtbl->Unmap(d3dctx, (ID3D11Resource*)constantBuffer, 0);
+	}
+}
+
+void jm_draw_context_flush(
+	jm_draw_context* ctx)
+{
+	// other draws are submitted immediately
+	jm_draw_context_flush_text(ctx);
+}
+
+void jm_draw_context_end(
+	jm_draw_context* ctx)
+{
+	jm_draw_context_flush(ctx);
 }
 #endif
\ No newline at end of file
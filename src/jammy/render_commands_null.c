@@ -0,0 +1,114 @@
+#if defined(JM_RENDERER_NULL)
+#include "render_commands.h"
+
+#include <jammy/renderer.h>
+#include <jammy/assert.h>
+
+#include <string.h>
+
+// Commands are validated and counted like a real backend would consume 
+// them, so headless runs still exercise recording and sorting.
+
+void __jm_render_command_draw_text(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_text* cmd)
+{
+	jm_assert(cmd->fontHandle != JM_FONT_HANDLE_INVALID);
+	jm_assert(cmd->text);
+
+	const uint32_t length = (uint32_t)strlen(cmd->text);
+	const uint32_t rangeEnd = (cmd->rangeEnd < length) ? cmd->rangeEnd : length;
+
+	++g_nullRendererStats.commandCount;
+	g_nullRendererStats.characterCount += (rangeEnd > cmd->rangeStart) ? rangeEnd - cmd->rangeStart : 0;
+}
+
+void __jm_render_command_draw(
+	jm_draw_context* ctx,
+	const jm_render_command_draw* cmd)
+{
+	jm_assert(cmd->vertices != NULL || cmd->vertexCount == 0);
+
+	++g_nullRendererStats.commandCount;
+	g_nullRendererStats.vertexCount += cmd->vertexCount;
+	g_nullRendererStats.indexCount += (cmd->indices != NULL) ? cmd->indexCount : 0;
+}
+
+void __jm_render_command_draw_sprites(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_sprites* cmd)
+{
+	jm_assert(cmd->sprites != NULL || cmd->spriteCount == 0);
+
+	++g_nullRendererStats.commandCount;
+	g_nullRendererStats.spriteCount += cmd->spriteCount;
+}
+
+void __jm_render_command_draw_mesh(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_mesh* cmd)
+{
+	const jm_mesh_desc* mesh = jm_mesh_get_desc(cmd->meshHandle);
+
+	++g_nullRendererStats.commandCount;
+	g_nullRendererStats.vertexCount += mesh->vertexCount;
+	g_nullRendererStats.indexCount += mesh->indexCount;
+}
+
+void __jm_render_command_begin_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_begin_render_target* cmd)
+{
+	jm_assert(jm_texture_is_render_target(cmd->textureHandle));
+
+	++g_nullRendererStats.commandCount;
+}
+
+void __jm_render_command_end_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_end_render_target* cmd)
+{
+	jm_assert(jm_texture_is_render_target(cmd->textureHandle));
+
+	++g_nullRendererStats.commandCount;
+}
+
+void jm_draw_context_begin(
+	jm_draw_context* ctx,
+	void* platformContext)
+{
+	ctx->platformContext = platformContext;
+	ctx->vertexBufferOffset = 0;
+	ctx->indexBufferOffset = 0;
+	ctx->batch.commandCount = 0;
+	ctx->batch.vertexCount = 0;
+	ctx->batch.indexCount = 0;
+}
+
+void jm_draw_context_set_transforms(
+	jm_draw_context* ctx,
+	const float (*transforms)[16],
+	uint32_t transformCount)
+{
+	jm_assert(transformCount <= JM_TRANSFORM_PALETTE_SIZE);
+}
+
+void jm_draw_context_set_views(
+	jm_draw_context* ctx,
+	const jm_view* views,
+	uint32_t viewCount)
+{
+	jm_assert(viewCount <= JM_VIEW_PALETTE_SIZE);
+}
+
+void jm_draw_context_flush(
+	jm_draw_context* ctx)
+{
+}
+
+void jm_draw_context_end(
+	jm_draw_context* ctx)
+{
+	++g_nullRendererStats.frameCount;
+}
+#endif
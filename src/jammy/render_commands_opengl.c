@@ -1,9 +1,10 @@
-#if defined(JM_LINUX)
+#if defined(JM_LINUX) && !defined(JM_RENDERER_NULL) && !defined(JM_RENDERER_SOFTWARE)
 #include "render_commands.h"
 
 #include <jammy/renderer.h>
 #include <jammy/assert.h>
 #include <jammy/color.h>
+#include <jammy/math.h>
 
 #include <GL/glew.h>
 
@@ -11,6 +12,7 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdio.h>
+#include <math.h>
 
 static const GLenum glmode[] = 
 {
@@ -20,6 +22,129 @@ static const GLenum glmode[] =
     GL_TRIANGLE_STRIP,
 };
 
+static void* jm_draw_context_alloc(
+    uint8_t* data,
+    uint32_t base,
+    uint32_t capacity,
+    uint32_t* it,
+    uint32_t size,
+    uint32_t alignment,
+    uint32_t* outOffset)
+{
+    // the alignment applies to the offset in the buffer, not in the region
+    const uint32_t offset = ((base + *it + alignment - 1) / alignment) * alignment - base;
+    if (offset + size > capacity)
+    {
+        fprintf(stderr, "[ERROR] Out of dynamic buffer memory\n");
+        return NULL;
+    }
+
+    *it = offset + size;
+    *outOffset = base + offset;
+    return data + offset;
+}
+
+// Vertices are aligned to their stride so draws can address them by base vertex.
+static void* jm_draw_context_alloc_vertices(
+    jm_draw_context* ctx,
+    uint32_t vertexCount,
+    uint32_t stride,
+    uint32_t* outBaseVertex)
+{
+    uint32_t offset;
+    void* data = jm_draw_context_alloc(ctx->vertexData, ctx->vertexBufferBase, ctx->vertexBufferCapacity, &ctx->vertexBufferOffset, vertexCount * stride, stride, &offset);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+    *outBaseVertex = offset / stride;
+    return data;
+}
+
+static void* jm_draw_context_alloc_indices(
+    jm_draw_context* ctx,
+    uint32_t size,
+    uint32_t* outOffset)
+{
+    return jm_draw_context_alloc(ctx->indexData, ctx->indexBufferBase, ctx->indexBufferCapacity, &ctx->indexBufferOffset, size, 4, outOffset);
+}
+
+static void jm_draw_context_commit(
+    jm_draw_context* ctx)
+{
+    jm_renderer_commit_dynamic_buffers(ctx->vertexBufferOffset, ctx->indexBufferOffset);
+}
+
+// the frame's view palette, the viewport of the target that's drawn into and 
+// the view whose part of it is set
+static const jm_view* g_views;
+static GLint g_targetViewport[4];
+static uint32_t g_viewportViewIndex;
+
+static void jm_draw_context_set_target_viewport(
+    GLint x,
+    GLint y,
+    GLint width,
+    GLint height)
+{
+    g_targetViewport[0] = x;
+    g_targetViewport[1] = y;
+    g_targetViewport[2] = width;
+    g_targetViewport[3] = height;
+    glViewport(x, y, width, height);
+    g_viewportViewIndex = JM_VIEW_INDEX_DEFAULT;
+}
+
+// Sets the viewport to the view's part of the target, in whole pixels like 
+// the software renderer.
+static void jm_draw_context_set_viewport(
+    uint8_t viewIndex)
+{
+    if (viewIndex == g_viewportViewIndex)
+    {
+        return;
+    }
+    g_viewportViewIndex = viewIndex;
+
+    const float* viewport = g_views[viewIndex].viewport;
+    const float width = (float)g_targetViewport[2];
+    const float height = (float)g_targetViewport[3];
+    const GLint left = (GLint)roundf(jm_clamp(viewport[0], 0.0f, 1.0f) * width);
+    const GLint top = (GLint)roundf(jm_clamp(viewport[1], 0.0f, 1.0f) * height);
+    const GLint right = (GLint)roundf(jm_clamp(viewport[0] + viewport[2], 0.0f, 1.0f) * width);
+    const GLint bottom = (GLint)roundf(jm_clamp(viewport[1] + viewport[3], 0.0f, 1.0f) * height);
+
+    // views are placed from the top left, GL viewports from the bottom left
+    glViewport(g_targetViewport[0] + left, g_targetViewport[1] + g_targetViewport[3] - bottom, right - left, bottom - top);
+}
+
+static bool jm_text_batch_can_merge(
+    const jm_text_batch* batch,
+    const jm_render_command_draw_text* cmd,
+    uint32_t vertexCount)
+{
+    if (batch->commandCount == 0)
+    {
+        return true;
+    }
+    if (batch->commandCount == JM_TEXT_BATCH_MAX_COMMANDS)
+    {
+        return false;
+    }
+
+    // the batch is drawn with 16-bit indices
+    if (batch->vertexCount + vertexCount > JM_DRAW_MAX_VERTICES_INDEX16)
+    {
+        return false;
+    }
+
+    // colors and depths are written per vertex, so only the font atlas and 
+    // the viewport have to match
+    const jm_render_command_draw_text* first = batch->commands[0];
+    return cmd->viewIndex == first->viewIndex &&
+        jm_font_get_info(cmd->fontHandle)->texture == jm_font_get_info(first->fontHandle)->texture;
+}
+
 void __jm_render_command_draw_text(
 	jm_draw_context* ctx,
 	const jm_render_command_draw_text* cmd)
@@ -27,124 +152,543 @@ void __jm_render_command_draw_text(
     jm_assert(cmd->fontHandle != JM_FONT_HANDLE_INVALID);
 	jm_assert(cmd->text);
 
-	const size_t textLength = strlen(cmd->text);
+    const uint32_t textLength = (uint32_t)strlen(cmd->text);
+    if (textLength == 0)
+    {
+        return;
+    }
+
+    // text isn't batched with draw commands
+    jm_text_batch* batch = &ctx->textBatch;
+    const uint32_t vertexCount = textLength * 4;
+    if (ctx->batch.commandCount > 0 || !jm_text_batch_can_merge(batch, cmd, vertexCount))
+    {
+        jm_draw_context_flush(ctx);
+    }
+
+    // each glyph is a strip of 4 vertices followed by a restart index
+    batch->commands[batch->commandCount++] = cmd;
+    batch->vertexCount += vertexCount;
+    batch->indexCount += textLength * 5;
+}
+
+static void jm_draw_context_flush_text(
+	jm_draw_context* ctx)
+{
+    jm_text_batch* batch = &ctx->textBatch;
+    if (batch->commandCount == 0)
+    {
+        return;
+    }
 
 	// fill buffers
-	const uint32_t vertexCount = (uint32_t)textLength * 4;
-	uint32_t vertexDataSize = 0;
-	// pos
-	uint32_t positionOffset = vertexDataSize;
-	vertexDataSize += sizeof(jm_vertex) * vertexCount;
-	// uv
-	uint32_t texcoordOffset = vertexDataSize;
-	vertexDataSize += sizeof(jm_texcoord) * vertexCount;
-
-	const uint32_t vertexBufferOffset = ctx->vertexBufferOffset;
-	ctx->vertexBufferOffset += vertexDataSize;
-
-	const uint32_t optimisticIndexCount = (uint32_t)textLength * 5;
-	const uint32_t indexDataSize = optimisticIndexCount * sizeof(uint16_t);
-	const uint32_t indexBufferOffset = ctx->indexBufferOffset;
-	ctx->indexBufferOffset += indexDataSize;
-
-    const GLuint vertexBuffer = jm_renderer_get_dynamic_vertex_buffer();
-    const GLuint indexBuffer = jm_renderer_get_dynamic_index_buffer();
-
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-    void* dstVertices = glMapBufferRange(GL_ARRAY_BUFFER, vertexBufferOffset, vertexDataSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
-    void* dstIndices = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, indexBufferOffset, indexDataSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
-
-    jm_vertex* dstPosition = (jm_vertex*)((char*)dstVertices + positionOffset);
-    jm_texcoord* dstTexcoord = (jm_texcoord*)((char*)dstVertices + positionOffset);
-
-    uint32_t indexCount;
-    jm_font_get_text_vertices(
-        cmd->fontHandle,
-        cmd->text,
-        cmd->x,
-        cmd->y,
-        cmd->width,
-        cmd->rangeStart,
-        cmd->rangeEnd,
-        cmd->scale,
-        dstPosition,
-        dstTexcoord,
-        (uint16_t*)dstIndices,
-        &indexCount);
-
-    glUnmapBuffer(GL_ARRAY_BUFFER);
-    glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-
-    glDrawElements(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_SHORT, (const void*)(size_t)indexBufferOffset);
+    const jm_vertex_format vertexFormat = JM_VERTEX_FORMAT_POSITION_TEXCOORD_COLOR;
+    const jm_vertex_format_desc* desc = jm_renderer_get_vertex_format_desc(vertexFormat);
+	const uint32_t indexDataSize = batch->indexCount * sizeof(uint16_t);
+
+    uint32_t baseVertex;
+    uint32_t indexBufferOffset;
+    uint8_t* dstVertices = jm_draw_context_alloc_vertices(ctx, batch->vertexCount, desc->stride, &baseVertex);
+    uint16_t* dstIndices = (uint16_t*)jm_draw_context_alloc_indices(ctx, indexDataSize, &indexBufferOffset);
+    if (dstVertices == NULL || dstIndices == NULL)
+    {
+        batch->commandCount = 0;
+        batch->vertexCount = 0;
+        batch->indexCount = 0;
+        return;
+    }
+
+    uint16_t* dstIndex = dstIndices;
+    uint32_t batchVertex = 0;
+    for (uint32_t i = 0; i < batch->commandCount; ++i)
+    {
+        const jm_render_command_draw_text* cmd = batch->commands[i];
+        const uint32_t vertexCount = (uint32_t)strlen(cmd->text) * 4;
+        uint8_t* dstVertex = dstVertices + batchVertex * desc->stride;
+
+        uint32_t indexCount;
+        jm_font_get_text_vertices(
+            cmd->fontHandle,
+            cmd->text,
+            cmd->x,
+            cmd->y,
+            cmd->width,
+            cmd->rangeStart,
+            cmd->rangeEnd,
+            cmd->scale,
+            cmd->lineSpacingMultiplier,
+            (float*)dstVertex,
+            (float*)(dstVertex + desc->texcoordOffset),
+            desc->stride,
+            dstIndex,
+            &indexCount);
+
+        for (uint32_t j = 0; j < vertexCount; ++j)
+        {
+            uint8_t* dst = dstVertex + j * desc->stride;
+            *(float*)(dst + desc->depthOffset) = cmd->depth;
+            *(uint32_t*)(dst + desc->colorOffset) = cmd->color;
+        }
+
+        // glyph indices start at 0 for every text
+        for (uint32_t j = 0; j < indexCount; ++j)
+        {
+            if (dstIndex[j] != UINT16_MAX)
+            {
+                dstIndex[j] += (uint16_t)batchVertex;
+            }
+        }
+
+        dstIndex += indexCount;
+        batchVertex += vertexCount;
+    }
+
+    jm_draw_context_commit(ctx);
+
+    // text positions are in clip space of the view's viewport
+    jm_draw_context_set_viewport(batch->commands[0]->viewIndex);
+    jm_renderer_set_shader_program(JM_SHADER_PROGRAM_TEXT);
+    jm_renderer_set_depth_test(true);
+    jm_renderer_set_blend_state(JM_BLEND_STATE_TRANSPARENT);
+    jm_renderer_bind_texture(jm_font_get_info(batch->commands[0]->fontHandle)->texture);
+    jm_renderer_set_vertex_format(vertexFormat);
+    jm_renderer_set_primitive_restart(true, GL_UNSIGNED_SHORT);
+
+    const uint32_t indexCount = (uint32_t)(dstIndex - dstIndices);
+    glDrawElementsBaseVertex(GL_TRIANGLE_STRIP, indexCount, GL_UNSIGNED_SHORT, (const void*)(size_t)indexBufferOffset, baseVertex);
+
+    batch->commandCount = 0;
+    batch->vertexCount = 0;
+    batch->indexCount = 0;
+}
+
+void __jm_render_command_draw_sprites(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_sprites* cmd)
+{
+    if (cmd->spriteCount == 0)
+    {
+        return;
+    }
+
+    // sprites aren't batched with draw commands
+    jm_draw_context_flush(ctx);
+
+    // the records are uploaded as they are, one instance each
+    uint32_t baseInstance;
+    void* dstSprites = jm_draw_context_alloc_vertices(ctx, cmd->spriteCount, sizeof(jm_sprite), &baseInstance);
+    if (dstSprites == NULL)
+    {
+        return;
+    }
+    memcpy(dstSprites, cmd->sprites, sizeof(jm_sprite) * cmd->spriteCount);
+    jm_draw_context_commit(ctx);
+
+    const bool isSemitransparent = cmd->hasSemitransparentColors || jm_texture_isSemitransparent(cmd->textureHandle);
+
+    jm_renderer_set_shader_program(JM_SHADER_PROGRAM_SPRITE);
+    jm_renderer_set_depth_test(true);
+    jm_renderer_set_blend_state(isSemitransparent ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE);
+    jm_renderer_set_transform_index(JM_SHADER_PROGRAM_SPRITE, cmd->transformIndex);
+    jm_renderer_set_view_index(JM_SHADER_PROGRAM_SPRITE, cmd->viewIndex);
+    jm_draw_context_set_viewport(cmd->viewIndex);
+    jm_renderer_set_depth(JM_SHADER_PROGRAM_SPRITE, cmd->depth);
+    jm_renderer_bind_texture(jm_texture_get_resource(cmd->textureHandle));
+    baseInstance = jm_renderer_set_sprite_vertex_format(baseInstance);
+
+    if (baseInstance == 0)
+    {
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, cmd->spriteCount);
+    }
+    else
+    {
+        glDrawArraysInstancedBaseInstance(GL_TRIANGLE_STRIP, 0, 4, cmd->spriteCount, baseInstance);
+    }
+}
+
+static bool jm_is_strip_topology(
+    uint8_t topology)
+{
+    return topology == JM_PRIMITIVE_TOPOLOGY_LINESTRIP || topology == JM_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP;
+}
+
+void __jm_render_command_draw_mesh(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_mesh* cmd)
+{
+    // meshes aren't batched with draw commands
+    jm_draw_context_flush(ctx);
+
+    const jm_mesh_desc* mesh = jm_mesh_get_desc(cmd->meshHandle);
+    const bool isTextured = jm_mesh_is_textured(cmd->meshHandle);
+    const bool isStrip = jm_is_strip_topology(mesh->topology);
+
+    const jm_shader_program shaderProgram = isTextured ? JM_SHADER_PROGRAM_TEXTURE : JM_SHADER_PROGRAM_COLOR;
+    jm_renderer_set_shader_program(shaderProgram);
+    jm_renderer_set_depth_test(true);
+    jm_renderer_set_blend_state(jm_render_command_draw_mesh_is_translucent(cmd) ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE);
+    jm_renderer_set_transform_index(shaderProgram, cmd->transformIndex);
+    jm_renderer_set_view_index(shaderProgram, cmd->viewIndex);
+    jm_draw_context_set_viewport(cmd->viewIndex);
+    if (isTextured)
+    {
+        jm_renderer_bind_texture(jm_texture_get_resource(mesh->textureHandle));
+    }
+    jm_renderer_set_mesh_vertex_format(jm_mesh_get_resource(cmd->meshHandle), cmd->depth, cmd->color);
+
+    const GLenum drawMode = glmode[mesh->topology];
+    if (mesh->indices != NULL)
+    {
+        const GLenum indexType = mesh->isIndex32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+        jm_renderer_set_primitive_restart(isStrip, indexType);
+        glDrawElements(drawMode, mesh->indexCount, indexType, (const void*)0);
+    }
+    else
+    {
+        glDrawArrays(drawMode, 0, mesh->vertexCount);
+    }
+    jm_renderer_invalidate_vertex_format();
+}
+
+// viewport of the framebuffer, restored when a render target's pass ends
+static GLint g_framebufferViewport[4];
+
+void __jm_render_command_begin_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_begin_render_target* cmd)
+{
+    jm_draw_context_flush(ctx);
+
+    memcpy(g_framebufferViewport, g_targetViewport, sizeof(g_targetViewport));
+    jm_renderer_bind_render_target(jm_texture_get_render_target_resource(cmd->textureHandle));
+    const jm_texture_info* textureInfo = jm_texture_get_info(cmd->textureHandle);
+    jm_draw_context_set_target_viewport(0, 0, (GLint)textureInfo->width, (GLint)textureInfo->height);
+
+    // depth writes may have been left disabled by the last translucent draw
+    jm_renderer_set_blend_state(JM_BLEND_STATE_OPAQUE);
+    float r, g, b, a;
+    jm_unpack_color32_rgba_f32(cmd->clearColor, &r, &g, &b, &a);
+    glClearColor(r, g, b, a);
+    glClearDepth(1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void __jm_render_command_end_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_end_render_target* cmd)
+{
+    jm_draw_context_flush(ctx);
+
+    jm_renderer_bind_render_target(NULL);
+    jm_draw_context_set_target_viewport(g_framebufferViewport[0], g_framebufferViewport[1], g_framebufferViewport[2], g_framebufferViewport[3]);
+}
+
+static uint32_t jm_render_command_draw_batch_index_count(
+    const jm_render_command_draw* cmd)
+{
+    return (cmd->indices != NULL) ? cmd->indexCount : cmd->vertexCount;
+}
+
+static bool jm_draw_batch_can_merge(
+    const jm_draw_batch* batch,
+    const jm_render_command_draw* cmd)
+{
+    if (batch->commandCount == 0)
+    {
+        return true;
+    }
+    if (batch->commandCount == JM_DRAW_BATCH_MAX_COMMANDS)
+    {
+        return false;
+    }
+
+    const jm_render_command_draw* first = batch->commands[0];
+    
+    // merged draws use 16-bit indices, only a single draw may need 32-bit ones
+    if (jm_render_command_draw_needs_index32(batch->vertexCount + cmd->vertexCount))
+    {
+        return false;
+    }
+
+    const bool isTextured = jm_render_command_draw_is_textured(cmd);
+    if (isTextured != jm_render_command_draw_is_textured(first))
+    {
+        return false;
+    }
+    // textures in the same atlas page share their resource
+    if (isTextured && 
+        (jm_texture_get_batch_id(cmd->textureHandle) != jm_texture_get_batch_id(first->textureHandle) || 
+         cmd->samplerState != first->samplerState))
+    {
+        return false;
+    }
+    // colors and depth are written per vertex, so they may differ
+    if (cmd->topology != first->topology || 
+        cmd->fillMode != first->fillMode ||
+        cmd->transformIndex != first->transformIndex ||
+        cmd->viewIndex != first->viewIndex ||
+        jm_render_command_draw_is_translucent(cmd) != jm_render_command_draw_is_translucent(first))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+// Grows the batch's ranges by the command's vertices. Non-finite positions 
+// count as fractional and non-finite texcoords as out of range, so neither 
+// is packed.
+static void jm_draw_batch_add_ranges(
+    jm_draw_batch* batch,
+    const jm_render_command_draw* cmd)
+{
+    if (batch->commandCount == 0)
+    {
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            batch->minPosition[i] = batch->minTexcoord[i] = FLT_MAX;
+            batch->maxPosition[i] = batch->maxTexcoord[i] = -FLT_MAX;
+        }
+        batch->hasFractionalPosition = false;
+    }
+
+    for (uint32_t v = 0; v < cmd->vertexCount; ++v)
+    {
+        const float x = cmd->vertices[v].x;
+        const float y = cmd->vertices[v].y;
+        batch->minPosition[0] = fminf(batch->minPosition[0], x);
+        batch->maxPosition[0] = fmaxf(batch->maxPosition[0], x);
+        batch->minPosition[1] = fminf(batch->minPosition[1], y);
+        batch->maxPosition[1] = fmaxf(batch->maxPosition[1], y);
+        if (!(floorf(x) == x && floorf(y) == y))
+        {
+            batch->hasFractionalPosition = true;
+        }
+    }
+
+    if (cmd->texcoords == NULL)
+    {
+        return;
+    }
+    for (uint32_t v = 0; v < cmd->vertexCount; ++v)
+    {
+        const float u = cmd->texcoords[v].u;
+        const float t = cmd->texcoords[v].v;
+        if (!isfinite(u) || !isfinite(t))
+        {
+            batch->minTexcoord[0] = -FLT_MAX;
+            continue;
+        }
+        batch->minTexcoord[0] = fminf(batch->minTexcoord[0], u);
+        batch->maxTexcoord[0] = fmaxf(batch->maxTexcoord[0], u);
+        batch->minTexcoord[1] = fminf(batch->minTexcoord[1], t);
+        batch->maxTexcoord[1] = fmaxf(batch->maxTexcoord[1], t);
+    }
 }
 
 void __jm_render_command_draw(
 	jm_draw_context* ctx,
 	const jm_render_command_draw* cmd)
 {
-    const bool isIndexed = cmd->indices != NULL;
-	const bool isTextured = cmd->texcoords != NULL && cmd->textureHandle != JM_TEXTURE_HANDLE_INVALID;
-	const bool isVertexColor = false;//todo
+    if (cmd->vertexCount == 0)
+    {
+        return;
+    }
 
-	bool isSemitransparent = false;
-	const uint8_t alpha = (cmd->color >> 24);
-	if (alpha > 0x00 && alpha < 0xff)
-	{
-		// color is semitransparent
-		isSemitransparent = true;
-	}
-	else if (isTextured && jm_texture_isSemitransparent(cmd->textureHandle))
-	{
-		// texture has semitransparent pixels
-		isSemitransparent = true;
-	}
+    // draws aren't batched with text
+    jm_draw_batch* batch = &ctx->batch;
+    if (ctx->textBatch.commandCount > 0 || !jm_draw_batch_can_merge(batch, cmd))
+    {
+        jm_draw_context_flush(ctx);
+    }
 
-	// fill vertex buffer
-	uint32_t vertexDataSize = sizeof(jm_vertex) * cmd->vertexCount;
-	uint32_t positionOffset = 0;
-	uint32_t texcoordOffset = 0;
-	uint32_t vertexColorOffset = 0;
-	if (isTextured)
-	{
-		texcoordOffset = vertexDataSize;
-		vertexDataSize += sizeof(jm_texcoord) * cmd->vertexCount;
-	}
-	if (isVertexColor)
-	{
-		vertexColorOffset = vertexDataSize;
-		vertexDataSize += sizeof(jm_color32) * cmd->vertexCount;
-	}
+    if (batch->commandCount > 0 && jm_is_strip_topology(cmd->topology))
+    {
+        // restart index between strips
+        ++batch->indexCount;
+    }
 
-	const uint32_t vertexBufferOffset = ctx->vertexBufferOffset;
-	ctx->vertexBufferOffset += vertexDataSize;
+    jm_draw_batch_add_ranges(batch, cmd);
 
-	const GLuint vertexBuffer = jm_renderer_get_dynamic_vertex_buffer();
-    const GLuint indexBuffer = jm_renderer_get_dynamic_index_buffer();
+    batch->commands[batch->commandCount++] = cmd;
+    batch->vertexCount += cmd->vertexCount;
+    batch->indexCount += jm_render_command_draw_batch_index_count(cmd);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+// Picks the most compact format for the batch. Positions are only packed 
+// when they're integral and in int16 range, so they stay exact. Texcoords in 
+// [0,1] are packed as unorm16, which rounds them to the nearest 1/65535.
+static jm_vertex_format jm_draw_batch_select_vertex_format(
+    const jm_draw_batch* batch,
+    bool isTextured)
+{
+    const bool isPosition16 = !batch->hasFractionalPosition &&
+        batch->minPosition[0] >= INT16_MIN && batch->maxPosition[0] <= INT16_MAX &&
+        batch->minPosition[1] >= INT16_MIN && batch->maxPosition[1] <= INT16_MAX;
+    if (!isTextured)
+    {
+        return isPosition16 ? JM_VERTEX_FORMAT_POSITION16_COLOR : JM_VERTEX_FORMAT_POSITION_COLOR;
+    }
+
+    const bool isTexcoord16 = 
+        batch->minTexcoord[0] >= 0.0f && batch->maxTexcoord[0] <= 1.0f &&
+        batch->minTexcoord[1] >= 0.0f && batch->maxTexcoord[1] <= 1.0f;
+    if (isPosition16)
+    {
+        return isTexcoord16 ? JM_VERTEX_FORMAT_POSITION16_TEXCOORD16_COLOR : JM_VERTEX_FORMAT_POSITION16_TEXCOORD_COLOR;
+    }
+    return isTexcoord16 ? JM_VERTEX_FORMAT_POSITION_TEXCOORD16_COLOR : JM_VERTEX_FORMAT_POSITION_TEXCOORD_COLOR;
+}
+
+static uint8_t* jm_write_vertices(
+    uint8_t* dst,
+    const jm_vertex_format_desc* desc,
+    const jm_render_command_draw* cmd)
+{
+    const float z = cmd->depth;
+    for (uint32_t v = 0; v < cmd->vertexCount; ++v)
+    {
+        if (desc->isPosition16)
+        {
+            int16_t* dstPosition = (int16_t*)dst;
+            dstPosition[0] = (int16_t)cmd->vertices[v].x;
+            dstPosition[1] = (int16_t)cmd->vertices[v].y;
+        }
+        else
+        {
+            float* dstPosition = (float*)dst;
+            dstPosition[0] = cmd->vertices[v].x;
+            dstPosition[1] = cmd->vertices[v].y;
+        }
+        *(float*)(dst + desc->depthOffset) = z;
+
+        if (desc->isTexcoord16)
+        {
+            uint16_t* dstTexcoord = (uint16_t*)(dst + desc->texcoordOffset);
+            dstTexcoord[0] = (uint16_t)(cmd->texcoords[v].u * UINT16_MAX + 0.5f);
+            dstTexcoord[1] = (uint16_t)(cmd->texcoords[v].v * UINT16_MAX + 0.5f);
+        }
+        else if (desc->hasTexcoord)
+        {
+            float* dstTexcoord = (float*)(dst + desc->texcoordOffset);
+            dstTexcoord[0] = cmd->texcoords[v].u;
+            dstTexcoord[1] = cmd->texcoords[v].v;
+        }
+
+        *(uint32_t*)(dst + desc->colorOffset) = (cmd->colors != NULL) ? jm_modulate_color32(cmd->colors[v], cmd->color) : cmd->color;
+        dst += desc->stride;
+    }
+    return dst;
+}
+
+static void jm_write_indices32(
+    uint32_t* dstIndex,
+    const jm_render_command_draw* cmd)
+{
+    if (cmd->indices == NULL)
+    {
+        for (uint32_t j = 0; j < cmd->vertexCount; ++j)
+        {
+            dstIndex[j] = j;
+        }
+    }
+    else if (cmd->isIndex32)
+    {
+        memcpy(dstIndex, cmd->indices, sizeof(uint32_t) * cmd->indexCount);
+    }
+    else
+    {
+        const uint16_t* srcIndex = (const uint16_t*)cmd->indices;
+        for (uint32_t j = 0; j < cmd->indexCount; ++j)
+        {
+            dstIndex[j] = srcIndex[j];
+        }
+    }
+}
+
+void jm_draw_context_flush(
+	jm_draw_context* ctx)
+{
+    jm_draw_context_flush_text(ctx);
+
+    jm_draw_batch* batch = &ctx->batch;
+    if (batch->commandCount == 0)
+    {
+        return;
+    }
+
+    const jm_render_command_draw* first = batch->commands[0];
+
+    const bool isTextured = jm_render_command_draw_is_textured(first);
+	const bool isSemitransparent = jm_render_command_draw_is_translucent(first);
+    const bool isStrip = jm_is_strip_topology(first->topology);
+
+    const jm_vertex_format vertexFormat = jm_draw_batch_select_vertex_format(batch, isTextured);
+    const jm_vertex_format_desc* desc = jm_renderer_get_vertex_format_desc(vertexFormat);
+
+    // only a batch of a single large draw needs 32-bit indices
+    const bool isIndex32 = jm_render_command_draw_needs_index32(batch->vertexCount);
+    const uint32_t indexSize = isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+	const uint32_t indexDataSize = indexSize * batch->indexCount;
+
+    uint32_t baseVertex;
+    uint32_t indexBufferOffset;
+    uint8_t* vertexBufferData = jm_draw_context_alloc_vertices(ctx, batch->vertexCount, desc->stride, &baseVertex);
+    void* indexBufferData = jm_draw_context_alloc_indices(ctx, indexDataSize, &indexBufferOffset);
+    if (vertexBufferData == NULL || indexBufferData == NULL)
+    {
+        batch->commandCount = 0;
+        batch->vertexCount = 0;
+        batch->indexCount = 0;
+        return;
+    }
 
 	{
-		//printf("%u, %u\n", vertexBufferOffset, vertexDataSize);
-        void* vertexBufferData = glMapBufferRange(GL_ARRAY_BUFFER, vertexBufferOffset, vertexDataSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
-		void* dstPosition = (uint8_t*)vertexBufferData + positionOffset;
-		void* dstTexcoord = (uint8_t*)vertexBufferData + texcoordOffset;
-		void* dstVertexColor = (uint8_t*)vertexBufferData + vertexColorOffset;
-
-		// copy position
-		memcpy(dstPosition, cmd->vertices, vertexDataSize);
-		// copy texcoord
-		if (isTextured)
-		{
-			memcpy(dstTexcoord, cmd->texcoords, vertexDataSize);
-		}
-		// copy color
-		if (isVertexColor)
-		{
-			memcpy(dstVertexColor, NULL, vertexDataSize);
-		}
-		glUnmapBuffer(GL_ARRAY_BUFFER);
+        uint8_t* dstVertex = vertexBufferData;
+        uint16_t* dstIndex = (uint16_t*)indexBufferData;
+
+        uint32_t batchVertex = 0;
+        for (uint32_t i = 0; i < batch->commandCount; ++i)
+        {
+            const jm_render_command_draw* cmd = batch->commands[i];
+
+            // interleave vertices, with the depth of their command in z
+            dstVertex = jm_write_vertices(dstVertex, desc, cmd);
+
+            if (isIndex32)
+            {
+                // a batch with 32-bit indices holds a single draw, no rebasing
+                jm_assert(batch->commandCount == 1);
+                jm_write_indices32((uint32_t*)indexBufferData, cmd);
+                break;
+            }
+
+            // copy and rebase indices
+            if (isStrip && i > 0)
+            {
+                *dstIndex++ = UINT16_MAX;
+            }
+            if (cmd->indices != NULL)
+            {
+                // strips may restart themselves, which stays a restart
+                const uint16_t* srcIndex = (const uint16_t*)cmd->indices;
+                for (uint32_t j = 0; j < cmd->indexCount; ++j)
+                {
+                    *dstIndex++ = (srcIndex[j] != UINT16_MAX) ? (uint16_t)(batchVertex + srcIndex[j]) : UINT16_MAX;
+                }
+            }
+            else
+            {
+                for (uint32_t j = 0; j < cmd->vertexCount; ++j)
+                {
+                    *dstIndex++ = (uint16_t)(batchVertex + j);
+                }
+            }
+
+            batchVertex += cmd->vertexCount;
+        }
+
+        jm_draw_context_commit(ctx);
 	}
 
 	// set shader
@@ -156,74 +700,30 @@ void __jm_render_command_draw(
 	jm_renderer_set_shader_program(shaderProgram);
 
 	// set blend state
-    glDepthFunc(GL_LESS);
-    glEnable(GL_DEPTH_TEST);
-	if (isSemitransparent)
-	{
-        glEnable(GL_BLEND);
-		glBlendEquation(GL_FUNC_ADD);
-        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
-        glDepthMask(GL_FALSE);
-	}
-    else
-    {
-        glDisable(GL_BLEND);
-        glDepthMask(GL_TRUE);
-    }
+    jm_renderer_set_depth_test(true);
+    jm_renderer_set_blend_state(isSemitransparent ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE);
 
 	// update uniforms
-	const GLuint colorUniformLocation = jm_renderer_get_uniform_location(shaderProgram, "g_color");
-	const GLuint matWorldViewProjLocation = jm_renderer_get_uniform_location(shaderProgram, "g_matWorldViewProj");
-
-	float r, g, b, a;
-	jm_unpack_color32_rgba_f32(cmd->color, &r, &g, &b, &a);
-	glUniform4f(colorUniformLocation, r, g, b, a);
-	glUniformMatrix4fv(matWorldViewProjLocation, 1, GL_FALSE, cmd->transform);
-
-	// set positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)(size_t)(vertexBufferOffset + positionOffset));
+    // the depth comes from the vertices
+    jm_renderer_set_transform_index(shaderProgram, first->transformIndex);
+    jm_renderer_set_view_index(shaderProgram, first->viewIndex);
+    jm_draw_context_set_viewport(first->viewIndex);
 
 	if (isTextured)
 	{
-		// bind texture
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, jm_texture_get_resource(cmd->textureHandle));
-
-		// set texcoords
-		glEnableVertexAttribArray(1);
-    	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(size_t)(vertexBufferOffset + texcoordOffset));
-	}
-	else
-	{
-		glDisableVertexAttribArray(1);
+		jm_renderer_bind_texture(jm_texture_get_resource(first->textureHandle));
 	}
 
-    const GLenum drawMode = glmode[cmd->topology];
-	if (isIndexed)
-	{
-		// fill index buffer
-		const uint32_t indexBufferSize = sizeof(uint16_t) * cmd->indexCount;
-		const uint32_t indexBufferOffset = ctx->indexBufferOffset;
-		ctx->indexBufferOffset += indexBufferSize;
-
-		{
-			//printf("%u, %u\n", indexBufferOffset, indexBufferSize);
-            void* indexBufferData = glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, indexBufferOffset, indexBufferSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
-			memcpy(indexBufferData, cmd->indices, indexBufferSize);
-            glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
-		}
-
-		const GLenum indexFormat = GL_UNSIGNED_SHORT;
-
-		//glEnable(GL_PRIMITIVE_RESTART);
-		//glPrimitiveRestartIndex(0xffff);
-        glDrawElements(drawMode, cmd->indexCount, indexFormat, (const void*)(size_t)indexBufferOffset);
-	}
-	else
-	{
-        glDrawArrays(drawMode, 0, cmd->vertexCount);
-	}
+    jm_renderer_set_vertex_format(vertexFormat);
+    const GLenum indexType = isIndex32 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    jm_renderer_set_primitive_restart(isStrip, indexType);
+
+    const GLenum drawMode = glmode[first->topology];
+    glDrawElementsBaseVertex(drawMode, batch->indexCount, indexType, (const void*)(size_t)indexBufferOffset, baseVertex);
+
+    batch->commandCount = 0;
+    batch->vertexCount = 0;
+    batch->indexCount = 0;
 }
 
 void jm_draw_context_begin(
@@ -232,5 +732,52 @@ void jm_draw_context_begin(
 {
 	ctx->vertexBufferOffset = 0;
 	ctx->indexBufferOffset = 0;
+	ctx->batch.commandCount = 0;
+	ctx->batch.vertexCount = 0;
+	ctx->batch.indexCount = 0;
+	ctx->textBatch.commandCount = 0;
+	ctx->textBatch.vertexCount = 0;
+	ctx->textBatch.indexCount = 0;
+
+    jm_dynamic_buffer_region vertexRegion;
+    jm_dynamic_buffer_region indexRegion;
+    jm_renderer_begin_dynamic_buffers(&vertexRegion, &indexRegion);
+
+    ctx->vertexData = vertexRegion.data;
+    ctx->vertexBufferBase = vertexRegion.offset;
+    ctx->vertexBufferCapacity = vertexRegion.size;
+    ctx->indexData = indexRegion.data;
+    ctx->indexBufferBase = indexRegion.offset;
+    ctx->indexBufferCapacity = indexRegion.size;
+
+    // the platform layer has set the viewport to the whole framebuffer
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    jm_draw_context_set_target_viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void jm_draw_context_set_transforms(
+	jm_draw_context* ctx,
+	const float (*transforms)[16],
+	uint32_t transformCount)
+{
+    jm_renderer_update_transform_palette(transforms, transformCount);
+}
+
+void jm_draw_context_set_views(
+	jm_draw_context* ctx,
+	const jm_view* views,
+	uint32_t viewCount)
+{
+    // the palette lives in the command buffer, which outlives execution
+    g_views = views;
+    jm_renderer_update_view_palette(views, viewCount);
+}
+
+void jm_draw_context_end(
+	jm_draw_context* ctx)
+{
+    jm_draw_context_flush(ctx);
+    jm_renderer_end_dynamic_buffers();
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,479 @@
+#if defined(JM_RENDERER_SOFTWARE)
+#include "render_commands.h"
+
+#include <jammy/renderer.h>
+#include <jammy/assert.h>
+#include <jammy/color.h>
+#include <jammy/math.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Commands transform their vertices into framebuffer pixels and queue
+// triangles, which are rasterized when the frame or a render target's pass ends.
+static struct
+{
+	const float (*transforms)[16];
+	uint32_t transformCount;
+	const jm_view* views;
+	uint32_t viewCount;
+	float width;
+	float height;
+
+	// pixels of the current view, set by jm_software_set_view
+	float viewportX;
+	float viewportY;
+	float viewportWidth;
+	float viewportHeight;
+
+	// grown on demand and kept between frames
+	jm_raster_vertex* vertices;
+	uint32_t vertexCapacity;
+	float* textVertices;
+	uint16_t* textIndices;
+	uint32_t textCapacity;
+} g_software;
+
+static jm_raster_vertex* jm_software_get_vertices(
+	uint32_t count)
+{
+	if (count > g_software.vertexCapacity)
+	{
+		g_software.vertexCapacity = count;
+		g_software.vertices = realloc(g_software.vertices, sizeof(jm_raster_vertex) * count);
+	}
+	return g_software.vertices;
+}
+
+// Selects the view that following vertices are mapped with, and returns the 
+// product of its transform and the palette entry in outTransform. Triangles 
+// are clipped to the view's viewport through state, as clip space clips 
+// them on the GPU.
+static void jm_software_set_view(
+	jm_raster_triangle* state,
+	uint8_t viewIndex,
+	uint16_t transformIndex,
+	float* outTransform)
+{
+	jm_assert(viewIndex < g_software.viewCount);
+	jm_assert(transformIndex < g_software.transformCount);
+	const jm_view* view = &g_software.views[viewIndex];
+	jm_multiply_transforms(outTransform, view->transform, g_software.transforms[transformIndex]);
+
+	// whole pixels, like the viewports of the GPU backends
+	const float left = roundf(jm_clamp(view->viewport[0], 0.0f, 1.0f) * g_software.width);
+	const float top = roundf(jm_clamp(view->viewport[1], 0.0f, 1.0f) * g_software.height);
+	const float right = roundf(jm_clamp(view->viewport[0] + view->viewport[2], 0.0f, 1.0f) * g_software.width);
+	const float bottom = roundf(jm_clamp(view->viewport[1] + view->viewport[3], 0.0f, 1.0f) * g_software.height);
+	g_software.viewportX = left;
+	g_software.viewportY = top;
+	g_software.viewportWidth = right - left;
+	g_software.viewportHeight = bottom - top;
+	state->scissor[0] = (uint16_t)left;
+	state->scissor[1] = (uint16_t)top;
+	state->scissor[2] = (uint16_t)right;
+	state->scissor[3] = (uint16_t)bottom;
+}
+
+// Applies a column-major transform and maps clip space to the pixels of the 
+// current view, with the first row at the top.
+static void jm_software_set_position(
+	jm_raster_vertex* dst,
+	const float* m,
+	float x,
+	float y)
+{
+	const float clipX = m[0] * x + m[4] * y + m[12];
+	const float clipY = m[1] * x + m[5] * y + m[13];
+	const float clipW = m[3] * x + m[7] * y + m[15];
+	dst->x = g_software.viewportX + (clipX / clipW * 0.5f + 0.5f) * g_software.viewportWidth;
+	dst->y = g_software.viewportY + (0.5f - clipY / clipW * 0.5f) * g_software.viewportHeight;
+}
+
+static void jm_software_set_color(
+	jm_raster_vertex* dst,
+	jm_color32 color)
+{
+	jm_unpack_color32_rgba_f32(color, &dst->r, &dst->g, &dst->b, &dst->a);
+}
+
+static void jm_software_emit_triangle(
+	const jm_raster_triangle* state,
+	const jm_raster_vertex* v0,
+	const jm_raster_vertex* v1,
+	const jm_raster_vertex* v2)
+{
+	jm_raster_triangle* triangle = jm_renderer_alloc_triangles(1);
+	*triangle = *state;
+	triangle->vertices[0] = *v0;
+	triangle->vertices[1] = *v1;
+	triangle->vertices[2] = *v2;
+}
+
+// Lines are one pixel wide quads.
+static void jm_software_emit_line(
+	const jm_raster_triangle* state,
+	const jm_raster_vertex* from,
+	const jm_raster_vertex* to)
+{
+	const float dx = to->x - from->x;
+	const float dy = to->y - from->y;
+	const float length = sqrtf(dx * dx + dy * dy);
+	if (length == 0.0f)
+	{
+		return;
+	}
+
+	const float nx = -dy / length * 0.5f;
+	const float ny = dx / length * 0.5f;
+
+	jm_raster_vertex corners[4] = { *from, *from, *to, *to };
+	corners[0].x += nx;
+	corners[0].y += ny;
+	corners[1].x -= nx;
+	corners[1].y -= ny;
+	corners[2].x += nx;
+	corners[2].y += ny;
+	corners[3].x -= nx;
+	corners[3].y -= ny;
+
+	jm_software_emit_triangle(state, &corners[0], &corners[1], &corners[2]);
+	jm_software_emit_triangle(state, &corners[1], &corners[3], &corners[2]);
+}
+
+static uint32_t jm_software_get_index(
+	const void* indices,
+	bool isIndex32,
+	uint32_t i)
+{
+	if (indices == NULL)
+	{
+		return i;
+	}
+	return isIndex32 ? ((const uint32_t*)indices)[i] : ((const uint16_t*)indices)[i];
+}
+
+// Assembles primitives like the GPU does, including primitive restart in
+// indexed strips.
+static void jm_software_emit_primitives(
+	const jm_raster_triangle* state,
+	uint8_t topology,
+	const jm_raster_vertex* vertices,
+	uint32_t vertexCount,
+	const void* indices,
+	bool isIndex32,
+	uint32_t indexCount)
+{
+	const uint32_t restartIndex = isIndex32 ? UINT32_MAX : UINT16_MAX;
+	const uint32_t verticesPerPrimitive =
+		(topology == JM_PRIMITIVE_TOPOLOGY_LINELIST || topology == JM_PRIMITIVE_TOPOLOGY_LINESTRIP) ? 2 : 3;
+	const bool isStrip = (topology == JM_PRIMITIVE_TOPOLOGY_LINESTRIP || topology == JM_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+
+	uint32_t window[3];
+	uint32_t windowSize = 0;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		const uint32_t index = jm_software_get_index(indices, isIndex32, i);
+		if (isStrip && indices != NULL && index == restartIndex)
+		{
+			windowSize = 0;
+			continue;
+		}
+		if (index >= vertexCount)
+		{
+			windowSize = 0;
+			continue;
+		}
+
+		window[windowSize++] = index;
+		if (windowSize < verticesPerPrimitive)
+		{
+			continue;
+		}
+
+		if (verticesPerPrimitive == 2)
+		{
+			jm_software_emit_line(state, &vertices[window[0]], &vertices[window[1]]);
+		}
+		else
+		{
+			jm_software_emit_triangle(state, &vertices[window[0]], &vertices[window[1]], &vertices[window[2]]);
+		}
+
+		if (isStrip)
+		{
+			// keep the last vertices as the start of the next primitive
+			window[0] = window[1];
+			window[1] = window[2];
+			windowSize = verticesPerPrimitive - 1;
+		}
+		else
+		{
+			windowSize = 0;
+		}
+	}
+}
+
+void __jm_render_command_draw_text(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_text* cmd)
+{
+	jm_assert(cmd->fontHandle != JM_FONT_HANDLE_INVALID);
+	jm_assert(cmd->text);
+
+	const uint32_t textLength = (uint32_t)strlen(cmd->text);
+	if (textLength == 0)
+	{
+		return;
+	}
+
+	// positions and texcoords interleaved, 4 vertices and up to 5 strip
+	// indices per character
+	if (textLength > g_software.textCapacity)
+	{
+		g_software.textCapacity = textLength;
+		g_software.textVertices = realloc(g_software.textVertices, sizeof(float) * 4 * 4 * textLength);
+		g_software.textIndices = realloc(g_software.textIndices, sizeof(uint16_t) * 5 * textLength);
+	}
+
+	uint32_t indexCount;
+	jm_font_get_text_vertices(
+		cmd->fontHandle,
+		cmd->text,
+		cmd->x,
+		cmd->y,
+		cmd->width,
+		cmd->rangeStart,
+		cmd->rangeEnd,
+		cmd->scale,
+		cmd->lineSpacingMultiplier,
+		g_software.textVertices,
+		g_software.textVertices + 2,
+		sizeof(float) * 4,
+		g_software.textIndices,
+		&indexCount);
+
+	// text positions are in clip space of the view's viewport, so only the 
+	// viewport of the view applies
+	jm_raster_triangle state;
+	float transform[16];
+	jm_software_set_view(&state, cmd->viewIndex, JM_TRANSFORM_INDEX_IDENTITY, transform);
+	const float* identity = g_software.transforms[JM_TRANSFORM_INDEX_IDENTITY];
+
+	const uint32_t vertexCount = textLength * 4;
+	jm_raster_vertex* vertices = jm_software_get_vertices(vertexCount);
+	for (uint32_t i = 0; i < vertexCount; ++i)
+	{
+		const float* src = g_software.textVertices + i * 4;
+		jm_software_set_position(&vertices[i], identity, src[0], src[1]);
+		vertices[i].u = src[2];
+		vertices[i].v = src[3];
+		jm_software_set_color(&vertices[i], cmd->color);
+	}
+
+	state.depth = cmd->depth;
+	state.texture = jm_font_get_info(cmd->fontHandle)->texture;
+	state.blendState = JM_BLEND_STATE_TRANSPARENT;
+	state.depthTest = 1;
+	state.alphaTest = 0;
+
+	jm_software_emit_primitives(&state, JM_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP, vertices, vertexCount, g_software.textIndices, false, indexCount);
+}
+
+void __jm_render_command_draw(
+	jm_draw_context* ctx,
+	const jm_render_command_draw* cmd)
+{
+	if (cmd->vertexCount == 0)
+	{
+		return;
+	}
+
+	const bool isTextured = jm_render_command_draw_is_textured(cmd);
+	jm_raster_triangle state;
+	float transform[16];
+	jm_software_set_view(&state, cmd->viewIndex, cmd->transformIndex, transform);
+
+	jm_raster_vertex* vertices = jm_software_get_vertices(cmd->vertexCount);
+	for (uint32_t i = 0; i < cmd->vertexCount; ++i)
+	{
+		jm_software_set_position(&vertices[i], transform, cmd->vertices[i].x, cmd->vertices[i].y);
+		vertices[i].u = isTextured ? cmd->texcoords[i].u : 0.0f;
+		vertices[i].v = isTextured ? cmd->texcoords[i].v : 0.0f;
+		jm_software_set_color(&vertices[i], (cmd->colors != NULL) ? jm_modulate_color32(cmd->colors[i], cmd->color) : cmd->color);
+	}
+
+	state.depth = cmd->depth;
+	state.texture = isTextured ? jm_texture_get_resource(cmd->textureHandle) : 0;
+	state.blendState = jm_render_command_draw_is_translucent(cmd) ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE;
+	state.depthTest = 1;
+	state.alphaTest = isTextured;
+
+	const uint32_t indexCount = (cmd->indices != NULL) ? cmd->indexCount : cmd->vertexCount;
+	jm_software_emit_primitives(&state, cmd->topology, vertices, cmd->vertexCount, cmd->indices, cmd->isIndex32, indexCount);
+}
+
+void __jm_render_command_draw_sprites(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_sprites* cmd)
+{
+	jm_raster_triangle state;
+	float transform[16];
+	jm_software_set_view(&state, cmd->viewIndex, cmd->transformIndex, transform);
+
+	state.depth = cmd->depth;
+	state.texture = jm_texture_get_resource(cmd->textureHandle);
+	state.blendState = (cmd->hasSemitransparentColors || jm_texture_isSemitransparent(cmd->textureHandle)) ?
+		JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE;
+	state.depthTest = 1;
+	state.alphaTest = 1;
+
+	// corners of the unit quad, as in the sprite vertex shader
+	static const float corners[4][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+	for (uint32_t i = 0; i < cmd->spriteCount; ++i)
+	{
+		const jm_sprite* sprite = &cmd->sprites[i];
+		const float halfWidth = 0.5f * sprite->width;
+		const float halfHeight = 0.5f * sprite->height;
+		const float s = sinf(sprite->rotation);
+		const float c = cosf(sprite->rotation);
+
+		jm_raster_vertex vertices[4];
+		for (uint32_t v = 0; v < 4; ++v)
+		{
+			const float offsetX = (corners[v][0] * 2.0f - 1.0f) * halfWidth;
+			const float offsetY = (corners[v][1] * 2.0f - 1.0f) * halfHeight;
+			const float x = sprite->x + halfWidth + c * offsetX - s * offsetY;
+			const float y = sprite->y + halfHeight + s * offsetX + c * offsetY;
+			jm_software_set_position(&vertices[v], transform, x, y);
+
+			const uint16_t u = corners[v][0] ? sprite->u1 : sprite->u0;
+			const uint16_t t = corners[v][1] ? sprite->v1 : sprite->v0;
+			vertices[v].u = (float)u / (float)UINT16_MAX;
+			vertices[v].v = (float)t / (float)UINT16_MAX;
+			jm_software_set_color(&vertices[v], sprite->color);
+		}
+
+		jm_software_emit_triangle(&state, &vertices[0], &vertices[1], &vertices[2]);
+		jm_software_emit_triangle(&state, &vertices[1], &vertices[3], &vertices[2]);
+	}
+}
+
+void __jm_render_command_draw_mesh(
+	jm_draw_context* ctx,
+	const jm_render_command_draw_mesh* cmd)
+{
+	const jm_mesh_desc* mesh = jm_mesh_get_desc(cmd->meshHandle);
+	const bool isTextured = jm_mesh_is_textured(cmd->meshHandle);
+	jm_raster_triangle state;
+	float transform[16];
+	jm_software_set_view(&state, cmd->viewIndex, cmd->transformIndex, transform);
+
+	// the mesh's texcoords are relative to its texture, not to the resource
+	float u0 = 0.0f, v0 = 0.0f, u1 = 1.0f, v1 = 1.0f;
+	if (isTextured)
+	{
+		const jm_texture_info* textureInfo = jm_texture_get_info(mesh->textureHandle);
+		u0 = textureInfo->u0;
+		v0 = textureInfo->v0;
+		u1 = textureInfo->u1;
+		v1 = textureInfo->v1;
+	}
+
+	jm_raster_vertex* vertices = jm_software_get_vertices(mesh->vertexCount);
+	for (uint32_t i = 0; i < mesh->vertexCount; ++i)
+	{
+		jm_software_set_position(&vertices[i], transform, mesh->vertices[i].x, mesh->vertices[i].y);
+		vertices[i].u = isTextured ? u0 + mesh->texcoords[i].u * (u1 - u0) : 0.0f;
+		vertices[i].v = isTextured ? v0 + mesh->texcoords[i].v * (v1 - v0) : 0.0f;
+		jm_software_set_color(&vertices[i], cmd->color);
+	}
+
+	state.depth = cmd->depth;
+	state.texture = isTextured ? jm_texture_get_resource(mesh->textureHandle) : 0;
+	state.blendState = jm_render_command_draw_mesh_is_translucent(cmd) ? JM_BLEND_STATE_TRANSPARENT : JM_BLEND_STATE_OPAQUE;
+	state.depthTest = 1;
+	state.alphaTest = isTextured;
+
+	const uint32_t indexCount = (mesh->indices != NULL) ? mesh->indexCount : mesh->vertexCount;
+	jm_software_emit_primitives(&state, mesh->topology, vertices, mesh->vertexCount, mesh->indices, mesh->isIndex32, indexCount);
+}
+
+void __jm_render_command_begin_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_begin_render_target* cmd)
+{
+	// triangles queued so far belong to the previous target
+	jm_renderer_rasterize();
+	jm_renderer_set_render_target(jm_texture_get_render_target_resource(cmd->textureHandle));
+	jm_renderer_clear(cmd->clearColor);
+
+	const jm_texture_info* textureInfo = jm_texture_get_info(cmd->textureHandle);
+	g_software.width = (float)textureInfo->width;
+	g_software.height = (float)textureInfo->height;
+}
+
+void __jm_render_command_end_render_target(
+	jm_draw_context* ctx,
+	const jm_render_command_end_render_target* cmd)
+{
+	jm_renderer_rasterize();
+	jm_renderer_set_render_target(0);
+
+	uint32_t width;
+	uint32_t height;
+	jm_renderer_get_framebuffer_size(&width, &height);
+	g_software.width = (float)width;
+	g_software.height = (float)height;
+}
+
+void jm_draw_context_begin(
+	jm_draw_context* ctx,
+	void* platformContext)
+{
+	ctx->platformContext = platformContext;
+	ctx->vertexBufferOffset = 0;
+	ctx->indexBufferOffset = 0;
+	ctx->batch.commandCount = 0;
+	ctx->batch.vertexCount = 0;
+	ctx->batch.indexCount = 0;
+
+	uint32_t width;
+	uint32_t height;
+	jm_renderer_get_framebuffer_size(&width, &height);
+	g_software.width = (float)width;
+	g_software.height = (float)height;
+}
+
+void jm_draw_context_set_transforms(
+	jm_draw_context* ctx,
+	const float (*transforms)[16],
+	uint32_t transformCount)
+{
+	// the palette lives in the command buffer, which outlives execution
+	g_software.transforms = transforms;
+	g_software.transformCount = transformCount;
+}
+
+void jm_draw_context_set_views(
+	jm_draw_context* ctx,
+	const jm_view* views,
+	uint32_t viewCount)
+{
+	g_software.views = views;
+	g_software.viewCount = viewCount;
+}
+
+void jm_draw_context_flush(
+	jm_draw_context* ctx)
+{
+}
+
+void jm_draw_context_end(
+	jm_draw_context* ctx)
+{
+	jm_renderer_rasterize();
+}
+#endif
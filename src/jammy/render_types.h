@@ -2,14 +2,23 @@
 
 #include <inttypes.h>
 
-#if defined(JM_WINDOWS)
+#if defined(JM_RENDERER_NULL) || defined(JM_RENDERER_SOFTWARE)
+typedef uint32_t jm_texture_resource;
+typedef uint32_t jm_buffer_resource;
+typedef uint32_t jm_render_target_resource;
+typedef uint32_t jm_mesh_resource;
+#elif defined(JM_WINDOWS)
 #include <d3d11.h>
 typedef ID3D11ShaderResourceView* jm_texture_resource;
 typedef ID3D11Buffer* jm_buffer_resource;
+typedef struct jm_render_target* jm_render_target_resource;
+typedef struct jm_mesh* jm_mesh_resource;
 #else 
 #include <GL/glew.h>
 typedef GLuint jm_texture_resource;
 typedef GLuint jm_buffer_resource;
+typedef struct jm_render_target* jm_render_target_resource;
+typedef struct jm_mesh* jm_mesh_resource;
 #endif
 
 typedef enum jm_texture_format
@@ -23,11 +32,15 @@ typedef enum jm_shader_program
 	JM_SHADER_PROGRAM_COLOR,
 	JM_SHADER_PROGRAM_TEXTURE,
 	JM_SHADER_PROGRAM_TEXT,
+	JM_SHADER_PROGRAM_COLOR_VERTEX_COLOR,
+	JM_SHADER_PROGRAM_TEXTURE_VERTEX_COLOR,
+	JM_SHADER_PROGRAM_SPRITE,
 	JM_SHADER_PROGRAM_COUNT,
 } jm_shader_program;
 
 typedef enum jm_constant_buffer
 {
+	JM_CONSTANT_BUFFER_PER_FRAME_VS,
 	JM_CONSTANT_BUFFER_PER_VIEW_VS,
 	JM_CONSTANT_BUFFER_PER_VIEW_PS,
 	JM_CONSTANT_BUFFER_PER_INSTANCE_VS,
@@ -64,6 +77,20 @@ typedef enum jm_blend_state
 	JM_BLEND_STATE_COUNT,
 } jm_blend_state;
 
+// Interleaved layouts of dynamic vertices. Every vertex has a 2D position, a 
+// depth and an RGBA8 color, and optionally a texcoord. The 16-bit variants 
+// store positions as int16 and texcoords as unorm16.
+typedef enum jm_vertex_format
+{
+	JM_VERTEX_FORMAT_POSITION_COLOR,
+	JM_VERTEX_FORMAT_POSITION16_COLOR,
+	JM_VERTEX_FORMAT_POSITION_TEXCOORD_COLOR,
+	JM_VERTEX_FORMAT_POSITION_TEXCOORD16_COLOR,
+	JM_VERTEX_FORMAT_POSITION16_TEXCOORD_COLOR,
+	JM_VERTEX_FORMAT_POSITION16_TEXCOORD16_COLOR,
+	JM_VERTEX_FORMAT_COUNT,
+} jm_vertex_format;
+
 typedef struct jm_vertex
 {
 	float x, y;
@@ -72,4 +99,12 @@ typedef struct jm_vertex
 typedef struct jm_texcoord
 {
 	float u, v;
-} jm_texcoord;
\ No newline at end of file
+} jm_texcoord;
+
+// A camera: its view-projection and the part of the target it's drawn to. 
+// The layout matches the View struct of the shaders.
+typedef struct jm_view
+{
+	float transform[16]; // column-major, world to clip space
+	float viewport[4]; // x, y, width and height in fractions of the target, from the top left
+} jm_view;
\ No newline at end of file
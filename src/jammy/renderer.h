@@ -2,9 +2,16 @@
 
 #include <jammy/render_types.h>
 
+#include <stdbool.h>
+
 int jm_renderer_init();
 
-#if defined(JM_WINDOWS)
+// JM_RENDERER_NULL and JM_RENDERER_SOFTWARE are defined by the build 
+// (premake5 --renderer=null or --renderer=software) and replace the 
+// platform's renderer with one that doesn't need a display.
+#if defined(JM_RENDERER_NULL) || defined(JM_RENDERER_SOFTWARE)
+#define JM_RENDERER_HEADLESS
+#elif defined(JM_WINDOWS)
 #define JM_RENDERER_DX11
 #elif defined(JM_LINUX)
 #define JM_RENDERER_OPENGL
@@ -34,6 +41,42 @@ void jm_renderer_create_texture_resource(
 void jm_renderer_destroy_texture_resource(
 	jm_texture_resource resource);
 
+typedef struct jm_render_target_resource_desc
+{
+	const char* name;
+	uint32_t width;
+	uint32_t height;
+} jm_render_target_resource_desc;
+
+// Creates an R8G8B8A8 texture with a depth buffer that commands can draw 
+// into. The texture is cleared to transparent black.
+void jm_renderer_create_render_target_resource(
+	const jm_render_target_resource_desc* desc,
+	jm_render_target_resource* renderTarget,
+	jm_texture_resource* texture);
+
+typedef struct jm_mesh_resource_desc
+{
+	const char* name;
+	const jm_vertex* vertices;
+	const jm_texcoord* texcoords; // optional
+	const void* indices; // optional
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	bool isIndex32;
+} jm_mesh_resource_desc;
+
+// Creates static buffers holding the positions, followed by the texcoords if 
+// there are any, and the indices.
+void jm_renderer_create_mesh_resource(
+	const jm_mesh_resource_desc* desc,
+	jm_mesh_resource* mesh);
+
+// Releases the mesh's buffers. No command buffer that draws it may be waiting 
+// to be executed.
+void jm_renderer_destroy_mesh_resource(
+	jm_mesh_resource mesh);
+
 #if defined(JM_RENDERER_DX11)
 ID3D11Device* jm_renderer_get_device();
 
@@ -51,6 +94,22 @@ ID3D11BlendState* jm_renderer_get_blend_state(
 ID3D11RasterizerState* jm_renderer_get_rasterizer_state();
 
 ID3D11DepthStencilState* jm_renderer_get_depth_stencil_state();
+
+// Corners of a unit quad as a triangle strip, the vertices of instanced sprites.
+ID3D11Buffer* jm_renderer_get_unit_quad_buffer();
+
+ID3D11RenderTargetView* jm_renderer_get_render_target_view(
+	jm_render_target_resource renderTarget);
+
+ID3D11DepthStencilView* jm_renderer_get_render_target_depth_view(
+	jm_render_target_resource renderTarget);
+
+ID3D11Buffer* jm_renderer_get_mesh_vertex_buffer(
+	jm_mesh_resource mesh);
+
+// NULL if the mesh isn't indexed.
+ID3D11Buffer* jm_renderer_get_mesh_index_buffer(
+	jm_mesh_resource mesh);
 #endif
 
 jm_buffer_resource jm_renderer_get_dynamic_vertex_buffer();
@@ -60,7 +119,274 @@ void jm_renderer_set_shader_program(
 	jm_shader_program shaderProgram);
 
 #if defined(JM_RENDERER_OPENGL)
-GLuint jm_renderer_get_uniform_location(
+// Replaces a rectangle of an R8G8B8A8 texture, used to fill atlas pages.
+void jm_renderer_update_texture_resource(
+	jm_texture_resource resource,
+	uint32_t x,
+	uint32_t y,
+	uint32_t width,
+	uint32_t height,
+	const void* data);
+
+// Dynamic vertex and index data lives in a ring of regions, one per frame in 
+// flight. Each region is guarded by a fence, so the CPU can write to it with 
+// plain pointer bumps while the GPU reads from the others.
+typedef struct jm_dynamic_buffer_region
+{
+	uint8_t* data;
+	uint32_t offset;
+	uint32_t size;
+} jm_dynamic_buffer_region;
+
+void jm_renderer_begin_dynamic_buffers(
+	jm_dynamic_buffer_region* vertexRegion,
+	jm_dynamic_buffer_region* indexRegion);
+
+// Makes the data written to the current regions so far visible to the GPU. 
+// Must be called before drawing from newly written data.
+void jm_renderer_commit_dynamic_buffers(
+	uint32_t vertexDataSize,
+	uint32_t indexDataSize);
+
+void jm_renderer_end_dynamic_buffers();
+
+typedef struct jm_vertex_format_desc
+{
+	uint32_t stride;
+	uint32_t depthOffset;
+	uint32_t texcoordOffset;
+	uint32_t colorOffset;
+	bool hasTexcoord;
+	bool isPosition16;
+	bool isTexcoord16;
+} jm_vertex_format_desc;
+
+const jm_vertex_format_desc* jm_renderer_get_vertex_format_desc(
+	jm_vertex_format format);
+
+typedef enum jm_uniform
+{
+	JM_UNIFORM_TRANSFORM_INDEX,
+	JM_UNIFORM_VIEW_INDEX,
+	JM_UNIFORM_DEPTH,
+	JM_UNIFORM_TEXTURE,
+	JM_UNIFORM_COUNT,
+} jm_uniform;
+
+// Replaces the contents of the uniform buffer every program reads its 
+// transforms from.
+void jm_renderer_update_transform_palette(
+	const float (*transforms)[16],
+	uint32_t transformCount);
+
+// Replaces the contents of the uniform buffer every program reads its views 
+// from.
+void jm_renderer_update_view_palette(
+	const jm_view* views,
+	uint32_t viewCount);
+
+// State changes below go through a cache of the render context's state and 
+// are skipped when they wouldn't change anything.
+typedef struct jm_renderer_state_stats
+{
+	uint32_t stateChanges;
+	uint32_t elidedStateChanges;
+} jm_renderer_state_stats;
+
+void jm_renderer_bind_buffer(
+	GLenum target,
+	GLuint buffer);
+
+void jm_renderer_bind_texture(
+	GLuint texture);
+
+// Binds the render target for drawing, or the default framebuffer if 
+// renderTarget is NULL. Framebuffers aren't shared between contexts, so a 
+// target's framebuffer is created when it's first bound by the render thread.
+void jm_renderer_bind_render_target(
+	jm_render_target_resource renderTarget);
+
+// Makes jm_renderer_bind_render_target(NULL) bind the render target instead 
+// of the default framebuffer, or the default framebuffer again if 
+// renderTarget is NULL.
+void jm_renderer_set_default_render_target(
+	jm_render_target_resource renderTarget);
+
+// Copies the whole render target into the rectangle of the default 
+// framebuffer at (x, y), counted from the bottom left, with nearest 
+// filtering. The rest of the default framebuffer is cleared to black.
+void jm_renderer_blit_render_target(
+	jm_render_target_resource renderTarget,
+	int32_t x,
+	int32_t y,
+	int32_t width,
+	int32_t height);
+
+void jm_renderer_set_blend_state(
+	jm_blend_state blendState);
+
+void jm_renderer_set_depth_test(
+	bool enable);
+
+// The restart index is the largest value of the index type.
+void jm_renderer_set_primitive_restart(
+	bool enable,
+	GLenum indexType);
+
+// Binds the vertex array of the format, which sources attributes from the 
+// dynamic vertex buffer and indices from the dynamic index buffer.
+void jm_renderer_set_vertex_format(
+	jm_vertex_format format);
+
+// Binds the vertex array for instanced sprites: a static unit quad and 
+// jm_sprite instances from the dynamic vertex buffer. Returns the base 
+// instance to draw with, which is 0 when the context lacks 
+// GL_ARB_base_instance and the instance attributes start at baseInstance 
+// instead.
+uint32_t jm_renderer_set_sprite_vertex_format(
+	uint32_t baseInstance);
+
+// Binds the vertex array of the mesh, which sources positions and texcoords 
+// from its static buffers and indices from its index buffer. Meshes have no 
+// per-vertex depth or color, those attributes are set to depth and color for 
+// the following draws. Vertex arrays aren't shared between contexts, so the 
+// mesh's vertex array is created when it's first bound by the render thread.
+void jm_renderer_set_mesh_vertex_format(
+	jm_mesh_resource mesh,
+	float depth,
+	uint32_t color);
+
+// Forgets which vertex array is bound, so the next vertex format binds its own 
+// instead of sharing state with the mesh that was drawn last.
+void jm_renderer_invalidate_vertex_format();
+
+// Selects the palette entry the program transforms vertices with.
+void jm_renderer_set_transform_index(
 	jm_shader_program shaderProgram,
-	const GLchar* name);
-#endif
\ No newline at end of file
+	uint32_t transformIndex);
+
+// Selects the view palette entry the program projects vertices with. The 
+// viewport is set separately.
+void jm_renderer_set_view_index(
+	jm_shader_program shaderProgram,
+	uint32_t viewIndex);
+
+// Sets the clip-space z of programs whose vertices carry no depth.
+void jm_renderer_set_depth(
+	jm_shader_program shaderProgram,
+	float depth);
+
+void jm_renderer_get_state_stats(
+	jm_renderer_state_stats* stats);
+
+void jm_renderer_reset_state_stats();
+
+// Pixels are read back through a ring of pixel buffers, each guarded by a 
+// fence, so a readback is only copied out once the GPU has finished it and 
+// glReadPixels doesn't wait for the frame to be drawn.
+#define JM_READBACK_BUFFER_COUNT 3
+
+typedef struct jm_readback
+{
+	// RGBA8, rows bottom up, allocated with malloc and owned by the caller
+	uint32_t* pixels;
+	uint32_t width;
+	uint32_t height;
+	void* userData;
+} jm_readback;
+
+// Starts reading back a rectangle of the bound framebuffer, counted from the 
+// bottom left. Returns false if every buffer of the ring is in flight.
+bool jm_renderer_begin_readback(
+	int32_t x,
+	int32_t y,
+	uint32_t width,
+	uint32_t height,
+	void* userData);
+
+// Copies out the oldest readback if the GPU has finished it, or waits for it 
+// if wait is true. Returns false if there's none to copy out.
+bool jm_renderer_end_readback(
+	bool wait,
+	jm_readback* readback);
+#endif
+
+#if defined(JM_RENDERER_NULL)
+// Work submitted to the null renderer since the last reset, and the textures 
+// that currently exist.
+typedef struct jm_renderer_null_stats
+{
+	uint64_t frameCount;
+	uint64_t commandCount;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	uint64_t spriteCount;
+	uint64_t characterCount;
+	uint64_t textureCount;
+	uint64_t textureSize; // bytes of texture data
+} jm_renderer_null_stats;
+
+extern jm_renderer_null_stats g_nullRendererStats;
+
+void jm_renderer_reset_null_stats();
+#endif
+
+#if defined(JM_RENDERER_SOFTWARE)
+// Sets the size of the framebuffer in pixels. Must be called before 
+// jm_renderer_init.
+void jm_renderer_set_framebuffer_size(
+	uint32_t width,
+	uint32_t height);
+
+void jm_renderer_get_framebuffer_size(
+	uint32_t* width,
+	uint32_t* height);
+
+// Fills the current target with an RGBA8 color and resets its depth buffer.
+void jm_renderer_clear(
+	uint32_t color);
+
+// Draws into the render target from now on, or into the framebuffer if 
+// renderTarget is 0. Triangles allocated so far must have been rasterized.
+void jm_renderer_set_render_target(
+	jm_render_target_resource renderTarget);
+
+// Writes the framebuffer as an RGBA PNG, each pixel scaled up to scale by 
+// scale pixels.
+bool jm_renderer_write_png(
+	const char* path,
+	uint32_t scale);
+
+// Copies the framebuffer's RGBA8 pixels to dst, rows top down.
+void jm_renderer_read_framebuffer(
+	uint32_t* dst);
+
+// A vertex in framebuffer pixels, with its texcoord and RGBA color.
+typedef struct jm_raster_vertex
+{
+	float x, y;
+	float u, v;
+	float r, g, b, a;
+} jm_raster_vertex;
+
+typedef struct jm_raster_triangle
+{
+	jm_raster_vertex vertices[3];
+	float depth; // clip-space z
+	jm_texture_resource texture; // 0 if untextured
+	uint8_t blendState;
+	uint8_t depthTest : 1;
+	uint8_t alphaTest : 1; // discards texels with zero alpha
+	uint16_t scissor[4]; // left, top, right and bottom in pixels, exclusive
+} jm_raster_triangle;
+
+// Returns space for count triangles, which are rasterized in the order they 
+// were allocated by the next jm_renderer_rasterize. The pointer is valid 
+// until the next allocation.
+jm_raster_triangle* jm_renderer_alloc_triangles(
+	uint32_t count);
+
+// Rasterizes the triangles allocated since the last call. Rows are split into 
+// bands that are rasterized in parallel.
+void jm_renderer_rasterize();
+#endif
@@ -1,5 +1,6 @@
-#if defined(JM_WINDOWS)
+#if defined(JM_WINDOWS) && !defined(JM_RENDERER_NULL) && !defined(JM_RENDERER_SOFTWARE)
 #include "renderer.h"
+#include "render_commands.h"
 
 #include <jammy/log.h>
 #include <jammy/assert.h>
@@ -10,11 +11,25 @@
 #include <jammy/shaders/dx11/texture.ps.h>
 #include <jammy/shaders/dx11/text.vs.h>
 #include <jammy/shaders/dx11/text.ps.h>
+#include <jammy/shaders/dx11/color_vertex_color.vs.h>
+#include <jammy/shaders/dx11/color_vertex_color.ps.h>
+#include <jammy/shaders/dx11/texture_vertex_color.vs.h>
+#include <jammy/shaders/dx11/texture_vertex_color.ps.h>
+#include <jammy/shaders/dx11/sprite.vs.h>
+#include <jammy/shaders/dx11/sprite.ps.h>
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 typedef enum jm_input_layout
 {
 	JM_INPUT_LAYOUT_POS,
 	JM_INPUT_LAYOUT_POS_UV,
+	JM_INPUT_LAYOUT_POS_COLOR,
+	JM_INPUT_LAYOUT_POS_UV_COLOR,
+	JM_INPUT_LAYOUT_POS_UV_DEPTH,
+	JM_INPUT_LAYOUT_SPRITE,
 	JM_INPUT_LAYOUT_COUNT,
 } jm_input_layout;
 
@@ -32,6 +47,7 @@ typedef struct jm_renderer
 
 	ID3D11Buffer* dynamicVertexBuffer;
 	ID3D11Buffer* dynamicIndexBuffer;
+	ID3D11Buffer* unitQuadBuffer;
 
 	ID3D11Buffer* constantBuffers[JM_CONSTANT_BUFFER_COUNT];
 
@@ -48,6 +64,18 @@ typedef struct jm_renderer
 
 static jm_renderer g_renderer;
 
+struct jm_render_target
+{
+	ID3D11RenderTargetView* renderTargetView;
+	ID3D11DepthStencilView* depthStencilView;
+};
+
+struct jm_mesh
+{
+	ID3D11Buffer* vertexBuffer;
+	ID3D11Buffer* indexBuffer;
+};
+
 static void jm_create_shader_program(
 	jm_shader_program shaderProgram, 
 	jm_input_layout inputLayout,
@@ -123,12 +151,36 @@ int jm_renderer_init()
 
 	jm_create_shader_program(
 		JM_SHADER_PROGRAM_TEXT,
-		JM_INPUT_LAYOUT_POS_UV,
+		JM_INPUT_LAYOUT_POS_UV_DEPTH,
 		jm_embedded_vs_text,
 		sizeof(jm_embedded_vs_text),
 		jm_embedded_ps_text,
 		sizeof(jm_embedded_ps_text));
 
+	jm_create_shader_program(
+		JM_SHADER_PROGRAM_COLOR_VERTEX_COLOR,
+		JM_INPUT_LAYOUT_POS_COLOR,
+		jm_embedded_vs_color_vertex_color,
+		sizeof(jm_embedded_vs_color_vertex_color),
+		jm_embedded_ps_color_vertex_color,
+		sizeof(jm_embedded_ps_color_vertex_color));
+
+	jm_create_shader_program(
+		JM_SHADER_PROGRAM_TEXTURE_VERTEX_COLOR,
+		JM_INPUT_LAYOUT_POS_UV_COLOR,
+		jm_embedded_vs_texture_vertex_color,
+		sizeof(jm_embedded_vs_texture_vertex_color),
+		jm_embedded_ps_texture_vertex_color,
+		sizeof(jm_embedded_ps_texture_vertex_color));
+
+	jm_create_shader_program(
+		JM_SHADER_PROGRAM_SPRITE,
+		JM_INPUT_LAYOUT_SPRITE,
+		jm_embedded_vs_sprite,
+		sizeof(jm_embedded_vs_sprite),
+		jm_embedded_ps_sprite,
+		sizeof(jm_embedded_ps_sprite));
+
 	{
 		const D3D11_INPUT_ELEMENT_DESC elements[] = {
 			{ "Position", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
@@ -154,6 +206,66 @@ int jm_renderer_init()
 			sizeof(jm_embedded_vs_texture),
 			&g_renderer.inputLayouts[JM_INPUT_LAYOUT_POS_UV]);
 	}
+	{
+		// vertex colors are bound to the third stream
+		const D3D11_INPUT_ELEMENT_DESC elements[] = {
+			{ "Position", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "Color", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 2, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		g_renderer.device->lpVtbl->CreateInputLayout(
+			g_renderer.device, 
+			elements, 
+			_countof(elements), 
+			jm_embedded_vs_color_vertex_color, 
+			sizeof(jm_embedded_vs_color_vertex_color), 
+			&g_renderer.inputLayouts[JM_INPUT_LAYOUT_POS_COLOR]);
+	}
+	{
+		const D3D11_INPUT_ELEMENT_DESC elements[] = {
+			{ "Position", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "Texcoord", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "Color", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 2, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		g_renderer.device->lpVtbl->CreateInputLayout(
+			g_renderer.device, 
+			elements, 
+			_countof(elements), 
+			jm_embedded_vs_texture_vertex_color, 
+			sizeof(jm_embedded_vs_texture_vertex_color),
+			&g_renderer.inputLayouts[JM_INPUT_LAYOUT_POS_UV_COLOR]);
+	}
+	{
+		// batched texts have a depth per vertex in the third stream
+		const D3D11_INPUT_ELEMENT_DESC elements[] = {
+			{ "Position", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "Texcoord", 0, DXGI_FORMAT_R32G32_FLOAT, 1, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "Depth", 0, DXGI_FORMAT_R32_FLOAT, 2, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		};
+		g_renderer.device->lpVtbl->CreateInputLayout(
+			g_renderer.device, 
+			elements, 
+			_countof(elements), 
+			jm_embedded_vs_text, 
+			sizeof(jm_embedded_vs_text),
+			&g_renderer.inputLayouts[JM_INPUT_LAYOUT_POS_UV_DEPTH]);
+	}
+	{
+		// unit quad corners in the first stream, jm_sprite instances in the second
+		const D3D11_INPUT_ELEMENT_DESC elements[] = {
+			{ "Position", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "InstanceRect", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, offsetof(jm_sprite, x), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "InstanceTexcoordRect", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 1, offsetof(jm_sprite, u0), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "InstanceColor", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, offsetof(jm_sprite, color), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "InstanceRotation", 0, DXGI_FORMAT_R32_FLOAT, 1, offsetof(jm_sprite, rotation), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		};
+		g_renderer.device->lpVtbl->CreateInputLayout(
+			g_renderer.device, 
+			elements, 
+			_countof(elements), 
+			jm_embedded_vs_sprite, 
+			sizeof(jm_embedded_vs_sprite),
+			&g_renderer.inputLayouts[JM_INPUT_LAYOUT_SPRITE]);
+	}
 
 	{
 		D3D11_BUFFER_DESC bd;
@@ -169,6 +281,27 @@ int jm_renderer_init()
 		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.dynamicIndexBuffer);
 	}
 
+	{
+		static const float unitQuad[] = {
+			0.0f, 0.0f,
+			1.0f, 0.0f,
+			0.0f, 1.0f,
+			1.0f, 1.0f,
+		};
+
+		D3D11_BUFFER_DESC bd;
+		ZeroMemory(&bd, sizeof(bd));
+		bd.ByteWidth = sizeof(unitQuad);
+		bd.Usage = D3D11_USAGE_IMMUTABLE;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+		D3D11_SUBRESOURCE_DATA data;
+		ZeroMemory(&data, sizeof(data));
+		data.pSysMem = unitQuad;
+
+		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, &data, &g_renderer.unitQuadBuffer);
+	}
+
 	// create constant buffers
 	{
 		D3D11_BUFFER_DESC bd;
@@ -178,10 +311,16 @@ int jm_renderer_init()
 		bd.Usage = D3D11_USAGE_DYNAMIC;
 		bd.ByteWidth = 64;
 
-		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_VIEW_VS]);
 		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_VIEW_PS]);
 		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_INSTANCE_VS]);
 		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_INSTANCE_PS]);
+
+		// the per frame constants hold the frame's transform palette, the per 
+		// view constants its view palette
+		bd.ByteWidth = sizeof(float[16]) * JM_TRANSFORM_PALETTE_SIZE;
+		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_FRAME_VS]);
+		bd.ByteWidth = sizeof(jm_view) * JM_VIEW_PALETTE_SIZE;
+		g_renderer.device->lpVtbl->CreateBuffer(g_renderer.device, &bd, NULL, &g_renderer.constantBuffers[JM_CONSTANT_BUFFER_PER_VIEW_VS]);
 	}
 
 	{
@@ -346,6 +485,11 @@ ID3D11Buffer* jm_renderer_get_dynamic_index_buffer()
 	return g_renderer.dynamicIndexBuffer;
 }
 
+ID3D11Buffer* jm_renderer_get_unit_quad_buffer()
+{
+	return g_renderer.unitQuadBuffer;
+}
+
 void jm_renderer_set_shader_program(
 	jm_shader_program shaderProgram)
 {
@@ -407,4 +551,126 @@ void jm_renderer_destroy_texture_resource(
 {
 	resource->lpVtbl->Release(resource);
 }
+
+void jm_renderer_create_render_target_resource(
+	const jm_render_target_resource_desc* desc,
+	jm_render_target_resource* renderTarget,
+	jm_texture_resource* texture)
+{
+	ID3D11Device* d3ddev = jm_renderer_get_device();
+
+	D3D11_TEXTURE2D_DESC colorDesc;
+	colorDesc.ArraySize = 1;
+	colorDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	colorDesc.CPUAccessFlags = 0;
+	colorDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	colorDesc.MipLevels = 1;
+	colorDesc.MiscFlags = 0;
+	colorDesc.SampleDesc.Count = 1;
+	colorDesc.SampleDesc.Quality = 0;
+	colorDesc.Usage = D3D11_USAGE_DEFAULT;
+	colorDesc.Width = desc->width;
+	colorDesc.Height = desc->height;
+
+	D3D11_TEXTURE2D_DESC depthDesc = colorDesc;
+	depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+	depthDesc.Format = DXGI_FORMAT_D32_FLOAT;
+
+	// default textures are zeroed, so the target starts out transparent black
+	ID3D11Texture2D* colorBuffer;
+	ID3D11Texture2D* depthBuffer;
+	d3ddev->lpVtbl->CreateTexture2D(d3ddev, &colorDesc, NULL, &colorBuffer);
+	d3ddev->lpVtbl->CreateTexture2D(d3ddev, &depthDesc, NULL, &depthBuffer);
+
+	struct jm_render_target* target = malloc(sizeof(struct jm_render_target));
+	d3ddev->lpVtbl->CreateShaderResourceView(d3ddev, (ID3D11Resource*)colorBuffer, NULL, texture);
+	d3ddev->lpVtbl->CreateRenderTargetView(d3ddev, (ID3D11Resource*)colorBuffer, NULL, &target->renderTargetView);
+	d3ddev->lpVtbl->CreateDepthStencilView(d3ddev, (ID3D11Resource*)depthBuffer, NULL, &target->depthStencilView);
+
+#if defined(JM_DEBUG)
+	colorBuffer->lpVtbl->SetPrivateData(colorBuffer, &WKPDID_D3DDebugObjectName, (UINT)strlen(desc->name), desc->name);
+#endif
+	colorBuffer->lpVtbl->Release(colorBuffer);
+	depthBuffer->lpVtbl->Release(depthBuffer);
+	*renderTarget = target;
+}
+
+ID3D11RenderTargetView* jm_renderer_get_render_target_view(
+	jm_render_target_resource renderTarget)
+{
+	return renderTarget->renderTargetView;
+}
+
+ID3D11DepthStencilView* jm_renderer_get_render_target_depth_view(
+	jm_render_target_resource renderTarget)
+{
+	return renderTarget->depthStencilView;
+}
+void jm_renderer_create_mesh_resource(
+	const jm_mesh_resource_desc* desc,
+	jm_mesh_resource* mesh)
+{
+	ID3D11Device* d3ddev = jm_renderer_get_device();
+
+	const uint32_t positionSize = sizeof(jm_vertex) * desc->vertexCount;
+	const uint32_t texcoordSize = (desc->texcoords != NULL) ? sizeof(jm_texcoord) * desc->vertexCount : 0;
+	uint8_t* vertexData = malloc(positionSize + texcoordSize);
+	memcpy(vertexData, desc->vertices, positionSize);
+	if (desc->texcoords != NULL)
+	{
+		memcpy(vertexData + positionSize, desc->texcoords, texcoordSize);
+	}
+
+	D3D11_BUFFER_DESC bd;
+	ZeroMemory(&bd, sizeof(bd));
+	bd.ByteWidth = positionSize + texcoordSize;
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+	D3D11_SUBRESOURCE_DATA data;
+	ZeroMemory(&data, sizeof(data));
+	data.pSysMem = vertexData;
+
+	struct jm_mesh* resource = malloc(sizeof(struct jm_mesh));
+	d3ddev->lpVtbl->CreateBuffer(d3ddev, &bd, &data, &resource->vertexBuffer);
+	free(vertexData);
+
+	resource->indexBuffer = NULL;
+	if (desc->indices != NULL)
+	{
+		const uint32_t indexSize = desc->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+		bd.ByteWidth = indexSize * desc->indexCount;
+		bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		data.pSysMem = desc->indices;
+		d3ddev->lpVtbl->CreateBuffer(d3ddev, &bd, &data, &resource->indexBuffer);
+	}
+
+#if defined(JM_DEBUG)
+	resource->vertexBuffer->lpVtbl->SetPrivateData(resource->vertexBuffer, &WKPDID_D3DDebugObjectName, (UINT)strlen(desc->name), desc->name);
+#endif
+	*mesh = resource;
+}
+
+void jm_renderer_destroy_mesh_resource(
+	jm_mesh_resource mesh)
+{
+	mesh->vertexBuffer->lpVtbl->Release(mesh->vertexBuffer);
+	if (mesh->indexBuffer != NULL)
+	{
+		mesh->indexBuffer->lpVtbl->Release(mesh->indexBuffer);
+	}
+	free(mesh);
+}
+
+ID3D11Buffer* jm_renderer_get_mesh_vertex_buffer(
+	jm_mesh_resource mesh)
+{
+	return mesh->vertexBuffer;
+}
+
+ID3D11Buffer* jm_renderer_get_mesh_index_buffer(
+	jm_mesh_resource mesh)
+{
+	return mesh->indexBuffer;
+}
 #endif
\ No newline at end of file
@@ -0,0 +1,111 @@
+#if defined(JM_RENDERER_NULL)
+#include "renderer.h"
+#include "render_commands.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+jm_renderer_null_stats g_nullRendererStats;
+
+// texture sizes by resource, so destroying a texture can update the totals
+static struct
+{
+	uint64_t* textureSizes;
+	uint32_t textureCapacity;
+	uint32_t nextTexture;
+	uint32_t nextMesh;
+} g_renderer;
+
+int jm_renderer_init()
+{
+	memset(&g_nullRendererStats, 0, sizeof(g_nullRendererStats));
+	return 0;
+}
+
+void jm_renderer_reset_null_stats()
+{
+	const uint64_t textureCount = g_nullRendererStats.textureCount;
+	const uint64_t textureSize = g_nullRendererStats.textureSize;
+	memset(&g_nullRendererStats, 0, sizeof(g_nullRendererStats));
+	g_nullRendererStats.textureCount = textureCount;
+	g_nullRendererStats.textureSize = textureSize;
+}
+
+void jm_renderer_create_texture_resource(
+	const jm_texture_resource_desc* desc,
+	jm_texture_resource* resource)
+{
+	// 0 is never handed out, like GL texture names
+	const uint32_t name = ++g_renderer.nextTexture;
+	if (name >= g_renderer.textureCapacity)
+	{
+		const uint32_t capacity = (g_renderer.textureCapacity > 0) ? g_renderer.textureCapacity * 2 : 64;
+		g_renderer.textureSizes = realloc(g_renderer.textureSizes, sizeof(uint64_t) * capacity);
+		memset(g_renderer.textureSizes + g_renderer.textureCapacity, 0, sizeof(uint64_t) * (capacity - g_renderer.textureCapacity));
+		g_renderer.textureCapacity = capacity;
+	}
+
+	const uint64_t texelSize = (desc->format == JM_TEXTURE_FORMAT_R8) ? 1 : 4;
+	g_renderer.textureSizes[name] = (uint64_t)desc->width * desc->height * texelSize;
+
+	++g_nullRendererStats.textureCount;
+	g_nullRendererStats.textureSize += g_renderer.textureSizes[name];
+	*resource = name;
+}
+
+void jm_renderer_destroy_texture_resource(
+	jm_texture_resource resource)
+{
+	if (resource == 0 || resource >= g_renderer.textureCapacity)
+	{
+		return;
+	}
+
+	--g_nullRendererStats.textureCount;
+	g_nullRendererStats.textureSize -= g_renderer.textureSizes[resource];
+	g_renderer.textureSizes[resource] = 0;
+}
+
+void jm_renderer_create_render_target_resource(
+	const jm_render_target_resource_desc* desc,
+	jm_render_target_resource* renderTarget,
+	jm_texture_resource* texture)
+{
+	jm_texture_resource_desc textureDesc;
+	textureDesc.name = desc->name;
+	textureDesc.width = desc->width;
+	textureDesc.height = desc->height;
+	textureDesc.format = JM_TEXTURE_FORMAT_R8G8B8A8;
+	textureDesc.data = NULL;
+	jm_renderer_create_texture_resource(&textureDesc, texture);
+	*renderTarget = *texture;
+}
+
+void jm_renderer_create_mesh_resource(
+	const jm_mesh_resource_desc* desc,
+	jm_mesh_resource* mesh)
+{
+	// commands read the geometry from the mesh's own copy
+	*mesh = ++g_renderer.nextMesh;
+}
+
+void jm_renderer_destroy_mesh_resource(
+	jm_mesh_resource mesh)
+{
+}
+
+jm_buffer_resource jm_renderer_get_dynamic_vertex_buffer()
+{
+	return 0;
+}
+
+jm_buffer_resource jm_renderer_get_dynamic_index_buffer()
+{
+	return 0;
+}
+
+void jm_renderer_set_shader_program(
+	jm_shader_program shaderProgram)
+{
+}
+#endif
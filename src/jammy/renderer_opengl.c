@@ -1,10 +1,14 @@
-#if defined(JM_LINUX)
+#if defined(JM_LINUX) && !defined(JM_RENDERER_NULL) && !defined(JM_RENDERER_SOFTWARE)
 #include "renderer.h"
+#include "render_commands.h"
 
 #include <GL/glew.h>
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
 #include <jammy/shaders/opengl/color.vs.h>
@@ -13,17 +17,156 @@
 #include <jammy/shaders/opengl/texture.fs.h>
 #include <jammy/shaders/opengl/text.vs.h>
 #include <jammy/shaders/opengl/text.fs.h>
+#include <jammy/shaders/opengl/sprite.vs.h>
+
+#define JM_DYNAMIC_BUFFER_REGION_COUNT 3
+#define JM_DYNAMIC_VERTEX_BUFFER_REGION_SIZE (16 * 1024 * 1024)
+#define JM_DYNAMIC_INDEX_BUFFER_REGION_SIZE (4 * 1024 * 1024)
+#define JM_UNIFORM_BLOCK_BINDING_TRANSFORMS 0
+#define JM_UNIFORM_BLOCK_BINDING_VIEWS 1
+
+typedef struct jm_dynamic_buffer
+{
+    GLuint buffer;
+    uint32_t regionSize;
+    // persistent mapping of all regions, or staging memory for one region 
+    // when the buffer is orphaned every frame instead
+    uint8_t* data;
+    uint32_t committedSize;
+} jm_dynamic_buffer;
+
+typedef struct jm_readback_buffer
+{
+    GLuint buffer;
+    // size of the buffer's storage, which is reallocated when a readback 
+    // needs a different size
+    uint32_t size;
+    GLsync fence;
+    uint32_t width;
+    uint32_t height;
+    void* userData;
+} jm_readback_buffer;
+
+#define JM_STATE_UNKNOWN 0xffffffffu
+
+typedef enum jm_vertex_attrib
+{
+    JM_VERTEX_ATTRIB_POSITION,
+    JM_VERTEX_ATTRIB_TEXCOORD,
+    JM_VERTEX_ATTRIB_COLOR,
+    JM_VERTEX_ATTRIB_DEPTH,
+    // per instance
+    JM_VERTEX_ATTRIB_INSTANCE_RECT,
+    JM_VERTEX_ATTRIB_INSTANCE_TEXCOORD_RECT,
+    JM_VERTEX_ATTRIB_INSTANCE_COLOR,
+    JM_VERTEX_ATTRIB_INSTANCE_ROTATION,
+    JM_VERTEX_ATTRIB_COUNT,
+} jm_vertex_attrib;
+
+static const GLchar* const g_vertexAttribNames[] = 
+{
+    "vertexPos",
+    "vertexTexcoord",
+    "vertexColor",
+    "vertexDepth",
+    "instanceRect",
+    "instanceTexcoordRect",
+    "instanceColor",
+    "instanceRotation",
+};
+
+// position, depth, [texcoord], color
+static const jm_vertex_format_desc g_vertexFormats[] = 
+{
+    { 16, 8, 0, 12, false, false, false }, // JM_VERTEX_FORMAT_POSITION_COLOR
+    { 12, 4, 0, 8, false, true, false }, // JM_VERTEX_FORMAT_POSITION16_COLOR
+    { 24, 8, 12, 20, true, false, false }, // JM_VERTEX_FORMAT_POSITION_TEXCOORD_COLOR
+    { 20, 8, 12, 16, true, false, true }, // JM_VERTEX_FORMAT_POSITION_TEXCOORD16_COLOR
+    { 20, 4, 8, 16, true, true, false }, // JM_VERTEX_FORMAT_POSITION16_TEXCOORD_COLOR
+    { 16, 4, 8, 12, true, true, true }, // JM_VERTEX_FORMAT_POSITION16_TEXCOORD16_COLOR
+};
+
+static const GLchar* const g_uniformNames[] = 
+{
+    "g_transformIndex",
+    "g_viewIndex",
+    "g_depth",
+    "g_texture",
+};
+
+typedef struct jm_state_cache
+{
+    GLuint program;
+    GLuint arrayBuffer;
+    GLuint elementArrayBuffer;
+    GLuint vertexArray;
+    GLuint texture;
+    uint32_t blendState;
+    uint32_t depthTest;
+    uint32_t primitiveRestart;
+
+    uint32_t transformIndex[JM_SHADER_PROGRAM_COUNT];
+    uint32_t viewIndex[JM_SHADER_PROGRAM_COUNT];
+    uint32_t depth[JM_SHADER_PROGRAM_COUNT];
+
+    jm_renderer_state_stats stats;
+} jm_state_cache;
 
 typedef struct jm_renderer
 {
-    GLuint dynamicVertexBuffer;
-    GLuint dynamicIndexBuffer;
+    jm_dynamic_buffer dynamicVertexBuffer;
+    jm_dynamic_buffer dynamicIndexBuffer;
+    bool isPersistentlyMapped;
+    // GL_ARB_base_instance, core in OpenGL 4.2
+    bool hasBaseInstance;
+    uint32_t regionIndex;
+    GLsync regionFences[JM_DYNAMIC_BUFFER_REGION_COUNT];
 
     GLuint shaderPrograms[JM_SHADER_PROGRAM_COUNT];
+    GLint uniformLocations[JM_SHADER_PROGRAM_COUNT][JM_UNIFORM_COUNT];
+    GLuint vertexArrays[JM_VERTEX_FORMAT_COUNT];
+    GLuint spriteVertexArray;
+    GLuint unitQuadBuffer;
+    GLuint transformBuffer;
+    GLuint viewBuffer;
+    // bound instead of the default framebuffer, NULL if there is none
+    jm_render_target_resource defaultRenderTarget;
+
+    // readbacks in flight, the oldest at firstReadback
+    jm_readback_buffer readbackBuffers[JM_READBACK_BUFFER_COUNT];
+    uint32_t firstReadback;
+    uint32_t readbackCount;
+
+    // vertex arrays of destroyed meshes, which aren't shared between contexts 
+    // and are deleted by the render thread that created them
+    GLuint* deadVertexArrays;
+    uint32_t deadVertexArrayCount;
+    uint32_t deadVertexArrayCapacity;
+
+    jm_state_cache state;
 } jm_renderer;
 
 jm_renderer g_renderer;
 
+struct jm_render_target
+{
+    GLuint texture;
+    GLuint depthBuffer;
+    uint32_t width;
+    uint32_t height;
+    // created by the first bind, 0 until then
+    GLuint framebuffer;
+};
+
+struct jm_mesh
+{
+    GLuint vertexBuffer;
+    GLuint indexBuffer; // 0 if the mesh isn't indexed
+    uint32_t texcoordOffset; // 0 if the mesh has no texcoords
+    // created by the first bind, 0 until then
+    GLuint vertexArray;
+};
+
 void load_shader_program(
     jm_shader_program shaderProgram,
     const char* vertexShaderCode, 
@@ -76,6 +219,12 @@ void load_shader_program(
 	glAttachShader(program, vertexShader);
 	glAttachShader(program, fragmentShader);
 
+    // fixed attribute locations so one vertex array per format works with every program
+    for (int i = 0; i < JM_VERTEX_ATTRIB_COUNT; ++i)
+    {
+        glBindAttribLocation(program, i, g_vertexAttribNames[i]);
+    }
+
 	glLinkProgram(program);
 
 	// Check the program
@@ -96,6 +245,60 @@ void load_shader_program(
 	glDeleteShader(fragmentShader);
 
     g_renderer.shaderPrograms[shaderProgram] = program;
+
+    // resolve uniform locations up front, -1 if the program doesn't use it
+    for (int i = 0; i < JM_UNIFORM_COUNT; ++i)
+    {
+        g_renderer.uniformLocations[shaderProgram][i] = glGetUniformLocation(program, g_uniformNames[i]);
+    }
+
+    const GLuint transformsBlock = glGetUniformBlockIndex(program, "Transforms");
+    if (transformsBlock != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program, transformsBlock, JM_UNIFORM_BLOCK_BINDING_TRANSFORMS);
+    }
+
+    const GLuint viewsBlock = glGetUniformBlockIndex(program, "Views");
+    if (viewsBlock != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(program, viewsBlock, JM_UNIFORM_BLOCK_BINDING_VIEWS);
+    }
+}
+
+static void jm_state_cache_init(
+    jm_state_cache* state)
+{
+    state->program = JM_STATE_UNKNOWN;
+    state->arrayBuffer = JM_STATE_UNKNOWN;
+    state->elementArrayBuffer = JM_STATE_UNKNOWN;
+    state->vertexArray = JM_STATE_UNKNOWN;
+    state->texture = JM_STATE_UNKNOWN;
+    state->blendState = JM_STATE_UNKNOWN;
+    state->depthTest = JM_STATE_UNKNOWN;
+    state->primitiveRestart = JM_STATE_UNKNOWN;
+    for (int i = 0; i < JM_SHADER_PROGRAM_COUNT; ++i)
+    {
+        state->transformIndex[i] = JM_STATE_UNKNOWN;
+        state->viewIndex[i] = JM_STATE_UNKNOWN;
+        state->depth[i] = JM_STATE_UNKNOWN;
+    }
+    state->stats.stateChanges = 0;
+    state->stats.elidedStateChanges = 0;
+}
+
+// Updates a cached value and returns true if the state has to be set.
+static bool jm_state_cache_update(
+    uint32_t* cached,
+    uint32_t value)
+{
+    if (*cached == value)
+    {
+        ++g_renderer.state.stats.elidedStateChanges;
+        return false;
+    }
+    *cached = value;
+    ++g_renderer.state.stats.stateChanges;
+    return true;
 }
 
 void GLAPIENTRY
@@ -159,25 +362,220 @@ MessageCallback(
     printf("\n");
 }
 
+// Dynamic buffers are written through the copy write binding, binding the 
+// index buffer to the element array binding would change whichever vertex 
+// array is bound, like a mesh's.
+static void jm_dynamic_buffer_init(
+    jm_dynamic_buffer* db,
+    uint32_t regionSize,
+    bool isPersistentlyMapped)
+{
+    db->regionSize = regionSize;
+    db->committedSize = 0;
+
+    glGenBuffers(1, &db->buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, db->buffer);
+
+    if (isPersistentlyMapped)
+    {
+        const GLsizeiptr size = (GLsizeiptr)regionSize * JM_DYNAMIC_BUFFER_REGION_COUNT;
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        db->data = glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, regionSize, NULL, GL_STREAM_DRAW);
+        db->data = malloc(regionSize);
+    }
+}
+
+static void jm_dynamic_buffer_begin(
+    jm_dynamic_buffer* db,
+    uint32_t regionIndex,
+    jm_dynamic_buffer_region* region)
+{
+    db->committedSize = 0;
+
+    if (g_renderer.isPersistentlyMapped)
+    {
+        region->data = db->data + (size_t)regionIndex * db->regionSize;
+        region->offset = regionIndex * db->regionSize;
+    }
+    else
+    {
+        // orphan the previous storage so we don't wait for draws that use it
+        glBindBuffer(GL_COPY_WRITE_BUFFER, db->buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, db->regionSize, NULL, GL_STREAM_DRAW);
+        region->data = db->data;
+        region->offset = 0;
+    }
+    region->size = db->regionSize;
+}
+
+static void jm_dynamic_buffer_commit(
+    jm_dynamic_buffer* db,
+    uint32_t size)
+{
+    if (g_renderer.isPersistentlyMapped || size <= db->committedSize)
+    {
+        // coherent mappings need no explicit upload
+        return;
+    }
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, db->buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, db->committedSize, size - db->committedSize, db->data + db->committedSize);
+    db->committedSize = size;
+}
+
+// Points the instance attributes of the bound sprite vertex array at the 
+// instance, with the dynamic vertex buffer bound as the array buffer.
+static void jm_sprite_vertex_array_set_first_instance(
+    uint32_t firstInstance)
+{
+    const GLsizei stride = sizeof(jm_sprite);
+    const size_t offset = (size_t)firstInstance * sizeof(jm_sprite);
+    glVertexAttribPointer(JM_VERTEX_ATTRIB_INSTANCE_RECT, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(jm_sprite, x)));
+    glVertexAttribPointer(JM_VERTEX_ATTRIB_INSTANCE_TEXCOORD_RECT, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(offset + offsetof(jm_sprite, u0)));
+    glVertexAttribPointer(JM_VERTEX_ATTRIB_INSTANCE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(offset + offsetof(jm_sprite, color)));
+    glVertexAttribPointer(JM_VERTEX_ATTRIB_INSTANCE_ROTATION, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(jm_sprite, rotation)));
+}
+
+static void jm_vertex_arrays_init()
+{
+    const GLuint vertexBuffer = g_renderer.dynamicVertexBuffer.buffer;
+    const GLuint indexBuffer = g_renderer.dynamicIndexBuffer.buffer;
+
+    glGenVertexArrays(JM_VERTEX_FORMAT_COUNT, g_renderer.vertexArrays);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    for (int i = 0; i < JM_VERTEX_FORMAT_COUNT; ++i)
+    {
+        const jm_vertex_format_desc* desc = &g_vertexFormats[i];
+        const GLsizei stride = (GLsizei)desc->stride;
+
+        glBindVertexArray(g_renderer.vertexArrays[i]);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+        // offsets are relative to the base vertex of each draw
+        glEnableVertexAttribArray(JM_VERTEX_ATTRIB_POSITION);
+        if (desc->isPosition16)
+        {
+            glVertexAttribPointer(JM_VERTEX_ATTRIB_POSITION, 2, GL_SHORT, GL_FALSE, stride, (void*)0);
+        }
+        else
+        {
+            glVertexAttribPointer(JM_VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        }
+
+        glEnableVertexAttribArray(JM_VERTEX_ATTRIB_DEPTH);
+        glVertexAttribPointer(JM_VERTEX_ATTRIB_DEPTH, 1, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)desc->depthOffset);
+
+        if (desc->hasTexcoord)
+        {
+            glEnableVertexAttribArray(JM_VERTEX_ATTRIB_TEXCOORD);
+            if (desc->isTexcoord16)
+            {
+                glVertexAttribPointer(JM_VERTEX_ATTRIB_TEXCOORD, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(size_t)desc->texcoordOffset);
+            }
+            else
+            {
+                glVertexAttribPointer(JM_VERTEX_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)desc->texcoordOffset);
+            }
+        }
+
+        glEnableVertexAttribArray(JM_VERTEX_ATTRIB_COLOR);
+        glVertexAttribPointer(JM_VERTEX_ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)desc->colorOffset);
+    }
+
+    // sprites are instances of a static unit quad, drawn as a triangle strip
+    static const float unitQuad[] = 
+    {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f,
+    };
+    glGenBuffers(1, &g_renderer.unitQuadBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, g_renderer.unitQuadBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(unitQuad), unitQuad, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &g_renderer.spriteVertexArray);
+    glBindVertexArray(g_renderer.spriteVertexArray);
+    glEnableVertexAttribArray(JM_VERTEX_ATTRIB_POSITION);
+    glVertexAttribPointer(JM_VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+
+    // instance offsets are relative to the base instance of each draw
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(JM_VERTEX_ATTRIB_INSTANCE_RECT);
+    glVertexAttribDivisor(JM_VERTEX_ATTRIB_INSTANCE_RECT, 1);
+    glEnableVertexAttribArray(JM_VERTEX_ATTRIB_INSTANCE_TEXCOORD_RECT);
+    glVertexAttribDivisor(JM_VERTEX_ATTRIB_INSTANCE_TEXCOORD_RECT, 1);
+    glEnableVertexAttribArray(JM_VERTEX_ATTRIB_INSTANCE_COLOR);
+    glVertexAttribDivisor(JM_VERTEX_ATTRIB_INSTANCE_COLOR, 1);
+    glEnableVertexAttribArray(JM_VERTEX_ATTRIB_INSTANCE_ROTATION);
+    glVertexAttribDivisor(JM_VERTEX_ATTRIB_INSTANCE_ROTATION, 1);
+    jm_sprite_vertex_array_set_first_instance(0);
+
+    // the sprite vertex array stays bound
+    g_renderer.state.vertexArray = g_renderer.spriteVertexArray;
+    g_renderer.state.arrayBuffer = vertexBuffer;
+    g_renderer.state.elementArrayBuffer = JM_STATE_UNKNOWN;
+}
+
 int jm_renderer_init()
 {
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(MessageCallback, 0);
 
+    jm_state_cache_init(&g_renderer.state);
+
     load_shader_program(JM_SHADER_PROGRAM_COLOR, jm_embedded_vs_color, jm_embedded_fs_color);
     load_shader_program(JM_SHADER_PROGRAM_TEXTURE, jm_embedded_vs_texture, jm_embedded_fs_texture);
     load_shader_program(JM_SHADER_PROGRAM_TEXT, jm_embedded_vs_text, jm_embedded_fs_text);
+    // vertices always carry a color here, so the variants are the same shaders
+    load_shader_program(JM_SHADER_PROGRAM_COLOR_VERTEX_COLOR, jm_embedded_vs_color, jm_embedded_fs_color);
+    load_shader_program(JM_SHADER_PROGRAM_TEXTURE_VERTEX_COLOR, jm_embedded_vs_texture, jm_embedded_fs_texture);
+    load_shader_program(JM_SHADER_PROGRAM_SPRITE, jm_embedded_vs_sprite, jm_embedded_fs_texture);
+
+    g_renderer.isPersistentlyMapped = GLEW_ARB_buffer_storage;
+    g_renderer.regionIndex = 0;
+    for (uint32_t i = 0; i < JM_DYNAMIC_BUFFER_REGION_COUNT; ++i)
+    {
+        g_renderer.regionFences[i] = NULL;
+    }
+
+    g_renderer.hasBaseInstance = GLEW_ARB_base_instance;
+
+    jm_dynamic_buffer_init(&g_renderer.dynamicVertexBuffer, JM_DYNAMIC_VERTEX_BUFFER_REGION_SIZE, g_renderer.isPersistentlyMapped);
+    jm_dynamic_buffer_init(&g_renderer.dynamicIndexBuffer, JM_DYNAMIC_INDEX_BUFFER_REGION_SIZE, g_renderer.isPersistentlyMapped);
 
-    const size_t dynamicBufferSize = 32 * 1024 * 1024;
+    jm_vertex_arrays_init();
 
-    glGenBuffers(1, &g_renderer.dynamicVertexBuffer);
-    glGenBuffers(1, &g_renderer.dynamicIndexBuffer);
+    glGenBuffers(1, &g_renderer.transformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_renderer.transformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(float[16]) * JM_TRANSFORM_PALETTE_SIZE, NULL, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, JM_UNIFORM_BLOCK_BINDING_TRANSFORMS, g_renderer.transformBuffer);
 
-    glBindBuffer(GL_ARRAY_BUFFER, g_renderer.dynamicVertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, dynamicBufferSize, NULL, GL_DYNAMIC_DRAW);
+    // jm_view has the std140 layout of the shaders' View struct
+    glGenBuffers(1, &g_renderer.viewBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_renderer.viewBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(jm_view) * JM_VIEW_PALETTE_SIZE, NULL, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, JM_UNIFORM_BLOCK_BINDING_VIEWS, g_renderer.viewBuffer);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_renderer.dynamicIndexBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, dynamicBufferSize, NULL, GL_DYNAMIC_DRAW);
+    // storage is allocated by the first readback
+    for (uint32_t i = 0; i < JM_READBACK_BUFFER_COUNT; ++i)
+    {
+        jm_readback_buffer* readbackBuffer = &g_renderer.readbackBuffers[i];
+        glGenBuffers(1, &readbackBuffer->buffer);
+        readbackBuffer->size = 0;
+        readbackBuffer->fence = NULL;
+    }
+    g_renderer.firstReadback = 0;
+    g_renderer.readbackCount = 0;
+
+    g_renderer.deadVertexArrays = NULL;
+    g_renderer.deadVertexArrayCount = 0;
+    g_renderer.deadVertexArrayCapacity = 0;
 
     return 0;
 }
@@ -186,6 +584,11 @@ void jm_renderer_create_texture_resource(
 	const jm_texture_resource_desc* desc,
 	jm_texture_resource* resource)
 {
+    // textures can be created from another context than the one that renders, 
+    // so restore the binding instead of going through the state cache
+    GLint previousTexture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
     GLuint tex;
     glGenTextures(1, &tex);
 	glBindTexture(GL_TEXTURE_2D, tex);
@@ -194,23 +597,237 @@ void jm_renderer_create_texture_resource(
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)desc->width, (GLsizei)desc->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, desc->data);
+    glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+    // the texture may be used by the render thread's context right away
+    glFinish();
     *resource = tex;
 }
 
+void jm_renderer_update_texture_resource(
+	jm_texture_resource resource,
+	uint32_t x,
+	uint32_t y,
+	uint32_t width,
+	uint32_t height,
+	const void* data)
+{
+    // same as creation, this may run on another context than the one that renders
+    GLint previousTexture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+    glBindTexture(GL_TEXTURE_2D, resource);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)x, (GLint)y, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glBindTexture(GL_TEXTURE_2D, (GLuint)previousTexture);
+    glFinish();
+}
+
+void jm_renderer_create_render_target_resource(
+	const jm_render_target_resource_desc* desc,
+	jm_render_target_resource* renderTarget,
+	jm_texture_resource* texture)
+{
+    void* pixels = calloc(desc->width * desc->height, 4);
+
+    jm_texture_resource_desc textureDesc;
+    textureDesc.name = desc->name;
+    textureDesc.width = desc->width;
+    textureDesc.height = desc->height;
+    textureDesc.format = JM_TEXTURE_FORMAT_R8G8B8A8;
+    textureDesc.data = pixels;
+    jm_renderer_create_texture_resource(&textureDesc, texture);
+    free(pixels);
+
+    // renderbuffers are shared between contexts like textures, framebuffers aren't
+    GLint previousRenderbuffer;
+    glGetIntegerv(GL_RENDERBUFFER_BINDING, &previousRenderbuffer);
+
+    struct jm_render_target* target = malloc(sizeof(struct jm_render_target));
+    target->texture = *texture;
+    target->width = desc->width;
+    target->height = desc->height;
+    target->framebuffer = 0;
+    glGenRenderbuffers(1, &target->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, (GLsizei)desc->width, (GLsizei)desc->height);
+    glBindRenderbuffer(GL_RENDERBUFFER, (GLuint)previousRenderbuffer);
+    glFinish();
+    *renderTarget = target;
+}
+
+static GLuint jm_create_static_buffer(
+    const void* data,
+    GLsizeiptr size)
+{
+    // buffers aren't typed, so index data is uploaded through the array buffer 
+    // binding too, which doesn't touch the current vertex array
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW);
+    return buffer;
+}
+
+void jm_renderer_create_mesh_resource(
+	const jm_mesh_resource_desc* desc,
+	jm_mesh_resource* mesh)
+{
+    // same as textures, this may run on another context than the one that renders
+    GLint previousArrayBuffer;
+    glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousArrayBuffer);
+
+    const GLsizeiptr positionSize = sizeof(jm_vertex) * desc->vertexCount;
+    const GLsizeiptr texcoordSize = (desc->texcoords != NULL) ? sizeof(jm_texcoord) * desc->vertexCount : 0;
+
+    struct jm_mesh* resource = malloc(sizeof(struct jm_mesh));
+    resource->vertexBuffer = jm_create_static_buffer(NULL, positionSize + texcoordSize);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionSize, desc->vertices);
+    if (desc->texcoords != NULL)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, positionSize, texcoordSize, desc->texcoords);
+    }
+    resource->texcoordOffset = (desc->texcoords != NULL) ? (uint32_t)positionSize : 0;
+
+    resource->indexBuffer = 0;
+    if (desc->indices != NULL)
+    {
+        const GLsizeiptr indexSize = desc->isIndex32 ? sizeof(uint32_t) : sizeof(uint16_t);
+        resource->indexBuffer = jm_create_static_buffer(desc->indices, indexSize * desc->indexCount);
+    }
+    resource->vertexArray = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, (GLuint)previousArrayBuffer);
+    glFinish();
+    *mesh = resource;
+}
+
+void jm_renderer_destroy_mesh_resource(
+	jm_mesh_resource mesh)
+{
+    // buffers are shared with the context that created them, so they can be 
+    // deleted here, but their names may be handed out again
+    GLuint* cachedBuffers[] = { &g_renderer.state.arrayBuffer, &g_renderer.state.elementArrayBuffer };
+    for (size_t i = 0; i < sizeof(cachedBuffers) / sizeof(cachedBuffers[0]); ++i)
+    {
+        if (*cachedBuffers[i] == mesh->vertexBuffer || (mesh->indexBuffer != 0 && *cachedBuffers[i] == mesh->indexBuffer))
+        {
+            *cachedBuffers[i] = JM_STATE_UNKNOWN;
+        }
+    }
+    glDeleteBuffers(1, &mesh->vertexBuffer);
+    if (mesh->indexBuffer != 0)
+    {
+        glDeleteBuffers(1, &mesh->indexBuffer);
+    }
+
+    if (mesh->vertexArray != 0 && g_renderer.deadVertexArrayCount == g_renderer.deadVertexArrayCapacity)
+    {
+        const uint32_t capacity = (g_renderer.deadVertexArrayCapacity > 0) ? g_renderer.deadVertexArrayCapacity * 2 : 16;
+        GLuint* vertexArrays = realloc(g_renderer.deadVertexArrays, sizeof(GLuint) * capacity);
+        if (vertexArrays != NULL)
+        {
+            g_renderer.deadVertexArrays = vertexArrays;
+            g_renderer.deadVertexArrayCapacity = capacity;
+        }
+    }
+    // without room the vertex array is leaked rather than deleted
+    if (mesh->vertexArray != 0 && g_renderer.deadVertexArrayCount < g_renderer.deadVertexArrayCapacity)
+    {
+        g_renderer.deadVertexArrays[g_renderer.deadVertexArrayCount++] = mesh->vertexArray;
+    }
+    free(mesh);
+}
+
 jm_buffer_resource jm_renderer_get_dynamic_vertex_buffer()
 {
-    return g_renderer.dynamicVertexBuffer;
+    return g_renderer.dynamicVertexBuffer.buffer;
 }
 
 jm_buffer_resource jm_renderer_get_dynamic_index_buffer()
 {
-    return g_renderer.dynamicIndexBuffer;
+    return g_renderer.dynamicIndexBuffer.buffer;
+}
+
+void jm_renderer_begin_dynamic_buffers(
+	jm_dynamic_buffer_region* vertexRegion,
+	jm_dynamic_buffer_region* indexRegion)
+{
+    g_renderer.regionIndex = (g_renderer.regionIndex + 1) % JM_DYNAMIC_BUFFER_REGION_COUNT;
+
+    // wait until the GPU is done with the frame that last used this region
+    GLsync fence = g_renderer.regionFences[g_renderer.regionIndex];
+    if (fence)
+    {
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        g_renderer.regionFences[g_renderer.regionIndex] = NULL;
+    }
+
+    jm_dynamic_buffer_begin(&g_renderer.dynamicVertexBuffer, g_renderer.regionIndex, vertexRegion);
+    jm_dynamic_buffer_begin(&g_renderer.dynamicIndexBuffer, g_renderer.regionIndex, indexRegion);
+
+    if (g_renderer.deadVertexArrayCount > 0)
+    {
+        glDeleteVertexArrays((GLsizei)g_renderer.deadVertexArrayCount, g_renderer.deadVertexArrays);
+        g_renderer.deadVertexArrayCount = 0;
+    }
+}
+
+void jm_renderer_commit_dynamic_buffers(
+	uint32_t vertexDataSize,
+	uint32_t indexDataSize)
+{
+    jm_dynamic_buffer_commit(&g_renderer.dynamicVertexBuffer, vertexDataSize);
+    jm_dynamic_buffer_commit(&g_renderer.dynamicIndexBuffer, indexDataSize);
+}
+
+void jm_renderer_end_dynamic_buffers()
+{
+    if (g_renderer.isPersistentlyMapped)
+    {
+        g_renderer.regionFences[g_renderer.regionIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
 }
 
 void jm_renderer_set_shader_program(
 	jm_shader_program shaderProgram)
 {
-    glUseProgram(g_renderer.shaderPrograms[shaderProgram]);
+    const GLuint program = g_renderer.shaderPrograms[shaderProgram];
+    if (jm_state_cache_update(&g_renderer.state.program, program))
+    {
+        glUseProgram(program);
+    }
+}
+
+uint32_t jm_renderer_set_sprite_vertex_format(
+	uint32_t baseInstance)
+{
+    const GLuint vertexArray = g_renderer.spriteVertexArray;
+    if (jm_state_cache_update(&g_renderer.state.vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        // sprites aren't indexed, their vertex array has no element array
+        g_renderer.state.elementArrayBuffer = 0;
+    }
+
+    if (g_renderer.hasBaseInstance)
+    {
+        return baseInstance;
+    }
+
+    // without base instances the attributes are re-pointed for every draw
+    jm_renderer_bind_buffer(GL_ARRAY_BUFFER, g_renderer.dynamicVertexBuffer.buffer);
+    jm_sprite_vertex_array_set_first_instance(baseInstance);
+    return 0;
+}
+
+const jm_vertex_format_desc* jm_renderer_get_vertex_format_desc(
+	jm_vertex_format format)
+{
+    return &g_vertexFormats[format];
 }
 
 GLuint jm_renderer_get_shader_program(
@@ -219,11 +836,356 @@ GLuint jm_renderer_get_shader_program(
     return g_renderer.shaderPrograms[shaderProgram];
 }
 
-GLuint jm_renderer_get_uniform_location(
+void jm_renderer_bind_buffer(
+	GLenum target,
+	GLuint buffer)
+{
+    GLuint* cached = (target == GL_ELEMENT_ARRAY_BUFFER) ? &g_renderer.state.elementArrayBuffer : &g_renderer.state.arrayBuffer;
+    if (jm_state_cache_update(cached, buffer))
+    {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void jm_renderer_bind_texture(
+	GLuint texture)
+{
+    if (jm_state_cache_update(&g_renderer.state.texture, texture))
+    {
+        // only texture unit 0 is used
+        glBindTexture(GL_TEXTURE_2D, texture);
+    }
+}
+
+void jm_renderer_bind_render_target(
+	jm_render_target_resource renderTarget)
+{
+    if (renderTarget == NULL)
+    {
+        renderTarget = g_renderer.defaultRenderTarget;
+    }
+    if (renderTarget == NULL)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return;
+    }
+
+    if (renderTarget->framebuffer == 0)
+    {
+        glGenFramebuffers(1, &renderTarget->framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, renderTarget->framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, renderTarget->texture, 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderTarget->depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            fprintf(stderr, "[ERROR] Render target framebuffer is incomplete\n");
+        }
+        return;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, renderTarget->framebuffer);
+}
+
+void jm_renderer_set_default_render_target(
+	jm_render_target_resource renderTarget)
+{
+    g_renderer.defaultRenderTarget = renderTarget;
+}
+
+void jm_renderer_blit_render_target(
+	jm_render_target_resource renderTarget,
+	int32_t x,
+	int32_t y,
+	int32_t width,
+	int32_t height)
+{
+    // the target has been drawn into, so its framebuffer exists
+    jm_assert(renderTarget->framebuffer != 0);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, renderTarget->framebuffer);
+    glBlitFramebuffer(
+        0, 0, (GLint)renderTarget->width, (GLint)renderTarget->height,
+        x, y, x + width, y + height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool jm_renderer_begin_readback(
+	int32_t x,
+	int32_t y,
+	uint32_t width,
+	uint32_t height,
+	void* userData)
+{
+    if (g_renderer.readbackCount == JM_READBACK_BUFFER_COUNT)
+    {
+        return false;
+    }
+
+    const uint32_t index = (g_renderer.firstReadback + g_renderer.readbackCount) % JM_READBACK_BUFFER_COUNT;
+    jm_readback_buffer* readbackBuffer = &g_renderer.readbackBuffers[index];
+    readbackBuffer->width = width;
+    readbackBuffer->height = height;
+    readbackBuffer->userData = userData;
+
+    const uint32_t size = width * height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer->buffer);
+    if (readbackBuffer->size != size)
+    {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readbackBuffer->size = size;
+    }
+
+    // with a pack buffer bound this only queues the copy
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(x, y, (GLsizei)width, (GLsizei)height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readbackBuffer->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++g_renderer.readbackCount;
+    return true;
+}
+
+bool jm_renderer_end_readback(
+	bool wait,
+	jm_readback* readback)
+{
+    if (g_renderer.readbackCount == 0)
+    {
+        return false;
+    }
+
+    jm_readback_buffer* readbackBuffer = &g_renderer.readbackBuffers[g_renderer.firstReadback];
+    GLenum result = glClientWaitSync(readbackBuffer->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    while (wait && result == GL_TIMEOUT_EXPIRED)
+    {
+        result = glClientWaitSync(readbackBuffer->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        return false;
+    }
+    glDeleteSync(readbackBuffer->fence);
+    readbackBuffer->fence = NULL;
+
+    readback->pixels = malloc(readbackBuffer->size);
+    readback->width = readbackBuffer->width;
+    readback->height = readbackBuffer->height;
+    readback->userData = readbackBuffer->userData;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readbackBuffer->buffer);
+    const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, readbackBuffer->size, GL_MAP_READ_BIT);
+    if (data != NULL)
+    {
+        memcpy(readback->pixels, data, readbackBuffer->size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+    {
+        fprintf(stderr, "[ERROR] Can't map readback buffer\n");
+        memset(readback->pixels, 0, readbackBuffer->size);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    g_renderer.firstReadback = (g_renderer.firstReadback + 1) % JM_READBACK_BUFFER_COUNT;
+    --g_renderer.readbackCount;
+    return true;
+}
+
+void jm_renderer_set_blend_state(
+	jm_blend_state blendState)
+{
+    if (!jm_state_cache_update(&g_renderer.state.blendState, blendState))
+    {
+        return;
+    }
+
+    switch (blendState)
+    {
+    case JM_BLEND_STATE_OPAQUE:
+        glDisable(GL_BLEND);
+        glDepthMask(GL_TRUE);
+        break;
+    case JM_BLEND_STATE_TRANSPARENT:
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ZERO, GL_ONE);
+        glDepthMask(GL_FALSE);
+        break;
+    case JM_BLEND_STATE_ADDITIVE:
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE);
+        glDepthMask(GL_FALSE);
+        break;
+    default:
+        break;
+    }
+}
+
+void jm_renderer_set_depth_test(
+	bool enable)
+{
+    if (!jm_state_cache_update(&g_renderer.state.depthTest, enable))
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        glDepthFunc(GL_LESS);
+        glEnable(GL_DEPTH_TEST);
+    }
+    else
+    {
+        glDisable(GL_DEPTH_TEST);
+    }
+}
+
+void jm_renderer_set_primitive_restart(
+	bool enable,
+	GLenum indexType)
+{
+    // cached as 0 when disabled, or the size of the restart index in bytes
+    const uint32_t restartIndexSize = !enable ? 0 : (indexType == GL_UNSIGNED_INT) ? 4 : 2;
+    const uint32_t previousRestartIndexSize = g_renderer.state.primitiveRestart;
+    if (!jm_state_cache_update(&g_renderer.state.primitiveRestart, restartIndexSize))
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        if (previousRestartIndexSize == 0 || previousRestartIndexSize == JM_STATE_UNKNOWN)
+        {
+            glEnable(GL_PRIMITIVE_RESTART);
+        }
+        glPrimitiveRestartIndex((restartIndexSize == 4) ? UINT32_MAX : UINT16_MAX);
+    }
+    else
+    {
+        glDisable(GL_PRIMITIVE_RESTART);
+    }
+}
+
+void jm_renderer_set_vertex_format(
+	jm_vertex_format format)
+{
+    const GLuint vertexArray = g_renderer.vertexArrays[format];
+    if (jm_state_cache_update(&g_renderer.state.vertexArray, vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        // the element array binding is part of the vertex array
+        g_renderer.state.elementArrayBuffer = g_renderer.dynamicIndexBuffer.buffer;
+    }
+}
+
+void jm_renderer_set_mesh_vertex_format(
+	jm_mesh_resource mesh,
+	float depth,
+	uint32_t color)
+{
+    if (mesh->vertexArray == 0)
+    {
+        glGenVertexArrays(1, &mesh->vertexArray);
+        glBindVertexArray(mesh->vertexArray);
+        g_renderer.state.vertexArray = mesh->vertexArray;
+        jm_renderer_bind_buffer(GL_ARRAY_BUFFER, mesh->vertexBuffer);
+
+        glEnableVertexAttribArray(JM_VERTEX_ATTRIB_POSITION);
+        glVertexAttribPointer(JM_VERTEX_ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        if (mesh->texcoordOffset != 0)
+        {
+            glEnableVertexAttribArray(JM_VERTEX_ATTRIB_TEXCOORD);
+            glVertexAttribPointer(JM_VERTEX_ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 0, (void*)(size_t)mesh->texcoordOffset);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->indexBuffer);
+    }
+    else if (jm_state_cache_update(&g_renderer.state.vertexArray, mesh->vertexArray))
+    {
+        glBindVertexArray(mesh->vertexArray);
+    }
+    g_renderer.state.elementArrayBuffer = mesh->indexBuffer;
+
+    // disabled arrays read the current value of their attribute
+    glVertexAttrib1f(JM_VERTEX_ATTRIB_DEPTH, depth);
+    glVertexAttrib4Nub(JM_VERTEX_ATTRIB_COLOR, color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, color >> 24);
+}
+
+void jm_renderer_invalidate_vertex_format()
+{
+    g_renderer.state.vertexArray = JM_STATE_UNKNOWN;
+}
+
+void jm_renderer_update_transform_palette(
+	const float (*transforms)[16],
+	uint32_t transformCount)
+{
+    // orphan the storage instead of waiting for the previous frame's draws
+    glBindBuffer(GL_UNIFORM_BUFFER, g_renderer.transformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(float[16]) * JM_TRANSFORM_PALETTE_SIZE, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(float[16]) * transformCount, transforms);
+}
+
+void jm_renderer_update_view_palette(
+	const jm_view* views,
+	uint32_t viewCount)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, g_renderer.viewBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(jm_view) * JM_VIEW_PALETTE_SIZE, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(jm_view) * viewCount, views);
+}
+
+void jm_renderer_set_transform_index(
+	jm_shader_program shaderProgram,
+	uint32_t transformIndex)
+{
+    if (jm_state_cache_update(&g_renderer.state.transformIndex[shaderProgram], transformIndex))
+    {
+        jm_renderer_set_shader_program(shaderProgram);
+        glUniform1i(g_renderer.uniformLocations[shaderProgram][JM_UNIFORM_TRANSFORM_INDEX], (GLint)transformIndex);
+    }
+}
+
+void jm_renderer_set_view_index(
 	jm_shader_program shaderProgram,
-	const GLchar* name)
+	uint32_t viewIndex)
+{
+    if (jm_state_cache_update(&g_renderer.state.viewIndex[shaderProgram], viewIndex))
+    {
+        jm_renderer_set_shader_program(shaderProgram);
+        glUniform1i(g_renderer.uniformLocations[shaderProgram][JM_UNIFORM_VIEW_INDEX], (GLint)viewIndex);
+    }
+}
+
+void jm_renderer_set_depth(
+	jm_shader_program shaderProgram,
+	float depth)
+{
+    // cached by bit pattern
+    uint32_t depthBits;
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    if (jm_state_cache_update(&g_renderer.state.depth[shaderProgram], depthBits))
+    {
+        jm_renderer_set_shader_program(shaderProgram);
+        glUniform1f(g_renderer.uniformLocations[shaderProgram][JM_UNIFORM_DEPTH], depth);
+    }
+}
+
+void jm_renderer_get_state_stats(
+	jm_renderer_state_stats* stats)
+{
+    *stats = g_renderer.state.stats;
+}
+
+void jm_renderer_reset_state_stats()
 {
-    return glGetUniformLocation(g_renderer.shaderPrograms[shaderProgram], name);
+    g_renderer.state.stats.stateChanges = 0;
+    g_renderer.state.stats.elidedStateChanges = 0;
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,613 @@
+#if defined(JM_RENDERER_SOFTWARE)
+#include "renderer.h"
+#include "render_commands.h"
+
+#include <jammy/assert.h>
+#include <jammy/lodepng/lodepng.h>
+#include <jammy/math.h>
+
+#include <emmintrin.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Rows are rasterized in bands of this height. A band is only ever touched by
+// one thread, and every thread rasterizes the triangles of its bands in
+// submission order, so the output doesn't depend on the number of threads.
+#define JM_RASTER_BAND_HEIGHT 16
+#define JM_RASTER_MAX_THREADS 16
+
+typedef struct jm_software_texture
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t* texels; // RGBA8
+	float* depth; // render targets only
+} jm_software_texture;
+
+static struct
+{
+	// the target that is drawn to, the framebuffer or a render target
+	uint32_t width;
+	uint32_t height;
+	uint32_t* colorBuffer;
+	float* depthBuffer;
+	jm_render_target_resource renderTarget;
+
+	uint32_t framebufferWidth;
+	uint32_t framebufferHeight;
+	uint32_t* framebufferColor;
+	// the framebuffer scaled up for jm_renderer_write_png
+	uint32_t* scaledColor;
+	float* framebufferDepth;
+
+	// by resource, 0 is never handed out
+	jm_software_texture* textures;
+	uint32_t textureCount;
+	uint32_t textureCapacity;
+	uint32_t meshCount;
+
+	jm_raster_triangle* triangles;
+	uint32_t triangleCount;
+	uint32_t triangleCapacity;
+
+	pthread_t threads[JM_RASTER_MAX_THREADS];
+	uint32_t threadCount;
+	pthread_mutex_t mutex;
+	pthread_cond_t workReady;
+	pthread_cond_t workDone;
+	uint32_t workGeneration;
+	uint32_t busyThreadCount;
+	uint32_t nextBand;
+} g_renderer;
+
+static uint32_t jm_pack_rgba(
+	float r,
+	float g,
+	float b,
+	float a)
+{
+	const uint32_t r8 = (uint32_t)(r * 255.0f + 0.5f);
+	const uint32_t g8 = (uint32_t)(g * 255.0f + 0.5f);
+	const uint32_t b8 = (uint32_t)(b * 255.0f + 0.5f);
+	const uint32_t a8 = (uint32_t)(a * 255.0f + 0.5f);
+	return r8 | (g8 << 8) | (b8 << 16) | (a8 << 24);
+}
+
+static float jm_saturate(
+	float value)
+{
+	return (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+}
+
+// Nearest texel with wrapping, like the OpenGL renderer's samplers.
+static uint32_t jm_sample_texture(
+	const jm_software_texture* texture,
+	float u,
+	float v)
+{
+	int32_t x = (int32_t)floorf(u * (float)texture->width) % (int32_t)texture->width;
+	int32_t y = (int32_t)floorf(v * (float)texture->height) % (int32_t)texture->height;
+	x += (x < 0) ? (int32_t)texture->width : 0;
+	y += (y < 0) ? (int32_t)texture->height : 0;
+	return texture->texels[(uint32_t)y * texture->width + (uint32_t)x];
+}
+
+static void jm_shade_pixel(
+	const jm_raster_triangle* triangle,
+	const jm_raster_vertex* v0,
+	const jm_raster_vertex* v1,
+	const jm_raster_vertex* v2,
+	const jm_software_texture* texture,
+	uint32_t pixel,
+	float w0,
+	float w1,
+	float w2)
+{
+	if (triangle->depthTest && !(triangle->depth < g_renderer.depthBuffer[pixel]))
+	{
+		return;
+	}
+
+	float r = w0 * v0->r + w1 * v1->r + w2 * v2->r;
+	float g = w0 * v0->g + w1 * v1->g + w2 * v2->g;
+	float b = w0 * v0->b + w1 * v1->b + w2 * v2->b;
+	float a = w0 * v0->a + w1 * v1->a + w2 * v2->a;
+
+	if (texture != NULL)
+	{
+		const float u = w0 * v0->u + w1 * v1->u + w2 * v2->u;
+		const float v = w0 * v0->v + w1 * v1->v + w2 * v2->v;
+		const uint32_t texel = jm_sample_texture(texture, u, v);
+		if (triangle->alphaTest && (texel >> 24) == 0)
+		{
+			return;
+		}
+		r *= (float)(texel & 0xff) / 255.0f;
+		g *= (float)((texel >> 8) & 0xff) / 255.0f;
+		b *= (float)((texel >> 16) & 0xff) / 255.0f;
+		a *= (float)(texel >> 24) / 255.0f;
+	}
+
+	r = jm_saturate(r);
+	g = jm_saturate(g);
+	b = jm_saturate(b);
+	a = jm_saturate(a);
+
+	uint32_t* dst = &g_renderer.colorBuffer[pixel];
+	if (triangle->blendState == JM_BLEND_STATE_OPAQUE)
+	{
+		*dst = jm_pack_rgba(r, g, b, a);
+		g_renderer.depthBuffer[pixel] = triangle->depth;
+		return;
+	}
+
+	// blended states keep the destination alpha and don't write depth
+	const float dstR = (float)(*dst & 0xff) / 255.0f;
+	const float dstG = (float)((*dst >> 8) & 0xff) / 255.0f;
+	const float dstB = (float)((*dst >> 16) & 0xff) / 255.0f;
+	const float dstA = (float)(*dst >> 24) / 255.0f;
+	const float dstScale = (triangle->blendState == JM_BLEND_STATE_ADDITIVE) ? 1.0f : 1.0f - a;
+	*dst = jm_pack_rgba(
+		jm_saturate(r * a + dstR * dstScale),
+		jm_saturate(g * a + dstG * dstScale),
+		jm_saturate(b * a + dstB * dstScale),
+		dstA);
+}
+
+// Edge function e(x, y) = a * x + b * y + c, positive inside the triangle.
+typedef struct jm_raster_edge
+{
+	float a, b, c;
+	// pixels exactly on the edge belong to the triangle on its top or left
+	bool isTopLeft;
+} jm_raster_edge;
+
+static void jm_raster_edge_init(
+	jm_raster_edge* edge,
+	const jm_raster_vertex* from,
+	const jm_raster_vertex* to)
+{
+	edge->a = from->y - to->y;
+	edge->b = to->x - from->x;
+	edge->c = from->x * to->y - from->y * to->x;
+	edge->isTopLeft = (edge->a > 0.0f) || (edge->a == 0.0f && edge->b > 0.0f);
+}
+
+static __m128 jm_raster_edge_inside(
+	__m128 e,
+	bool isTopLeft)
+{
+	const __m128 zero = _mm_setzero_ps();
+	return isTopLeft ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero);
+}
+
+// Rasterizes the part of a triangle in rows [minRow, maxRow). Edge functions
+// are evaluated for 4 pixels at a time.
+static void jm_rasterize_triangle(
+	const jm_raster_triangle* triangle,
+	int32_t minRow,
+	int32_t maxRow)
+{
+	const jm_raster_vertex* v0 = &triangle->vertices[0];
+	const jm_raster_vertex* v1 = &triangle->vertices[1];
+	const jm_raster_vertex* v2 = &triangle->vertices[2];
+
+	// the edges are oriented so the area is positive
+	float area = (v1->x - v0->x) * (v2->y - v0->y) - (v1->y - v0->y) * (v2->x - v0->x);
+	if (area == 0.0f || !isfinite(area))
+	{
+		return;
+	}
+	if (area < 0.0f)
+	{
+		const jm_raster_vertex* tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	const float minY = fminf(v0->y, fminf(v1->y, v2->y));
+	const float maxY = fmaxf(v0->y, fmaxf(v1->y, v2->y));
+	const float minX = fminf(v0->x, fminf(v1->x, v2->x));
+	const float maxX = fmaxf(v0->x, fmaxf(v1->x, v2->x));
+
+	// pixel centers are at half coordinates
+	const int32_t rowBegin = (int32_t)fmaxf((float)jm_max(minRow, triangle->scissor[1]), ceilf(minY - 0.5f));
+	const int32_t rowEnd = (int32_t)fminf((float)jm_min(maxRow, triangle->scissor[3]), floorf(maxY - 0.5f) + 1.0f);
+	const int32_t columnBegin = (int32_t)fmaxf((float)triangle->scissor[0], ceilf(minX - 0.5f));
+	const int32_t columnEnd = (int32_t)fminf((float)jm_min(g_renderer.width, triangle->scissor[2]), floorf(maxX - 0.5f) + 1.0f);
+	if (rowBegin >= rowEnd || columnBegin >= columnEnd)
+	{
+		return;
+	}
+
+	// e12 weights v0, e20 weights v1 and e01 weights v2
+	jm_raster_edge edges[3];
+	jm_raster_edge_init(&edges[0], v1, v2);
+	jm_raster_edge_init(&edges[1], v2, v0);
+	jm_raster_edge_init(&edges[2], v0, v1);
+
+	const jm_software_texture* texture = NULL;
+	if (triangle->texture != 0 && triangle->texture < g_renderer.textureCount && g_renderer.textures[triangle->texture].texels != NULL)
+	{
+		texture = &g_renderer.textures[triangle->texture];
+	}
+
+	const float invArea = 1.0f / area;
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 a0 = _mm_set1_ps(edges[0].a);
+	const __m128 a1 = _mm_set1_ps(edges[1].a);
+	const __m128 a2 = _mm_set1_ps(edges[2].a);
+
+	for (int32_t row = rowBegin; row < rowEnd; ++row)
+	{
+		const float y = (float)row + 0.5f;
+		const __m128 rowE0 = _mm_set1_ps(edges[0].b * y + edges[0].c);
+		const __m128 rowE1 = _mm_set1_ps(edges[1].b * y + edges[1].c);
+		const __m128 rowE2 = _mm_set1_ps(edges[2].b * y + edges[2].c);
+
+		for (int32_t column = columnBegin; column < columnEnd; column += 4)
+		{
+			const __m128 x = _mm_add_ps(_mm_set1_ps((float)column), laneOffsets);
+			const __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, x), rowE0);
+			const __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, x), rowE1);
+			const __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, x), rowE2);
+
+			const __m128 inside = _mm_and_ps(
+				jm_raster_edge_inside(e0, edges[0].isTopLeft),
+				_mm_and_ps(jm_raster_edge_inside(e1, edges[1].isTopLeft), jm_raster_edge_inside(e2, edges[2].isTopLeft)));
+
+			int mask = _mm_movemask_ps(inside);
+			if (columnEnd - column < 4)
+			{
+				mask &= (1 << (columnEnd - column)) - 1;
+			}
+			if (mask == 0)
+			{
+				continue;
+			}
+
+			float w0[4], w1[4], w2[4];
+			_mm_storeu_ps(w0, _mm_mul_ps(e0, _mm_set1_ps(invArea)));
+			_mm_storeu_ps(w1, _mm_mul_ps(e1, _mm_set1_ps(invArea)));
+			_mm_storeu_ps(w2, _mm_mul_ps(e2, _mm_set1_ps(invArea)));
+
+			const uint32_t rowPixel = (uint32_t)row * g_renderer.width + (uint32_t)column;
+			for (uint32_t lane = 0; lane < 4; ++lane)
+			{
+				if (mask & (1 << lane))
+				{
+					jm_shade_pixel(triangle, v0, v1, v2, texture, rowPixel + lane, w0[lane], w1[lane], w2[lane]);
+				}
+			}
+		}
+	}
+}
+
+static void jm_rasterize_band(
+	uint32_t band)
+{
+	const int32_t minRow = (int32_t)(band * JM_RASTER_BAND_HEIGHT);
+	const int32_t maxRow = (int32_t)fminf((float)(minRow + JM_RASTER_BAND_HEIGHT), (float)g_renderer.height);
+	for (uint32_t i = 0; i < g_renderer.triangleCount; ++i)
+	{
+		jm_rasterize_triangle(&g_renderer.triangles[i], minRow, maxRow);
+	}
+}
+
+static void jm_rasterize_bands()
+{
+	const uint32_t bandCount = (g_renderer.height + JM_RASTER_BAND_HEIGHT - 1) / JM_RASTER_BAND_HEIGHT;
+	uint32_t band;
+	while ((band = __atomic_fetch_add(&g_renderer.nextBand, 1, __ATOMIC_RELAXED)) < bandCount)
+	{
+		jm_rasterize_band(band);
+	}
+}
+
+static void* jm_raster_thread_proc(
+	void* arg)
+{
+	uint32_t generation = 0;
+	while (true)
+	{
+		pthread_mutex_lock(&g_renderer.mutex);
+		while (g_renderer.workGeneration == generation)
+		{
+			pthread_cond_wait(&g_renderer.workReady, &g_renderer.mutex);
+		}
+		generation = g_renderer.workGeneration;
+		pthread_mutex_unlock(&g_renderer.mutex);
+
+		jm_rasterize_bands();
+
+		pthread_mutex_lock(&g_renderer.mutex);
+		if (--g_renderer.busyThreadCount == 0)
+		{
+			pthread_cond_signal(&g_renderer.workDone);
+		}
+		pthread_mutex_unlock(&g_renderer.mutex);
+	}
+	return NULL;
+}
+
+int jm_renderer_init()
+{
+	if (g_renderer.framebufferColor == NULL)
+	{
+		fprintf(stderr, "[ERROR] The framebuffer size must be set before jm_renderer_init\n");
+		return 1;
+	}
+
+	pthread_mutex_init(&g_renderer.mutex, NULL);
+	pthread_cond_init(&g_renderer.workReady, NULL);
+	pthread_cond_init(&g_renderer.workDone, NULL);
+
+	// the calling thread rasterizes too
+	const long processorCount = sysconf(_SC_NPROCESSORS_ONLN);
+	g_renderer.threadCount = (processorCount > 1) ? (uint32_t)(processorCount - 1) : 0;
+	if (g_renderer.threadCount > JM_RASTER_MAX_THREADS)
+	{
+		g_renderer.threadCount = JM_RASTER_MAX_THREADS;
+	}
+	for (uint32_t i = 0; i < g_renderer.threadCount; ++i)
+	{
+		if (pthread_create(&g_renderer.threads[i], NULL, jm_raster_thread_proc, NULL))
+		{
+			g_renderer.threadCount = i;
+			break;
+		}
+	}
+	return 0;
+}
+
+void jm_renderer_set_framebuffer_size(
+	uint32_t width,
+	uint32_t height)
+{
+	g_renderer.framebufferWidth = width;
+	g_renderer.framebufferHeight = height;
+	g_renderer.framebufferColor = realloc(g_renderer.framebufferColor, sizeof(uint32_t) * width * height);
+	g_renderer.framebufferDepth = realloc(g_renderer.framebufferDepth, sizeof(float) * width * height);
+	jm_renderer_set_render_target(0);
+	jm_renderer_clear(0xff000000);
+}
+
+void jm_renderer_get_framebuffer_size(
+	uint32_t* width,
+	uint32_t* height)
+{
+	*width = g_renderer.framebufferWidth;
+	*height = g_renderer.framebufferHeight;
+}
+
+void jm_renderer_set_render_target(
+	jm_render_target_resource renderTarget)
+{
+	jm_assert(g_renderer.triangleCount == 0);
+
+	if (renderTarget == 0 || renderTarget >= g_renderer.textureCount || g_renderer.textures[renderTarget].depth == NULL)
+	{
+		g_renderer.width = g_renderer.framebufferWidth;
+		g_renderer.height = g_renderer.framebufferHeight;
+		g_renderer.colorBuffer = g_renderer.framebufferColor;
+		g_renderer.depthBuffer = g_renderer.framebufferDepth;
+		g_renderer.renderTarget = 0;
+		return;
+	}
+
+	jm_software_texture* target = &g_renderer.textures[renderTarget];
+	g_renderer.width = target->width;
+	g_renderer.height = target->height;
+	g_renderer.colorBuffer = target->texels;
+	g_renderer.depthBuffer = target->depth;
+	g_renderer.renderTarget = renderTarget;
+}
+
+void jm_renderer_clear(
+	uint32_t color)
+{
+	const uint32_t pixelCount = g_renderer.width * g_renderer.height;
+	for (uint32_t i = 0; i < pixelCount; ++i)
+	{
+		g_renderer.colorBuffer[i] = color;
+		g_renderer.depthBuffer[i] = 1.0f;
+	}
+}
+
+void jm_renderer_read_framebuffer(
+	uint32_t* dst)
+{
+	memcpy(dst, g_renderer.framebufferColor, sizeof(uint32_t) * g_renderer.framebufferWidth * g_renderer.framebufferHeight);
+}
+
+bool jm_renderer_write_png(
+	const char* path,
+	uint32_t scale)
+{
+	const uint32_t width = g_renderer.framebufferWidth * scale;
+	const uint32_t height = g_renderer.framebufferHeight * scale;
+	const uint32_t* pixels = g_renderer.framebufferColor;
+	if (scale > 1)
+	{
+		g_renderer.scaledColor = realloc(g_renderer.scaledColor, sizeof(uint32_t) * width * height);
+		uint32_t* dst = g_renderer.scaledColor;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint32_t* src = g_renderer.framebufferColor + (y / scale) * g_renderer.framebufferWidth;
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				*dst++ = src[x / scale];
+			}
+		}
+		pixels = g_renderer.scaledColor;
+	}
+
+	const unsigned error = lodepng_encode32_file(path, (const unsigned char*)pixels, width, height);
+	if (error)
+	{
+		fprintf(stderr, "[ERROR] Can't write '%s': %s\n", path, lodepng_error_text(error));
+		return false;
+	}
+	return true;
+}
+
+jm_raster_triangle* jm_renderer_alloc_triangles(
+	uint32_t count)
+{
+	if (g_renderer.triangleCount + count > g_renderer.triangleCapacity)
+	{
+		uint32_t capacity = (g_renderer.triangleCapacity > 0) ? g_renderer.triangleCapacity : 1024;
+		while (capacity < g_renderer.triangleCount + count)
+		{
+			capacity *= 2;
+		}
+		g_renderer.triangles = realloc(g_renderer.triangles, sizeof(jm_raster_triangle) * capacity);
+		g_renderer.triangleCapacity = capacity;
+	}
+
+	jm_raster_triangle* triangles = g_renderer.triangles + g_renderer.triangleCount;
+	g_renderer.triangleCount += count;
+	return triangles;
+}
+
+void jm_renderer_rasterize()
+{
+	if (g_renderer.triangleCount == 0)
+	{
+		return;
+	}
+
+	pthread_mutex_lock(&g_renderer.mutex);
+	g_renderer.nextBand = 0;
+	g_renderer.busyThreadCount = g_renderer.threadCount;
+	++g_renderer.workGeneration;
+	pthread_cond_broadcast(&g_renderer.workReady);
+	pthread_mutex_unlock(&g_renderer.mutex);
+
+	jm_rasterize_bands();
+
+	pthread_mutex_lock(&g_renderer.mutex);
+	while (g_renderer.busyThreadCount > 0)
+	{
+		pthread_cond_wait(&g_renderer.workDone, &g_renderer.mutex);
+	}
+	pthread_mutex_unlock(&g_renderer.mutex);
+
+	g_renderer.triangleCount = 0;
+}
+
+void jm_renderer_create_texture_resource(
+	const jm_texture_resource_desc* desc,
+	jm_texture_resource* resource)
+{
+	// 0 is never handed out
+	if (g_renderer.textureCount == 0)
+	{
+		g_renderer.textureCount = 1;
+	}
+	if (g_renderer.textureCount >= g_renderer.textureCapacity)
+	{
+		g_renderer.textureCapacity = (g_renderer.textureCapacity > 0) ? g_renderer.textureCapacity * 2 : 64;
+		g_renderer.textures = realloc(g_renderer.textures, sizeof(jm_software_texture) * g_renderer.textureCapacity);
+	}
+
+	jm_software_texture* texture = &g_renderer.textures[g_renderer.textureCount];
+	texture->width = desc->width;
+	texture->height = desc->height;
+	texture->depth = NULL;
+	const uint32_t texelCount = desc->width * desc->height;
+	texture->texels = malloc(sizeof(uint32_t) * texelCount);
+	if (desc->data == NULL)
+	{
+		memset(texture->texels, 0, sizeof(uint32_t) * texelCount);
+	}
+	else if (desc->format == JM_TEXTURE_FORMAT_R8)
+	{
+		// single channel textures hold coverage, like glyphs
+		const uint8_t* src = desc->data;
+		for (uint32_t i = 0; i < texelCount; ++i)
+		{
+			texture->texels[i] = 0x00ffffff | ((uint32_t)src[i] << 24);
+		}
+	}
+	else
+	{
+		memcpy(texture->texels, desc->data, sizeof(uint32_t) * texelCount);
+	}
+
+	*resource = g_renderer.textureCount++;
+}
+
+void jm_renderer_destroy_texture_resource(
+	jm_texture_resource resource)
+{
+	if (resource == 0 || resource >= g_renderer.textureCount)
+	{
+		return;
+	}
+
+	free(g_renderer.textures[resource].texels);
+	free(g_renderer.textures[resource].depth);
+	g_renderer.textures[resource].texels = NULL;
+	g_renderer.textures[resource].depth = NULL;
+	g_renderer.textures[resource].width = 0;
+	g_renderer.textures[resource].height = 0;
+}
+
+void jm_renderer_create_render_target_resource(
+	const jm_render_target_resource_desc* desc,
+	jm_render_target_resource* renderTarget,
+	jm_texture_resource* texture)
+{
+	// a render target is a texture with a depth buffer
+	jm_texture_resource_desc textureDesc;
+	textureDesc.name = desc->name;
+	textureDesc.width = desc->width;
+	textureDesc.height = desc->height;
+	textureDesc.format = JM_TEXTURE_FORMAT_R8G8B8A8;
+	textureDesc.data = NULL;
+	jm_renderer_create_texture_resource(&textureDesc, texture);
+
+	const uint32_t texelCount = desc->width * desc->height;
+	float* depth = malloc(sizeof(float) * texelCount);
+	for (uint32_t i = 0; i < texelCount; ++i)
+	{
+		depth[i] = 1.0f;
+	}
+	g_renderer.textures[*texture].depth = depth;
+	*renderTarget = *texture;
+}
+
+void jm_renderer_create_mesh_resource(
+	const jm_mesh_resource_desc* desc,
+	jm_mesh_resource* mesh)
+{
+	// commands rasterize from the mesh's own copy of the geometry
+	*mesh = ++g_renderer.meshCount;
+}
+
+void jm_renderer_destroy_mesh_resource(
+	jm_mesh_resource mesh)
+{
+}
+
+jm_buffer_resource jm_renderer_get_dynamic_vertex_buffer()
+{
+	return 0;
+}
+
+jm_buffer_resource jm_renderer_get_dynamic_index_buffer()
+{
+	return 0;
+}
+
+void jm_renderer_set_shader_program(
+	jm_shader_program shaderProgram)
+{
+}
+#endif
@@ -15,13 +15,34 @@ struct PsOutput
 
 cbuffer VsConstants : register(b0)
 {
-	float4x4 g_viewProjectionMatrix;
+	// JM_TRANSFORM_PALETTE_SIZE entries, the first is the identity
+	float4x4 g_transforms[256];
+};
+
+cbuffer VsInstanceConstants : register(b1)
+{
+	uint g_transformIndex;
+	float g_depth;
+	uint g_viewIndex;
+};
+
+// JM_VIEW_PALETTE_SIZE entries, laid out like jm_view
+struct View
+{
+	float4x4 transform;
+	float4 viewport;
+};
+
+cbuffer VsViewConstants : register(b2)
+{
+	View g_views[16];
 };
 
 PsInput VertexMain(VsInput input)
 {
 	PsInput output;
-	output.pos = mul(g_viewProjectionMatrix, float4(input.pos, 0, 1));
+	output.pos = mul(g_views[g_viewIndex].transform, mul(g_transforms[g_transformIndex], float4(input.pos, 0, 1)));
+	output.pos.z = g_depth * output.pos.w;
 	return output;
 }
 
@@ -0,0 +1,74 @@
+struct VsInput
+{
+	float2 corner : Position;
+	float4 rect : InstanceRect;
+	float4 uvRect : InstanceTexcoordRect;
+	float4 color : InstanceColor;
+	float rotation : InstanceRotation;
+};
+
+struct PsInput
+{
+	float4 pos : SV_Position;
+	float2 uv : Texcoord;
+	float4 color : Color;
+};
+
+struct PsOutput
+{
+	float4 color : SV_Target0;
+};
+
+cbuffer VsConstants : register(b0)
+{
+	// JM_TRANSFORM_PALETTE_SIZE entries, the first is the identity
+	float4x4 g_transforms[256];
+};
+
+cbuffer VsInstanceConstants : register(b1)
+{
+	uint g_transformIndex;
+	float g_depth;
+	uint g_viewIndex;
+};
+
+// JM_VIEW_PALETTE_SIZE entries, laid out like jm_view
+struct View
+{
+	float4x4 transform;
+	float4 viewport;
+};
+
+cbuffer VsViewConstants : register(b2)
+{
+	View g_views[16];
+};
+
+PsInput VertexMain(VsInput input)
+{
+	const float2 halfSize = 0.5 * input.rect.zw;
+	const float2 offset = (input.corner * 2 - 1) * halfSize;
+	float s, c;
+	sincos(input.rotation, s, c);
+	const float2 pos = input.rect.xy + halfSize + float2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+
+	PsInput output;
+	output.pos = mul(g_views[g_viewIndex].transform, mul(g_transforms[g_transformIndex], float4(pos, 0, 1)));
+	output.pos.z = g_depth * output.pos.w;
+	output.uv = lerp(input.uvRect.xy, input.uvRect.zw, input.corner);
+	output.color = input.color;
+	return output;
+}
+
+Texture2D g_texture : register(t0);
+SamplerState g_sampler : register(s0);
+
+PsOutput PixelMain(PsInput input)
+{
+	const float4 texColor = g_texture.Sample(g_sampler, input.uv);
+	clip(texColor.a ? 1 : -1);
+
+	PsOutput output;
+	output.color = texColor * input.color;
+	return output;
+}
\ No newline at end of file
@@ -2,6 +2,7 @@ struct VsInput
 {
 	float2 pos : Position;
 	float2 uv : Texcoord;
+	float depth : Depth;
 };
 
 struct PsInput
@@ -17,13 +18,15 @@ struct PsOutput
 
 cbuffer VsConstants : register(b0)
 {
-	float4x4 g_viewProjectionMatrix;
+	// JM_TRANSFORM_PALETTE_SIZE entries, the first is the identity
+	float4x4 g_transforms[256];
 };
 
 PsInput VertexMain(VsInput input)
 {
 	PsInput output;
-	output.pos = mul(g_viewProjectionMatrix, float4(input.pos, 0, 1));
+	output.pos = mul(g_transforms[0], float4(input.pos, 0, 1));
+	output.pos.z = input.depth * output.pos.w;
 	output.uv = input.uv;
 	return output;
 }
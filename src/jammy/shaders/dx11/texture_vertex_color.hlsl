@@ -0,0 +1,71 @@
+struct VsInput
+{
+	float2 pos : Position;
+	float2 uv : Texcoord;
+	float4 color : Color;
+};
+
+struct PsInput
+{
+	float4 pos : SV_Position;
+	float2 uv : Texcoord;
+	float4 color : Color;
+};
+
+struct PsOutput
+{
+	float4 color : SV_Target0;
+};
+
+cbuffer VsConstants : register(b0)
+{
+	// JM_TRANSFORM_PALETTE_SIZE entries, the first is the identity
+	float4x4 g_transforms[256];
+};
+
+cbuffer VsInstanceConstants : register(b1)
+{
+	uint g_transformIndex;
+	float g_depth;
+	uint g_viewIndex;
+};
+
+// JM_VIEW_PALETTE_SIZE entries, laid out like jm_view
+struct View
+{
+	float4x4 transform;
+	float4 viewport;
+};
+
+cbuffer VsViewConstants : register(b2)
+{
+	View g_views[16];
+};
+
+PsInput VertexMain(VsInput input)
+{
+	PsInput output;
+	output.pos = mul(g_views[g_viewIndex].transform, mul(g_transforms[g_transformIndex], float4(input.pos, 0, 1)));
+	output.pos.z = g_depth * output.pos.w;
+	output.uv = input.uv;
+	output.color = input.color;
+	return output;
+}
+
+cbuffer PsConstants : register(b0)
+{
+	float4 g_color;
+};
+
+Texture2D g_texture : register(t0);
+SamplerState g_sampler : register(s0);
+
+PsOutput PixelMain(PsInput input)
+{
+	const float4 texColor = g_texture.Sample(g_sampler, input.uv);
+	clip(texColor.a ? 1 : -1);
+
+	PsOutput output;
+	output.color = texColor * input.color * g_color;
+	return output;
+}
\ No newline at end of file
@@ -1,10 +1,10 @@
 #version 130
 
-uniform vec4 g_color = vec4(1, 0, 1, 1);
+in vec4 vertColor;
 
 out vec4 color;
 
 void main()
 {
-    color = g_color;
+    color = vertColor;
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#version 140
+
+// JM_TRANSFORM_PALETTE_SIZE entries
+layout(std140) uniform Transforms
+{
+    mat4 g_transforms[256];
+};
+uniform int g_transformIndex;
+
+// JM_VIEW_PALETTE_SIZE entries, laid out like jm_view
+struct View
+{
+    mat4 transform;
+    vec4 viewport;
+};
+layout(std140) uniform Views
+{
+    View g_views[16];
+};
+uniform int g_viewIndex;
+uniform float g_depth;
+
+in vec2 vertexPos;
+in vec4 instanceRect;
+in vec4 instanceTexcoordRect;
+in vec4 instanceColor;
+in float instanceRotation;
+
+out vec2 texcoord;
+out vec4 vertColor;
+
+void main()
+{
+    vec2 halfSize = 0.5 * instanceRect.zw;
+    vec2 offset = (vertexPos * 2.0 - 1.0) * halfSize;
+    float s = sin(instanceRotation);
+    float c = cos(instanceRotation);
+    vec2 pos = instanceRect.xy + halfSize + vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+
+    gl_Position = g_views[g_viewIndex].transform * g_transforms[g_transformIndex] * vec4(pos, 0, 1);
+    gl_Position.z = g_depth * gl_Position.w;
+    texcoord = mix(instanceTexcoordRect.xy, instanceTexcoordRect.zw, vertexPos);
+    vertColor = instanceColor;
+}
\ No newline at end of file
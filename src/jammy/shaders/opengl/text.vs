@@ -1,16 +1,18 @@
 #version 130
 
-uniform mat4 g_matWorldViewProj;
-
 in vec2 vertexPos;
+in float vertexDepth;
 in vec2 vertexTexcoord;
+in vec4 vertexColor;
 
 out vec2 texcoord;
+out vec4 vertColor;
 
 void main()
 {
     gl_Position.xy = vertexPos;
-    gl_Position.z = 0.0;
+    gl_Position.z = vertexDepth;
     gl_Position.w = 1.0;
     texcoord = vertexTexcoord;
+    vertColor = vertexColor;
 }
\ No newline at end of file
@@ -1,9 +1,9 @@
 #version 130
 
 uniform sampler2D g_texture;
-uniform vec4 g_color = vec4(1, 1, 1, 1);
 
 in vec2 texcoord;
+in vec4 vertColor;
 
 out vec4 color;
 
@@ -14,5 +14,5 @@ void main()
     {
         discard;
     }
-    color = texColor * g_color;
+    color = texColor * vertColor;
 }
\ No newline at end of file
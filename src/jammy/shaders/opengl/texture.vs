@@ -1,14 +1,36 @@
-#version 130
+#version 140
 
-uniform mat4 g_matWorldViewProj;
+// JM_TRANSFORM_PALETTE_SIZE entries
+layout(std140) uniform Transforms
+{
+    mat4 g_transforms[256];
+};
+uniform int g_transformIndex;
+
+// JM_VIEW_PALETTE_SIZE entries, laid out like jm_view
+struct View
+{
+    mat4 transform;
+    vec4 viewport;
+};
+layout(std140) uniform Views
+{
+    View g_views[16];
+};
+uniform int g_viewIndex;
 
 in vec2 vertexPos;
+in float vertexDepth;
 in vec2 vertexTexcoord;
+in vec4 vertexColor;
 
 out vec2 texcoord;
+out vec4 vertColor;
 
 void main()
 {
-    gl_Position = g_matWorldViewProj * vec4(vertexPos, 0, 1);
+    gl_Position = g_views[g_viewIndex].transform * g_transforms[g_transformIndex] * vec4(vertexPos, 0, 1);
+    gl_Position.z = vertexDepth * gl_Position.w;
     texcoord = vertexTexcoord;
+    vertColor = vertexColor;
 }
\ No newline at end of file
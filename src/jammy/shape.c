@@ -0,0 +1,221 @@
+#include "shape.h"
+
+#include <jammy/assert.h>
+#include <jammy/math.h>
+
+#include <math.h>
+
+#define JM_SHAPE_PI 3.14159265358979f
+#define JM_SHAPE_MIN_CIRCLE_SEGMENTS 8
+#define JM_SHAPE_MAX_CIRCLE_SEGMENTS 256
+#define JM_SHAPE_MAX_ERROR 0.1f
+
+uint32_t jm_shape_get_circle_segments(
+	float radius)
+{
+	// NaN would make the segment count undefined
+	if (!isfinite(radius) || radius <= JM_SHAPE_MAX_ERROR)
+	{
+		return JM_SHAPE_MIN_CIRCLE_SEGMENTS;
+	}
+	// a chord of angle a is at most radius * (1 - cos(a / 2)) away from the arc
+	const float segments = ceilf(JM_SHAPE_PI / acosf(1.0f - JM_SHAPE_MAX_ERROR / radius));
+	return (uint32_t)jm_clamp(segments, (float)JM_SHAPE_MIN_CIRCLE_SEGMENTS, (float)JM_SHAPE_MAX_CIRCLE_SEGMENTS);
+}
+
+uint32_t jm_shape_get_rect_path(
+	float x,
+	float y,
+	float width,
+	float height,
+	jm_vertex* dstPath)
+{
+	dstPath[0].x = x;
+	dstPath[0].y = y;
+	dstPath[1].x = x + width;
+	dstPath[1].y = y;
+	dstPath[2].x = x + width;
+	dstPath[2].y = y + height;
+	dstPath[3].x = x;
+	dstPath[3].y = y + height;
+	return 4;
+}
+
+// Writes segmentCount + 1 points of the arc from the direction startX,
+// startY, turning by angle. The points are rotated one step at a time, so
+// only one sine and cosine are evaluated per arc.
+static void jm_shape_get_arc(
+	float centerX,
+	float centerY,
+	float radius,
+	float startX,
+	float startY,
+	float angle,
+	uint32_t segmentCount,
+	jm_vertex* dstPath)
+{
+	const float stepCos = cosf(angle / (float)segmentCount);
+	const float stepSin = sinf(angle / (float)segmentCount);
+	float c = startX;
+	float s = startY;
+	for (uint32_t i = 0; i <= segmentCount; ++i)
+	{
+		dstPath[i].x = centerX + radius * c;
+		dstPath[i].y = centerY + radius * s;
+		const float nextC = c * stepCos - s * stepSin;
+		s = s * stepCos + c * stepSin;
+		c = nextC;
+	}
+}
+
+uint32_t jm_shape_get_circle_path(
+	float centerX,
+	float centerY,
+	float radius,
+	uint32_t segmentCount,
+	jm_vertex* dstPath)
+{
+	jm_assert(segmentCount >= 3);
+	// the point after the last one would be the first one again
+	const float angle = 2.0f * JM_SHAPE_PI * (float)(segmentCount - 1) / (float)segmentCount;
+	jm_shape_get_arc(centerX, centerY, radius, 1.0f, 0.0f, angle, segmentCount - 1, dstPath);
+	return segmentCount;
+}
+
+uint32_t jm_shape_get_rounded_rect_path(
+	float x,
+	float y,
+	float width,
+	float height,
+	float radius,
+	uint32_t cornerSegmentCount,
+	jm_vertex* dstPath)
+{
+	radius = jm_min(radius, 0.5f * jm_min(fabsf(width), fabsf(height)));
+	if (radius <= 0.0f || cornerSegmentCount == 0)
+	{
+		return jm_shape_get_rect_path(x, y, width, height, dstPath);
+	}
+
+	// clockwise from the top left, each corner a quarter turn
+	const float quarterTurn = 0.5f * JM_SHAPE_PI;
+	const uint32_t cornerPointCount = cornerSegmentCount + 1;
+	jm_shape_get_arc(x + radius, y + radius, radius, -1.0f, 0.0f, quarterTurn, cornerSegmentCount, dstPath);
+	jm_shape_get_arc(x + width - radius, y + radius, radius, 0.0f, -1.0f, quarterTurn, cornerSegmentCount, dstPath + cornerPointCount);
+	jm_shape_get_arc(x + width - radius, y + height - radius, radius, 1.0f, 0.0f, quarterTurn, cornerSegmentCount, dstPath + cornerPointCount * 2);
+	jm_shape_get_arc(x + radius, y + height - radius, radius, 0.0f, 1.0f, quarterTurn, cornerSegmentCount, dstPath + cornerPointCount * 3);
+	return cornerPointCount * 4;
+}
+
+void jm_shape_fill_convex(
+	uint32_t pointCount,
+	uint16_t* dstIndices)
+{
+	// a fan around the first point
+	for (uint32_t i = 2; i < pointCount; ++i)
+	{
+		dstIndices[0] = 0;
+		dstIndices[1] = (uint16_t)(i - 1);
+		dstIndices[2] = (uint16_t)i;
+		dstIndices += 3;
+	}
+}
+
+// Unit normal of the segment from a to b. Returns false if the points are
+// the same.
+static bool jm_shape_get_normal(
+	const jm_vertex* a,
+	const jm_vertex* b,
+	float* outX,
+	float* outY)
+{
+	const float dx = b->x - a->x;
+	const float dy = b->y - a->y;
+	const float length = sqrtf(dx * dx + dy * dy);
+	if (length < 1e-6f)
+	{
+		return false;
+	}
+	*outX = -dy / length;
+	*outY = dx / length;
+	return true;
+}
+
+void jm_shape_stroke(
+	const jm_vertex* path,
+	uint32_t pointCount,
+	bool isClosed,
+	float width,
+	jm_vertex* dstVertices,
+	uint16_t* dstIndices)
+{
+	jm_assert(pointCount >= 2);
+	const float halfWidth = 0.5f * width;
+
+	// the normal of the segment into the first point, which for open paths
+	// is the one out of it
+	float inX = 0.0f;
+	float inY = 1.0f;
+	if (!isClosed || !jm_shape_get_normal(&path[pointCount - 1], &path[0], &inX, &inY))
+	{
+		for (uint32_t i = 0; i + 1 < pointCount; ++i)
+		{
+			if (jm_shape_get_normal(&path[i], &path[i + 1], &inX, &inY))
+			{
+				break;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; i < pointCount; ++i)
+	{
+		// the segment out of the last point of an open path continues the one into it
+		float outX = inX;
+		float outY = inY;
+		if (i + 1 < pointCount)
+		{
+			jm_shape_get_normal(&path[i], &path[i + 1], &outX, &outY);
+		}
+		else if (isClosed)
+		{
+			jm_shape_get_normal(&path[i], &path[0], &outX, &outY);
+		}
+
+		// the miter is along the sum of the normals, and longer the sharper the join
+		float offsetX = inX * halfWidth;
+		float offsetY = inY * halfWidth;
+		const float miterX = inX + outX;
+		const float miterY = inY + outY;
+		const float miterLength = sqrtf(miterX * miterX + miterY * miterY);
+		if (miterLength > 1e-3f)
+		{
+			const float cosHalfAngle = (miterX * inX + miterY * inY) / miterLength;
+			const float scale = halfWidth / jm_max(cosHalfAngle, 1.0f / JM_SHAPE_MITER_LIMIT) / miterLength;
+			offsetX = miterX * scale;
+			offsetY = miterY * scale;
+		}
+
+		dstVertices[i * 2 + 0].x = path[i].x + offsetX;
+		dstVertices[i * 2 + 0].y = path[i].y + offsetY;
+		dstVertices[i * 2 + 1].x = path[i].x - offsetX;
+		dstVertices[i * 2 + 1].y = path[i].y - offsetY;
+
+		inX = outX;
+		inY = outY;
+	}
+
+	// two triangles per segment between the sides of its points
+	const uint32_t segmentCount = isClosed ? pointCount : pointCount - 1;
+	for (uint32_t i = 0; i < segmentCount; ++i)
+	{
+		const uint16_t a = (uint16_t)(i * 2);
+		const uint16_t b = (uint16_t)(((i + 1) % pointCount) * 2);
+		dstIndices[0] = a;
+		dstIndices[1] = a + 1;
+		dstIndices[2] = b;
+		dstIndices[3] = a + 1;
+		dstIndices[4] = b + 1;
+		dstIndices[5] = b;
+		dstIndices += 6;
+	}
+}
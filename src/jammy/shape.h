@@ -0,0 +1,65 @@
+#pragma once
+
+#include <jammy/render_types.h>
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+// The paths of rects, circles and rounded rects have at most this many 
+// points, polylines may have more.
+#define JM_SHAPE_MAX_PATH_POINTS 512
+
+// Joins of outlines reach out at most this many half line widths, sharper 
+// ones are cut short.
+#define JM_SHAPE_MITER_LIMIT 4.0f
+
+// Number of segments a full circle of the radius is approximated with, so
+// that it's off by no more than a tenth of a unit.
+uint32_t jm_shape_get_circle_segments(
+	float radius);
+
+// The corners of a rectangle in clockwise order, starting at the top left.
+// Returns the number of points, 4.
+uint32_t jm_shape_get_rect_path(
+	float x,
+	float y,
+	float width,
+	float height,
+	jm_vertex* dstPath);
+
+// Returns the number of points written, segmentCount.
+uint32_t jm_shape_get_circle_path(
+	float centerX,
+	float centerY,
+	float radius,
+	uint32_t segmentCount,
+	jm_vertex* dstPath);
+
+// A rectangle whose corners are quarter circles of radius, which is clamped
+// to half the shorter side. Returns the number of points written, at most
+// 4 * (cornerSegmentCount + 1).
+uint32_t jm_shape_get_rounded_rect_path(
+	float x,
+	float y,
+	float width,
+	float height,
+	float radius,
+	uint32_t cornerSegmentCount,
+	jm_vertex* dstPath);
+
+// Triangle list indices that fill a convex path, (pointCount - 2) * 3 of
+// them.
+void jm_shape_fill_convex(
+	uint32_t pointCount,
+	uint16_t* dstIndices);
+
+// Outlines a path with a line of the width centered on it, with mitered
+// joins and, for open paths, flat ends. Writes two vertices per point and
+// six triangle list indices per segment.
+void jm_shape_stroke(
+	const jm_vertex* path,
+	uint32_t pointCount,
+	bool isClosed,
+	float width,
+	jm_vertex* dstVertices,
+	uint16_t* dstIndices);
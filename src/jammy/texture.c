@@ -1,5 +1,6 @@
 #include "texture.h"
 
+#include <jammy/atlas.h>
 #include <jammy/hash.h>
 #include <jammy/file.h>
 #include <jammy/assert.h>
@@ -11,15 +12,35 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MAX_TEXTURES 1024
+#define MAX_ATLAS_PAGES 16
+#define ATLAS_PAGE_SIZE 2048
+// every packed texture gets a border of repeated edge pixels so filtering doesn't bleed
+#define ATLAS_PADDING 1
+
+typedef struct jm_atlas_page
+{
+	jm_texture_resource resource;
+	jm_skyline_packer packer;
+} jm_atlas_page;
 
 typedef struct jm_textures
 {
 	size_t count;
 	uint64_t* keys;
+	char** paths;
 	jm_texture_resource* resources;
 	jm_texture_info* textureInfo;
+	// atlas page of each texture, or -1
+	int32_t* atlasPages;
+	jm_render_target_resource* renderTargets;
+
+	bool isAtlasEnabled;
+	uint32_t atlasMaxSize;
+	uint32_t atlasPageCount;
+	jm_atlas_page atlasPage[MAX_ATLAS_PAGES];
 } jm_textures;
 
 jm_textures g_textures;
@@ -28,11 +49,125 @@ int jm_textures_init()
 {
 	g_textures.count = 0;
 	g_textures.keys = calloc(MAX_TEXTURES, sizeof(uint64_t));
+	g_textures.paths = calloc(MAX_TEXTURES, sizeof(char*));
 	g_textures.resources = calloc(MAX_TEXTURES, sizeof(jm_texture_resource));
 	g_textures.textureInfo = calloc(MAX_TEXTURES, sizeof(jm_texture_info));
+	g_textures.atlasPages = calloc(MAX_TEXTURES, sizeof(int32_t));
+	g_textures.renderTargets = calloc(MAX_TEXTURES, sizeof(jm_render_target_resource));
+	g_textures.isAtlasEnabled = false;
+	g_textures.atlasMaxSize = 0;
+	g_textures.atlasPageCount = 0;
 	return 0;
 }
 
+bool jm_textures_set_atlas_enabled(
+	bool enabled,
+	uint32_t maxSize)
+{
+#if defined(JM_RENDERER_OPENGL)
+	g_textures.isAtlasEnabled = enabled;
+	g_textures.atlasMaxSize = (maxSize + 2 * ATLAS_PADDING <= ATLAS_PAGE_SIZE) ? maxSize : ATLAS_PAGE_SIZE - 2 * ATLAS_PADDING;
+	return true;
+#else
+	// pages would have to be updated from the gameplay thread while the render thread uses the context
+	return !enabled;
+#endif
+}
+
+#if defined(JM_RENDERER_OPENGL)
+static bool jm_atlas_page_create(
+	jm_atlas_page* page)
+{
+	void* pixels = calloc(ATLAS_PAGE_SIZE * ATLAS_PAGE_SIZE, 4);
+	if (pixels == NULL)
+	{
+		return false;
+	}
+
+	jm_texture_resource_desc resourceDesc;
+	resourceDesc.name = "atlas page";
+	resourceDesc.width = ATLAS_PAGE_SIZE;
+	resourceDesc.height = ATLAS_PAGE_SIZE;
+	resourceDesc.data = pixels;
+	resourceDesc.format = JM_TEXTURE_FORMAT_R8G8B8A8;
+	jm_renderer_create_texture_resource(&resourceDesc, &page->resource);
+	free(pixels);
+
+	jm_skyline_packer_init(&page->packer, ATLAS_PAGE_SIZE, ATLAS_PAGE_SIZE);
+	return true;
+}
+
+// Copies pixels into a buffer with a border of repeated edge pixels.
+static uint32_t* jm_atlas_extrude(
+	const uint32_t* pixels,
+	uint32_t width,
+	uint32_t height)
+{
+	const uint32_t paddedWidth = width + 2 * ATLAS_PADDING;
+	const uint32_t paddedHeight = height + 2 * ATLAS_PADDING;
+	uint32_t* padded = malloc(paddedWidth * paddedHeight * sizeof(uint32_t));
+	for (uint32_t y = 0; y < paddedHeight; ++y)
+	{
+		const uint32_t srcY = (y < ATLAS_PADDING) ? 0 : (y - ATLAS_PADDING >= height) ? height - 1 : y - ATLAS_PADDING;
+		const uint32_t* srcRow = pixels + srcY * width;
+		uint32_t* dstRow = padded + y * paddedWidth;
+		for (uint32_t x = 0; x < ATLAS_PADDING; ++x)
+		{
+			dstRow[x] = srcRow[0];
+			dstRow[paddedWidth - 1 - x] = srcRow[width - 1];
+		}
+		memcpy(dstRow + ATLAS_PADDING, srcRow, width * sizeof(uint32_t));
+	}
+	return padded;
+}
+
+// Packs the pixels into an atlas page, returns the page index or -1 if it doesn't fit anywhere.
+static int32_t jm_atlas_insert(
+	const void* pixels,
+	uint32_t width,
+	uint32_t height,
+	jm_texture_info* textureInfo)
+{
+	const uint32_t paddedWidth = width + 2 * ATLAS_PADDING;
+	const uint32_t paddedHeight = height + 2 * ATLAS_PADDING;
+
+	uint32_t pageIndex;
+	uint32_t x, y;
+	for (pageIndex = 0; pageIndex < g_textures.atlasPageCount; ++pageIndex)
+	{
+		if (jm_skyline_packer_insert(&g_textures.atlasPage[pageIndex].packer, paddedWidth, paddedHeight, &x, &y))
+		{
+			break;
+		}
+	}
+
+	if (pageIndex == g_textures.atlasPageCount)
+	{
+		if (g_textures.atlasPageCount == MAX_ATLAS_PAGES || 
+			!jm_atlas_page_create(&g_textures.atlasPage[pageIndex]))
+		{
+			return -1;
+		}
+		g_textures.atlasPageCount++;
+		if (!jm_skyline_packer_insert(&g_textures.atlasPage[pageIndex].packer, paddedWidth, paddedHeight, &x, &y))
+		{
+			return -1;
+		}
+	}
+
+	uint32_t* padded = jm_atlas_extrude(pixels, width, height);
+	jm_renderer_update_texture_resource(g_textures.atlasPage[pageIndex].resource, x, y, paddedWidth, paddedHeight, padded);
+	free(padded);
+
+	textureInfo->isRemapped = true;
+	textureInfo->u0 = (float)(x + ATLAS_PADDING) / ATLAS_PAGE_SIZE;
+	textureInfo->v0 = (float)(y + ATLAS_PADDING) / ATLAS_PAGE_SIZE;
+	textureInfo->u1 = (float)(x + ATLAS_PADDING + width) / ATLAS_PAGE_SIZE;
+	textureInfo->v1 = (float)(y + ATLAS_PADDING + height) / ATLAS_PAGE_SIZE;
+	return (int32_t)pageIndex;
+}
+#endif
+
 static bool try_load_bmp(
 	const char* path,
 	void** outPixels,
@@ -149,26 +284,18 @@ static bool jm_load_image_pixels(
 	return false;
 }
 
-static int key_search_compare(const uint64_t* a, const uint64_t* b)
-{
-	if (*a <  *b) return -1;
-	if (*a == *b) return 0;
-	if (*a >  *b) return 1;
-#if defined(_MSC_VER)
-	__assume(0);
-#elif defined(__GNUC__)
-	__builtin_unreachable();
-#endif
-}
-
 jm_texture_handle jm_load_texture(
 	const char* path)
 {
 	const uint64_t key = jm_fnv(path);
-	const uint64_t* find = bsearch(&key, g_textures.keys, g_textures.count, sizeof(uint64_t), key_search_compare);
-	if (find)
+	// keys are in load order, not sorted, so bsearch can't be used here; loading 
+	// a texture twice would also pack it into the atlas twice
+	for (size_t i = 0; i < g_textures.count; ++i)
 	{
-		return (jm_texture_handle)(find - g_textures.keys);
+		if (g_textures.keys[i] == key)
+		{
+			return (jm_texture_handle)i;
+		}
 	}
 
 	if (!jm_file_exists(path))
@@ -179,6 +306,9 @@ jm_texture_handle jm_load_texture(
 
 	const jm_texture_handle textureHandle = (jm_texture_handle)g_textures.count++;
 	g_textures.keys[textureHandle] = key;
+	g_textures.paths[textureHandle] = malloc(strlen(path) + 1);
+	strcpy(g_textures.paths[textureHandle], path);
+	g_textures.atlasPages[textureHandle] = -1;
 	
 	void* pixels;
 	uint32_t width, height;
@@ -199,29 +329,115 @@ jm_texture_handle jm_load_texture(
 		}
 	}
 
-	jm_texture_resource_desc resourceDesc;
-	resourceDesc.name = path;
-	resourceDesc.width = width;
-	resourceDesc.height = height;
-	resourceDesc.data = pixels;
-	resourceDesc.format = format;
+	jm_texture_info textureInfo;
+	textureInfo.width = width;
+	textureInfo.height = height;
+	textureInfo.isSemitransparent = isSemitransparent;
+	textureInfo.isRemapped = false;
+	textureInfo.u0 = 0.0f;
+	textureInfo.v0 = 0.0f;
+	textureInfo.u1 = 1.0f;
+	textureInfo.v1 = 1.0f;
 
 	jm_texture_resource resource;
-	jm_renderer_create_texture_resource(&resourceDesc, &resource);
+#if defined(JM_RENDERER_OPENGL)
+	if (g_textures.isAtlasEnabled && 
+		format == JM_TEXTURE_FORMAT_R8G8B8A8 &&
+		width <= g_textures.atlasMaxSize && 
+		height <= g_textures.atlasMaxSize)
+	{
+		g_textures.atlasPages[textureHandle] = jm_atlas_insert(pixels, width, height, &textureInfo);
+	}
+	if (g_textures.atlasPages[textureHandle] >= 0)
+	{
+		resource = g_textures.atlasPage[g_textures.atlasPages[textureHandle]].resource;
+	}
+	else
+#endif
+	{
+		jm_texture_resource_desc resourceDesc;
+		resourceDesc.name = path;
+		resourceDesc.width = width;
+		resourceDesc.height = height;
+		resourceDesc.data = pixels;
+		resourceDesc.format = format;
+		jm_renderer_create_texture_resource(&resourceDesc, &resource);
+	}
 
 	free(pixels);
 
+	g_textures.textureInfo[textureHandle] = textureInfo;
+	g_textures.resources[textureHandle] = resource;
+	
+	return textureHandle;
+}
+
+jm_texture_handle jm_create_render_target(
+	uint32_t width,
+	uint32_t height)
+{
+	if (g_textures.count == MAX_TEXTURES)
+	{
+		printf("[ERROR] Can't create more than %d textures", MAX_TEXTURES);
+		return JM_TEXTURE_HANDLE_INVALID;
+	}
+
+	const jm_texture_handle textureHandle = (jm_texture_handle)g_textures.count++;
+	g_textures.keys[textureHandle] = 0;
+	g_textures.paths[textureHandle] = NULL;
+	g_textures.atlasPages[textureHandle] = -1;
+
 	jm_texture_info textureInfo;
 	textureInfo.width = width;
 	textureInfo.height = height;
-	textureInfo.isSemitransparent = isSemitransparent;
-
+	textureInfo.isSemitransparent = false;
+#if defined(JM_RENDERER_OPENGL)
+	// the first row of a framebuffer is its bottom
+	textureInfo.isRemapped = true;
+	textureInfo.u0 = 0.0f;
+	textureInfo.v0 = 1.0f;
+	textureInfo.u1 = 1.0f;
+	textureInfo.v1 = 0.0f;
+#else
+	textureInfo.isRemapped = false;
+	textureInfo.u0 = 0.0f;
+	textureInfo.v0 = 0.0f;
+	textureInfo.u1 = 1.0f;
+	textureInfo.v1 = 1.0f;
+#endif
 	g_textures.textureInfo[textureHandle] = textureInfo;
-	g_textures.resources[textureHandle] = resource;
-	
+
+	jm_render_target_resource_desc resourceDesc;
+	resourceDesc.name = "render target";
+	resourceDesc.width = width;
+	resourceDesc.height = height;
+	jm_renderer_create_render_target_resource(&resourceDesc, &g_textures.renderTargets[textureHandle], &g_textures.resources[textureHandle]);
+
 	return textureHandle;
 }
 
+bool jm_texture_is_render_target(
+	jm_texture_handle textureHandle)
+{
+	jm_assert(textureHandle != JM_TEXTURE_HANDLE_INVALID);
+	return g_textures.paths[textureHandle] == NULL;
+}
+
+jm_render_target_resource jm_texture_get_render_target_resource(
+	jm_texture_handle textureHandle)
+{
+	jm_assert(jm_texture_is_render_target(textureHandle));
+	return g_textures.renderTargets[textureHandle];
+}
+
+void jm_texture_set_semitransparent(
+	jm_texture_handle textureHandle,
+	bool isSemitransparent)
+{
+	jm_assert(textureHandle != JM_TEXTURE_HANDLE_INVALID);
+	g_textures.textureInfo[textureHandle].isSemitransparent = isSemitransparent;
+}
+
 void jm_destroy_texture(
 	jm_texture_handle textureHandle)
 {
@@ -237,6 +453,18 @@ void jm_texture_reload(
 
 }
 
+uint32_t jm_textures_get_count()
+{
+	return (uint32_t)g_textures.count;
+}
+
+const char* jm_texture_get_path(
+	jm_texture_handle textureHandle)
+{
+	jm_assert(textureHandle != JM_TEXTURE_HANDLE_INVALID);
+	return g_textures.paths[textureHandle];
+}
+
 jm_texture_resource jm_texture_get_resource(
 	jm_texture_handle textureHandle)
 {
@@ -255,4 +483,32 @@ bool jm_texture_isSemitransparent(
 	jm_texture_handle textureHandle)
 {
 	return jm_texture_get_info(textureHandle)->isSemitransparent;
-}
\ No newline at end of file
+}
+
+uint32_t jm_texture_get_batch_id(
+	jm_texture_handle textureHandle)
+{
+	jm_assert(textureHandle != JM_TEXTURE_HANDLE_INVALID);
+	const int32_t page = g_textures.atlasPages[textureHandle];
+	return (page >= 0) ? MAX_TEXTURES + (uint32_t)page : textureHandle;
+}
+
+void jm_texture_remap_texcoords(
+	jm_texture_handle textureHandle,
+	jm_texcoord* texcoords,
+	uint32_t count)
+{
+	const jm_texture_info* info = jm_texture_get_info(textureHandle);
+	if (!info->isRemapped)
+	{
+		return;
+	}
+
+	const float scaleU = info->u1 - info->u0;
+	const float scaleV = info->v1 - info->v0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		texcoords[i].u = info->u0 + texcoords[i].u * scaleU;
+		texcoords[i].v = info->v0 + texcoords[i].v * scaleV;
+	}
+}
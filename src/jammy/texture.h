@@ -6,6 +6,7 @@
 #include <stdbool.h>
 
 #define JM_TEXTURE_HANDLE_INVALID ((jm_texture_handle)-1)
+#define JM_TEXTURE_ATLAS_DEFAULT_MAX_SIZE 256
 
 typedef uint32_t jm_texture_handle;
 
@@ -14,19 +15,55 @@ typedef struct jm_texture_info
 	uint32_t width;
 	uint32_t height;
 	bool isSemitransparent;
+	// texcoords are mapped to [u0, u1] and [v0, v1] of the resource, for 
+	// textures packed into an atlas page and render targets stored bottom-up
+	bool isRemapped;
+	float u0, v0, u1, v1;
 } jm_texture_info;
 
 int jm_textures_init();
 
+// Pack textures loaded from now on that fit within maxSize into shared atlas pages.
+// Only supported by the OpenGL renderer, returns false otherwise.
+bool jm_textures_set_atlas_enabled(
+	bool enabled,
+	uint32_t maxSize);
+
 jm_texture_handle jm_load_texture(
 	const char* path);
 
+// Creates a texture that can be drawn into, see 
+// jm_render_command_begin_render_target. Render targets aren't atlased and 
+// start out transparent black.
+jm_texture_handle jm_create_render_target(
+	uint32_t width,
+	uint32_t height);
+
+// Render targets have no path.
+bool jm_texture_is_render_target(
+	jm_texture_handle textureHandle);
+
+jm_render_target_resource jm_texture_get_render_target_resource(
+	jm_texture_handle textureHandle);
+
+// Render targets hold semitransparent pixels if they are cleared to a 
+// semitransparent color, which is set when their pass is recorded.
+void jm_texture_set_semitransparent(
+	jm_texture_handle textureHandle,
+	bool isSemitransparent);
+
 void jm_destroy_texture(
 	jm_texture_handle textureHandle);
 
 void jm_texture_reload(
 	const char* path);
 
+// Number of handles handed out so far, in load order.
+uint32_t jm_textures_get_count();
+
+const char* jm_texture_get_path(
+	jm_texture_handle textureHandle);
+
 jm_texture_resource jm_texture_get_resource(
 	jm_texture_handle textureHandle);
 
@@ -35,3 +72,14 @@ const jm_texture_info* jm_texture_get_info(
 
 bool jm_texture_isSemitransparent(
 	jm_texture_handle textureHandle);
+
+// Textures that can be drawn in one batch share a batch id.
+uint32_t jm_texture_get_batch_id(
+	jm_texture_handle textureHandle);
+
+// Maps texcoords relative to the texture to texcoords of its resource. Atlas 
+// pages are shared, so texcoords outside [0,1] don't repeat for packed textures.
+void jm_texture_remap_texcoords(
+	jm_texture_handle textureHandle,
+	jm_texcoord* texcoords,
+	uint32_t count);